@@ -0,0 +1,1032 @@
+//
+//  Benchmark.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "Benchmark.h"
+#include "CascadedShadow.h"
+#include "GLExt.h"
+#include "LightClusters.h"
+#include "Model.h"
+#include "PointShadow.h"
+#include "Program.h"
+#include "SceneBVH.h"
+#include "ShadowAtlas.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+typedef std::chrono::steady_clock Clock;
+
+BenchmarkOptions BenchmarkOptions::parse(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--gl-debug")
+        {
+            options.glDebug = true;
+        }
+        else if (arg == "--frames" && hasValue)
+        {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--warmup" && hasValue)
+        {
+            options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--width" && hasValue)
+        {
+            options.width = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--height" && hasValue)
+        {
+            options.height = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--output" && hasValue)
+        {
+            options.output = argv[++i];
+        }
+        else if (arg == "--bench" && hasValue)
+        {
+            options.bench = argv[++i];
+        }
+        else if (arg == "--iterations" && hasValue)
+        {
+            options.iterations = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "unknown argument: " << arg << std::endl;
+        }
+    }
+    return options;
+}
+
+FrameProfiler::FrameProfiler()
+    : m_frame(0)
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+}
+
+void FrameProfiler::init(int frames)
+{
+    m_cpuMs.clear();
+    m_gpuMs.clear();
+    m_cpuMs.reserve(frames);
+    m_queries.resize(frames);
+    glGenQueries(frames, m_queries.data());
+    m_frame = 0;
+}
+
+void FrameProfiler::beginFrame()
+{
+    m_frameStart = std::chrono::steady_clock::now();
+    if (m_frame < (int)m_queries.size())
+    {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_frame]);
+    }
+}
+
+void FrameProfiler::endFrame()
+{
+    if (m_frame < (int)m_queries.size())
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_frameStart;
+    m_cpuMs.push_back(elapsed.count());
+    m_frame++;
+}
+
+void FrameProfiler::finish()
+{
+    // the queries were never waited on during the run, so reading them back here does not disturb the frame timings
+    glFinish();
+    int recorded = std::min<int>(m_frame, (int)m_queries.size());
+    for (int i = 0; i < recorded; ++i)
+    {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &nanoseconds);
+        m_gpuMs.push_back(nanoseconds / 1.0e6);
+    }
+    if (!m_queries.empty())
+    {
+        glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+        m_queries.clear();
+    }
+}
+
+nlohmann::json FrameProfiler::report() const
+{
+    nlohmann::json json;
+    json["frames"] = m_cpuMs.size();
+    json["cpu_ms"] = percentiles(m_cpuMs);
+    json["gpu_ms"] = percentiles(m_gpuMs);
+    return json;
+}
+
+nlohmann::json FrameProfiler::percentiles(std::vector<double> samples)
+{
+    nlohmann::json json = nlohmann::json::object();
+    if (samples.empty())
+    {
+        return json;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        // nearest-rank percentile
+        size_t rank = (size_t)std::ceil(p / 100.0 * samples.size());
+        return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+    json["min"] = samples.front();
+    json["max"] = samples.back();
+    json["mean"] = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    json["p50"] = percentile(50.0);
+    json["p90"] = percentile(90.0);
+    json["p95"] = percentile(95.0);
+    json["p99"] = percentile(99.0);
+    return json;
+}
+
+bool writeReport(const nlohmann::json& report, const std::string& output)
+{
+    if (output.empty())
+    {
+        std::cout << report.dump(4) << std::endl;
+        return true;
+    }
+
+    std::ofstream file(output);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << output << "!" << std::endl;
+        return false;
+    }
+    file << report.dump(4) << std::endl;
+    return true;
+}
+
+nlohmann::json MicroBenchmark::uniforms(Program* program, const std::vector<std::string>& textureTypes, int draws)
+{
+    program->use();
+
+    // every draw gets values of its own like different objects would, otherwise Program::changed() would skip all
+    // but the first draw and the handles would only be timed on the redundant path
+    auto value = [](int draw) { return (float)(draw % 1024) / 1024.f; };
+    auto modelMatrix = [&](int draw) { return glm::translate(glm::mat4(1.0f), glm::vec3(value(draw))); };
+    int samplerCount = (int)textureTypes.size();
+
+    // the previous Program::getLocation: std::map<std::string> lookup, keys built per call
+    std::map<std::string, GLint> legacyLocations;
+    auto legacyLocation = [&](const std::string& key) {
+        auto it = legacyLocations.find(key);
+        if (it != legacyLocations.end())
+        {
+            return it->second;
+        }
+        GLint location = glGetUniformLocation(program->id(), key.c_str());
+        legacyLocations[key] = location;
+        return location;
+    };
+
+    Clock::time_point start = Clock::now();
+    for (int draw = 0; draw < draws; ++draw)
+    {
+        float offset = value(draw);
+        glm::mat4 matrix = modelMatrix(draw);
+        glUniformMatrix4fv(legacyLocation("model"), 1, GL_FALSE, glm::value_ptr(matrix));
+        glUniform3f(legacyLocation("albedo"), offset, 0.5f, 0.5f);
+        glUniform1f(legacyLocation("metallic"), offset);
+        glUniform1f(legacyLocation("roughness"), 1.0f - offset);
+        glUniform1f(legacyLocation("ao"), offset);
+        for (int i = 0; i < samplerCount; ++i)
+        {
+            glUniform1i(legacyLocation("material." + textureTypes[i] + std::to_string(1)), (i + draw) % samplerCount);
+        }
+    }
+    double legacyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    static constexpr UniformName model("model");
+    static constexpr UniformName albedo("albedo");
+    static constexpr UniformName metallic("metallic");
+    static constexpr UniformName roughness("roughness");
+    static constexpr UniformName ao("ao");
+
+    // sampler names are built once, as Mesh does
+    std::vector<std::string> samplerNames;
+    for (const std::string& type : textureTypes)
+    {
+        samplerNames.push_back("material." + type + std::to_string(1));
+    }
+    std::vector<UniformName> samplers(samplerNames.begin(), samplerNames.end());
+
+    start = Clock::now();
+    for (int draw = 0; draw < draws; ++draw)
+    {
+        float offset = value(draw);
+        program->setUniformMatrix4fv(model, modelMatrix(draw));
+        program->setUniform3f(albedo, offset, 0.5f, 0.5f);
+        program->setUniform1f(metallic, offset);
+        program->setUniform1f(roughness, 1.0f - offset);
+        program->setUniform1f(ao, offset);
+        for (int i = 0; i < samplerCount; ++i)
+        {
+            program->setUniform1i(samplers[i], (i + draw) % samplerCount);
+        }
+    }
+    double handleMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // the same values for every draw, each call after the first only compares against the shadow copy
+    glm::mat4 matrix = modelMatrix(0);
+    start = Clock::now();
+    for (int draw = 0; draw < draws; ++draw)
+    {
+        program->setUniformMatrix4fv(model, matrix);
+        program->setUniform3f(albedo, 0.5f, 0.5f, 0.5f);
+        program->setUniform1f(metallic, 0.5f);
+        program->setUniform1f(roughness, 0.5f);
+        program->setUniform1f(ao, 1.0f);
+        for (int i = 0; i < samplerCount; ++i)
+        {
+            program->setUniform1i(samplers[i], i);
+        }
+    }
+    double redundantMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    glFinish();
+
+    nlohmann::json json;
+    json["benchmark"] = "uniforms";
+    json["draws"] = draws;
+    json["uniforms_per_draw"] = 5 + textureTypes.size();
+    json["string_map_ns_per_draw"] = legacyMs * 1.0e6 / draws;
+    json["hashed_handle_ns_per_draw"] = handleMs * 1.0e6 / draws;
+    json["speedup"] = handleMs > 0.0 ? legacyMs / handleMs : 0.0;
+    json["hashed_handle_redundant_ns_per_draw"] = redundantMs * 1.0e6 / draws;
+    return json;
+}
+
+nlohmann::json MicroBenchmark::drawSubmission(Program* program, int meshes, int frames)
+{
+    // degenerate triangles, the gpu has nothing to rasterize and only the submission is measured
+    auto createModel = [meshes](std::shared_ptr<GeometryArena> arena, bool indirect) {
+        std::unique_ptr<Model> model(new Model());
+        model->setGeometryArena(arena);
+        model->setMultiDrawIndirect(indirect);
+        for (int i = 0; i < meshes; ++i)
+        {
+            std::vector<Vertex> vertices(3, Vertex{glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec2(0.f)});
+            model->addMesh(std::make_unique<Mesh>(std::move(vertices), std::vector<unsigned int>{0, 1, 2}, std::vector<Texture>()));
+        }
+        model->init();
+        return model;
+    };
+    std::unique_ptr<Model> separate = createModel(nullptr, false);
+    std::unique_ptr<Model> arena = createModel(std::make_shared<GeometryArena>(), false);
+    std::unique_ptr<Model> indirect = GLExt::hasMultiDrawIndirect() ? createModel(std::make_shared<GeometryArena>(), true) : nullptr;
+
+    static constexpr UniformName model("model");
+    program->use();
+    program->setUniformMatrix4fv(model, glm::mat4(1.0f));
+
+    auto measure = [program, frames](Model* target) {
+        // first frame builds the batches
+        target->draw(program);
+        glFinish();
+        Clock::time_point start = Clock::now();
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            target->draw(program);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        glFinish();
+        return ms;
+    };
+    double separateMs = measure(separate.get());
+    double arenaMs = measure(arena.get());
+    double indirectMs = indirect ? measure(indirect.get()) : 0.0;
+
+    nlohmann::json json;
+    json["benchmark"] = "draws";
+    json["meshes"] = meshes;
+    json["frames"] = frames;
+    json["multi_draw_indirect"] = GLExt::hasMultiDrawIndirect();
+    json["per_mesh_draw_calls"] = separate->drawCalls();
+    json["arena_draw_calls"] = arena->drawCalls();
+    json["per_mesh_us_per_frame"] = separateMs * 1.0e3 / frames;
+    json["arena_us_per_frame"] = arenaMs * 1.0e3 / frames;
+    json["speedup"] = arenaMs > 0.0 ? separateMs / arenaMs : 0.0;
+    if (indirect)
+    {
+        json["arena_indirect_us_per_frame"] = indirectMs * 1.0e3 / frames;
+    }
+    return json;
+}
+
+nlohmann::json MicroBenchmark::instancing(Model* model, Program* instanced, Program* single, const std::vector<int>& counts, int frames, float extent, int loopLimit)
+{
+    static constexpr UniformName modelMatrix("model");
+
+    // scale the copies to fill their grid cell
+    float radius = 0.f;
+    for (size_t i = 0; i < model->meshCount(); ++i)
+    {
+        const Mesh* mesh = model->mesh(i);
+        for (size_t v = 0; v < mesh->vertexCount(); ++v)
+        {
+            radius = std::max(radius, glm::length(mesh->vertices()[v].position));
+        }
+    }
+
+    auto run = [&](int count, bool instancedDraw) {
+        int side = (int)std::ceil(std::cbrt((double)count));
+        float spacing = extent / side;
+        float scale = radius > 0.f ? 0.4f * spacing / radius : 1.f;
+        std::vector<glm::mat4> transforms;
+        transforms.reserve(count);
+        for (int i = 0; i < count; ++i)
+        {
+            glm::vec3 cell(i % side, (i / side) % side, i / (side * side));
+            glm::vec3 position = (cell + 0.5f) * spacing - glm::vec3(extent * 0.5f);
+            transforms.push_back(glm::scale(glm::translate(glm::mat4(1.f), position), glm::vec3(scale)));
+        }
+
+        FrameProfiler profiler;
+        profiler.init(frames);
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            profiler.beginFrame();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (instancedDraw)
+            {
+                instanced->use();
+                model->drawInstanced(instanced, transforms);
+            }
+            else
+            {
+                single->use();
+                for (const glm::mat4& transform : transforms)
+                {
+                    single->setUniformMatrix4fv(modelMatrix, transform);
+                    model->draw(single);
+                }
+            }
+            glFlush();
+            profiler.endFrame();
+        }
+        profiler.finish();
+        return profiler.report();
+    };
+
+    nlohmann::json results = nlohmann::json::array();
+    for (int count : counts)
+    {
+        nlohmann::json result;
+        result["instances"] = count;
+        result["instanced"] = run(count, true);
+        result["instanced"]["draw_calls"] = model->drawCalls();
+        if (count <= loopLimit)
+        {
+            result["loop"] = run(count, false);
+            result["loop"]["draw_calls"] = model->drawCalls() * count;
+        }
+        results.push_back(result);
+    }
+
+    nlohmann::json json;
+    json["benchmark"] = "instancing";
+    json["frames"] = frames;
+    json["results"] = results;
+    return json;
+}
+
+nlohmann::json MicroBenchmark::sceneBVH(const std::vector<int>& objectCounts, int queries)
+{
+    auto elapsedMs = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    // a flat city sized scene, cameras and rays near the ground looking sideways
+    std::mt19937 random(2026);
+    std::uniform_real_distribution<float> ground(-1000.f, 1000.f);
+    std::uniform_real_distribution<float> height(0.f, 100.f);
+    std::uniform_real_distribution<float> size(0.5f, 8.f);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    glm::mat4 project = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 500.f);
+    ThreadPool pool;
+    // keeps the results of the brute force loops alive
+    volatile float sink = 0.f;
+
+    nlohmann::json results = nlohmann::json::array();
+    for (int objectCount : objectCounts)
+    {
+        std::vector<AABB> boxes(objectCount);
+        AABBList boxList;
+        for (AABB& box : boxes)
+        {
+            glm::vec3 center(ground(random), height(random), ground(random));
+            glm::vec3 extent(size(random), size(random), size(random));
+            box.min = center - extent;
+            box.max = center + extent;
+            boxList.push_back(box);
+        }
+
+        std::vector<glm::vec3> origins(queries);
+        std::vector<glm::vec3> directions(queries);
+        std::vector<Frustum> frustums;
+        frustums.reserve(queries);
+        for (int i = 0; i < queries; ++i)
+        {
+            origins[i] = glm::vec3(ground(random), height(random), ground(random));
+            directions[i] = glm::normalize(glm::vec3(unit(random), 0.2f * unit(random), unit(random)));
+            frustums.emplace_back(project * glm::lookAt(origins[i], origins[i] + directions[i], glm::vec3(0.f, 1.f, 0.f)));
+        }
+        int bruteQueries = std::min(queries, 100);
+
+        SceneBVH bvh;
+        for (const AABB& box : boxes)
+        {
+            bvh.add(box);
+        }
+        Clock::time_point start = Clock::now();
+        bvh.build();
+        double serialMs = elapsedMs(start);
+        start = Clock::now();
+        bvh.build(&pool);
+        double pooledMs = elapsedMs(start);
+
+        nlohmann::json result;
+        result["objects"] = objectCount;
+        result["nodes"] = bvh.nodeCount();
+        result["sah_cost"] = bvh.cost();
+        result["build_ms"] = serialMs;
+        result["build_pooled_ms"] = pooledMs;
+        result["pool_threads"] = pool.size();
+
+        // frustum: hierarchy versus the sse test over every box
+        size_t found = 0;
+        std::vector<uint32_t> objects;
+        start = Clock::now();
+        for (const Frustum& frustum : frustums)
+        {
+            objects.clear();
+            bvh.cull(frustum, objects);
+            found += objects.size();
+        }
+        double bvhUs = elapsedMs(start) * 1000.0 / queries;
+        std::vector<uint8_t> visible(objectCount);
+        start = Clock::now();
+        for (int i = 0; i < bruteQueries; ++i)
+        {
+            sink = sink + (float)frustums[i].intersects(boxList, visible.data());
+        }
+        double bruteUs = elapsedMs(start) * 1000.0 / bruteQueries;
+        result["frustum"] = {{"bvh_us", bvhUs}, {"brute_force_us", bruteUs}, {"mean_visible", (double)found / queries}};
+
+        // rays: nearest hit
+        int hits = 0;
+        start = Clock::now();
+        for (int i = 0; i < queries; ++i)
+        {
+            RayHit hit;
+            hits += bvh.raycast(origins[i], directions[i], 500.f, hit) ? 1 : 0;
+        }
+        bvhUs = elapsedMs(start) * 1000.0 / queries;
+        start = Clock::now();
+        for (int i = 0; i < bruteQueries; ++i)
+        {
+            glm::vec3 inverseDirection = 1.f / directions[i];
+            float nearest = 500.f;
+            for (const AABB& box : boxes)
+            {
+                nearest = std::min(nearest, box.rayDistance(origins[i], inverseDirection, nearest));
+            }
+            sink = sink + nearest;
+        }
+        bruteUs = elapsedMs(start) * 1000.0 / bruteQueries;
+        result["ray"] = {{"bvh_us", bvhUs}, {"brute_force_us", bruteUs}, {"hit_rate", (double)hits / queries}};
+
+        // spheres: objects reached by a point light
+        found = 0;
+        start = Clock::now();
+        for (int i = 0; i < queries; ++i)
+        {
+            objects.clear();
+            bvh.overlap(BoundingSphere{origins[i], 50.f}, objects);
+            found += objects.size();
+        }
+        bvhUs = elapsedMs(start) * 1000.0 / queries;
+        start = Clock::now();
+        size_t bruteFound = 0;
+        for (int i = 0; i < bruteQueries; ++i)
+        {
+            BoundingSphere sphere = {origins[i], 50.f};
+            for (const AABB& box : boxes)
+            {
+                bruteFound += box.intersects(sphere) ? 1 : 0;
+            }
+        }
+        sink = sink + (float)bruteFound;
+        bruteUs = elapsedMs(start) * 1000.0 / bruteQueries;
+        result["sphere"] = {{"bvh_us", bvhUs}, {"brute_force_us", bruteUs}, {"mean_found", (double)found / queries}};
+
+        // refit after a tenth of the objects moved a little
+        for (int i = 0; i < objectCount; i += 10)
+        {
+            glm::vec3 offset(unit(random), unit(random), unit(random));
+            boxes[i].min += offset;
+            boxes[i].max += offset;
+            bvh.update(i, boxes[i]);
+        }
+        start = Clock::now();
+        bvh.refit();
+        result["refit_ms"] = elapsedMs(start);
+        result["refit_sah_cost"] = bvh.cost();
+
+        results.push_back(result);
+    }
+
+    nlohmann::json json;
+    json["benchmark"] = "bvh";
+    json["queries"] = queries;
+    json["results"] = results;
+    return json;
+}
+
+/// segments around and rings from pole to pole of the spheres the shadow benchmarks cast with
+static const int SPHERE_RINGS = 16;
+static const int SPHERE_SEGMENTS = 32;
+
+/// model of one uv sphere mesh of 2 * SPHERE_RINGS * SPHERE_SEGMENTS triangles per center, in an arena with position streams
+static std::unique_ptr<Model> createSpheres(const std::vector<glm::vec3>& centers, float radius)
+{
+    std::unique_ptr<Model> model(new Model());
+    model->setGeometryArena(std::make_shared<GeometryArena>());
+    model->setPositionStream(true);
+    for (const glm::vec3& center : centers)
+    {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (int ring = 0; ring <= SPHERE_RINGS; ++ring)
+        {
+            float theta = glm::pi<float>() * ring / SPHERE_RINGS;
+            for (int segment = 0; segment <= SPHERE_SEGMENTS; ++segment)
+            {
+                float phi = 2.f * glm::pi<float>() * segment / SPHERE_SEGMENTS;
+                glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                vertices.push_back(Vertex{center + normal * radius, normal, glm::vec2((float)segment / SPHERE_SEGMENTS, (float)ring / SPHERE_RINGS)});
+            }
+        }
+        for (int ring = 0; ring < SPHERE_RINGS; ++ring)
+        {
+            for (int segment = 0; segment < SPHERE_SEGMENTS; ++segment)
+            {
+                unsigned int first = ring * (SPHERE_SEGMENTS + 1) + segment;
+                unsigned int below = first + SPHERE_SEGMENTS + 1;
+                indices.insert(indices.end(), {first, below, first + 1, first + 1, below, below + 1});
+            }
+        }
+        model->addMesh(std::make_unique<Mesh>(std::move(vertices), std::move(indices), std::vector<Texture>()));
+    }
+    model->init();
+    return model;
+}
+
+nlohmann::json MicroBenchmark::pointShadows(int meshes, GLsizei size, int frames)
+{
+    // uv spheres of 1024 triangles between 2 and 20 units from the light at the origin
+    std::mt19937 random(7);
+    auto createModel = [&](int count) {
+        std::uniform_real_distribution<float> axis(-1.f, 1.f);
+        std::uniform_real_distribution<float> distance(2.f, 20.f);
+        std::vector<glm::vec3> centers;
+        for (int i = 0; i < count; ++i)
+        {
+            glm::vec3 direction;
+            do
+            {
+                direction = glm::vec3(axis(random), axis(random), axis(random));
+            } while (glm::length(direction) > 1.f || glm::length(direction) < 0.01f);
+            centers.push_back(glm::normalize(direction) * distance(random));
+        }
+        return createSpheres(centers, 0.5f);
+    };
+    // an eighth of the spheres belong to a model that moves in the cache scenarios
+    int moving = meshes / 8;
+    std::unique_ptr<Model> scenery = createModel(meshes - moving);
+    std::unique_ptr<Model> actor = createModel(moving);
+
+    PointShadow shadow;
+    shadow.create(size);
+    std::vector<ShadowCaster> casters = {{scenery.get(), glm::mat4(1.0f), false}, {actor.get(), glm::mat4(1.0f), false}};
+
+    // the first frame builds the batches and is not measured. every frame of a scenario calls prepare first
+    PointShadow::Filter filter = PointShadow::PCF;
+    auto measure = [&](PointShadow::Method method, const std::function<void(int)>& prepare) {
+        prepare(-1);
+        shadow.render(glm::vec3(0.f), 25.f, casters, method, 1.f, filter);
+        glFinish();
+        FrameProfiler profiler;
+        profiler.init(frames);
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            prepare(frame);
+            profiler.beginFrame();
+            shadow.render(glm::vec3(0.f), 25.f, casters, method, 1.f, filter);
+            glFlush();
+            profiler.endFrame();
+        }
+        profiler.finish();
+
+        nlohmann::json result = profiler.report();
+        result["passes"] = shadow.stats().passes;
+        result["draw_calls"] = shadow.stats().drawCalls;
+        result["face_triangles"] = shadow.stats().faceTriangles;
+        return result;
+    };
+    auto speedup = [](const nlohmann::json& baseline, const nlohmann::json& result) {
+        double ms = result["gpu_ms"].value("p50", 0.0);
+        return ms > 0.0 ? baseline["gpu_ms"].value("p50", 0.0) / ms : 0.0;
+    };
+
+    nlohmann::json json;
+    json["benchmark"] = "shadows";
+    json["meshes"] = meshes;
+    json["triangles"] = meshes * SPHERE_RINGS * SPHERE_SEGMENTS * 2;
+    json["size"] = size;
+    json["frames"] = frames;
+    json["vertex_shader_layer"] = GLExt::hasVertexShaderLayer();
+
+    // every method draws the whole map each frame
+    auto redraw = [&shadow](int) { shadow.invalidate(); };
+    nlohmann::json baseline = measure(PointShadow::GEOMETRY_SHADER, redraw);
+    for (int i = 0; i < PointShadow::METHOD_COUNT; ++i)
+    {
+        PointShadow::Method method = (PointShadow::Method)i;
+        if (!PointShadow::isSupported(method))
+        {
+            json["methods"][PointShadow::methodName(method)] = "unsupported";
+            continue;
+        }
+        nlohmann::json result = method == PointShadow::GEOMETRY_SHADER ? baseline : measure(method, redraw);
+        result["gpu_speedup"] = speedup(baseline, result);
+        json["methods"][PointShadow::methodName(method)] = result;
+    }
+
+    // caching with the default method: nothing moves, then the actor moves every frame over cached scenery,
+    // and the same without the cache
+    auto move = [&casters](int frame) { casters[1].transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.f, 0.01f * (frame & 1), 0.f)); };
+    nlohmann::json& cache = json["cache"];
+    cache["unchanged"] = measure(PointShadow::CULLED_FACES, [](int) {});
+    casters[1].dynamic = true;
+    cache["dynamic_moving"] = measure(PointShadow::CULLED_FACES, move);
+    cache["uncached"] = measure(PointShadow::CULLED_FACES, [&](int frame) {
+        move(frame);
+        shadow.invalidate();
+    });
+    cache["dynamic_moving"]["gpu_speedup"] = speedup(cache["uncached"], cache["dynamic_moving"]);
+
+    // the same moving actor with every filter, the prefiltering runs whenever the map changed
+    casters[1].transform = glm::mat4(1.0f);
+    for (int i = 0; i < PointShadow::FILTER_COUNT; ++i)
+    {
+        filter = (PointShadow::Filter)i;
+        json["filters"][PointShadow::filterName(filter)] = measure(PointShadow::CULLED_FACES, move);
+    }
+    return json;
+}
+
+nlohmann::json MicroBenchmark::shadowAtlas(int lights, int meshes, GLsizei size, int frames)
+{
+    // spheres scattered over a 80 x 80 field, the lights on a grid above it, a quarter of them spot lights looking down.
+    // the camera looks over the field from one side so near lights cover more of the screen than far ones
+    const float extent = 40.f;
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> across(-extent, extent);
+    std::uniform_real_distribution<float> height(0.5f, 2.f);
+    std::vector<glm::vec3> centers;
+    for (int i = 0; i < meshes; ++i)
+    {
+        centers.push_back(glm::vec3(across(random), height(random), across(random)));
+    }
+    std::unique_ptr<Model> field = createSpheres(centers, 0.5f);
+    std::vector<ShadowCaster> casters = {{field.get(), glm::mat4(1.0f), false}};
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 25.f, extent + 15.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 project = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 500.f);
+    DrawView camera(view, project, glm::vec3(0.f, 25.f, extent + 15.f), 1080.f, 1.f);
+
+    int side = (int)std::ceil(std::sqrt((float)lights));
+    std::vector<glm::vec3> anchors;
+    std::vector<ShadowLight> shadowLights;
+    for (int i = 0; i < lights; ++i)
+    {
+        glm::vec2 cell = (glm::vec2(i % side, i / side) + 0.5f) / (float)side * 2.f - 1.f;
+        anchors.push_back(glm::vec3(cell.x * extent, 4.f, cell.y * extent));
+        bool spot = i % 4 == 3;
+        // white lights reaching 12 units
+        shadowLights.push_back({nullptr, spot ? ShadowLight::SPOT : ShadowLight::POINT, glm::vec3(0.f), glm::vec3(0.f, -1.f, 0.f), glm::radians(70.f),
+                                glm::vec3(1.f), 0.5625f, 0.f});
+    }
+    // the anchors stay put from here on, their addresses identify the lights
+    for (int i = 0; i < lights; ++i)
+    {
+        shadowLights[i].id = &anchors[i];
+    }
+    // every light circles around its anchor, all of them are out of date every frame
+    auto place = [&](int frame) {
+        for (int i = 0; i < lights; ++i)
+        {
+            float angle = 0.1f * frame + i;
+            shadowLights[i].position = anchors[i] + glm::vec3(std::cos(angle), 0.f, std::sin(angle)) * 0.5f;
+            shadowLights[i].screenSize = ShadowAtlas::screenSize(shadowLights[i], camera);
+        }
+    };
+
+    ShadowAtlas atlas;
+    atlas.create(size, size / 4, 64, 1);
+
+    // the first frame places and draws every light and is not measured
+    auto measure = [&](int budget, bool moving) {
+        atlas.invalidate();
+        place(0);
+        atlas.update(shadowLights, casters, 0, 1.f);
+        glFinish();
+        FrameProfiler profiler;
+        profiler.init(frames);
+        int drawnViews = 0;
+        int maxStaleFrames = 0;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            if (moving)
+            {
+                place(frame + 1);
+            }
+            profiler.beginFrame();
+            atlas.update(shadowLights, casters, budget, 1.f);
+            glFlush();
+            profiler.endFrame();
+            drawnViews += atlas.stats().drawnViews;
+            maxStaleFrames = std::max(maxStaleFrames, atlas.stats().maxStaleFrames);
+        }
+        profiler.finish();
+
+        nlohmann::json result = profiler.report();
+        result["budget"] = budget;
+        result["views_per_frame"] = (double)drawnViews / frames;
+        result["max_stale_frames"] = maxStaleFrames;
+        result["shadowed_lights"] = atlas.stats().shadowedLights;
+        return result;
+    };
+
+    nlohmann::json json;
+    json["benchmark"] = "atlas";
+    json["lights"] = lights;
+    json["meshes"] = meshes;
+    json["size"] = size;
+    json["frames"] = frames;
+
+    place(0);
+    atlas.update(shadowLights, casters, 0, 1.f);
+    json["views"] = atlas.stats().views;
+    json["occupancy"] = atlas.stats().occupancy;
+    std::map<int, int> tiles;
+    for (const ShadowLight& light : shadowLights)
+    {
+        const ShadowAtlas::Entry* entry = atlas.find(light.id);
+        tiles[entry ? entry->tileTexels : 0]++;
+    }
+    for (const auto& tile : tiles)
+    {
+        json["lights_per_tile_size"][std::to_string(tile.first)] = tile.second;
+    }
+
+    // every view redrawn each frame, then under budgets, then with nothing moving
+    json["moving"]["unbudgeted"] = measure(0, true);
+    for (int budget : {6, 12, 24})
+    {
+        json["moving"]["budget_" + std::to_string(budget)] = measure(budget, true);
+    }
+    json["static"] = measure(12, false);
+    return json;
+}
+
+nlohmann::json MicroBenchmark::cascadedShadows(int meshes, GLsizei size, int frames)
+{
+    // spheres scattered over a 400 x 400 field under a low sun, the camera walks across it at head height
+    // and turns a little every frame
+    const float extent = 200.f;
+    std::mt19937 random(13);
+    std::uniform_real_distribution<float> across(-extent, extent);
+    std::vector<glm::vec3> centers;
+    for (int i = 0; i < meshes; ++i)
+    {
+        centers.push_back(glm::vec3(across(random), 1.f, across(random)));
+    }
+    std::unique_ptr<Model> field = createSpheres(centers, 1.f);
+    std::vector<ShadowCaster> casters = {{field.get(), glm::mat4(1.0f), false}};
+
+    glm::vec3 sun = glm::normalize(glm::vec3(-0.4f, -1.f, -0.3f));
+    glm::mat4 project = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 500.f);
+    auto cameraView = [](int frame) {
+        glm::vec3 eye(-50.f + 0.05f * frame, 2.f, 0.f);
+        float yaw = glm::radians(0.2f * frame);
+        return glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw)), glm::vec3(0.f, 1.f, 0.f));
+    };
+
+    CascadedShadow shadow;
+    shadow.create(1);
+
+    // the first frame allocates and draws the cascades and is not measured. a fixed point of the field should keep its
+    // place within a texel of the first cascade from frame to frame, anything else shows as crawling shadow edges
+    auto measure = [&](const CascadedShadow::Settings& settings, bool moving) {
+        shadow.render(sun, cameraView(0), project, casters, settings);
+        glFinish();
+        FrameProfiler profiler;
+        profiler.init(frames);
+        int updates = shadow.updates();
+        float maxShift = 0.f;
+        glm::vec2 lastTexel(0.f);
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            profiler.beginFrame();
+            shadow.render(sun, cameraView(moving ? frame + 1 : 0), project, casters, settings);
+            glFlush();
+            profiler.endFrame();
+
+            glm::vec4 position = shadow.matrix(0) * glm::vec4(0.f, 0.f, 0.f, 1.f);
+            glm::vec2 texel = (glm::vec2(position) * 0.5f + 0.5f) * (float)shadow.size();
+            glm::vec2 shift = glm::abs(glm::fract(texel) - glm::fract(lastTexel));
+            if (frame > 0)
+            {
+                maxShift = std::max(maxShift, std::max(std::min(shift.x, 1.f - shift.x), std::min(shift.y, 1.f - shift.y)));
+            }
+            lastTexel = texel;
+        }
+        profiler.finish();
+
+        nlohmann::json result = profiler.report();
+        result["cascades"] = shadow.stats().cascades;
+        result["layered"] = shadow.stats().layered;
+        result["passes"] = shadow.stats().passes;
+        result["draw_calls"] = shadow.stats().drawCalls;
+        result["triangles"] = shadow.stats().triangles;
+        result["updates"] = shadow.updates() - updates;
+        result["near_texel_size"] = shadow.texelSize(0);
+        result["max_subtexel_shift"] = maxShift;
+        return result;
+    };
+
+    nlohmann::json json;
+    json["benchmark"] = "cascades";
+    json["meshes"] = meshes;
+    json["triangles"] = meshes * SPHERE_RINGS * SPHERE_SEGMENTS * 2;
+    json["size"] = size;
+    json["frames"] = frames;
+    json["vertex_shader_layer"] = GLExt::hasVertexShaderLayer();
+
+    // one map of twice the side over the whole distance against cascades of size each
+    CascadedShadow::Settings settings;
+    settings.cascades = 1;
+    settings.size = size * 2;
+    json["moving"]["single_map"] = measure(settings, true);
+    settings.size = size;
+    for (int cascades = 1; cascades <= CascadedShadow::MAX_CASCADES; ++cascades)
+    {
+        settings.cascades = cascades;
+        json["moving"]["cascades_" + std::to_string(cascades)] = measure(settings, true);
+    }
+
+    // the same four cascades in one pass per cascade, without texel snapping, and with the camera standing still
+    if (GLExt::hasVertexShaderLayer())
+    {
+        settings.layered = false;
+        json["moving"]["per_cascade"] = measure(settings, true);
+        settings.layered = true;
+    }
+    settings.snap = false;
+    json["moving"]["unsnapped"] = measure(settings, true);
+    settings.snap = true;
+    json["static"] = measure(settings, false);
+    return json;
+}
+
+nlohmann::json MicroBenchmark::clusteredLighting(Program* program, const glm::mat4& view, const glm::mat4& project, int width, int height, GLuint firstUnit,
+                                                 const std::vector<int>& lightCounts, int frames)
+{
+    static constexpr UniformName modelMatrix("model");
+    static constexpr UniformName albedo("albedo");
+    static constexpr UniformName metallic("metallic");
+    static constexpr UniformName roughness("roughness");
+    static constexpr UniformName ao("ao");
+
+    // a 60 x 60 ground with 20 x 20 spheres standing on it
+    const float extent = 30.f;
+    std::unique_ptr<Model> ground(new Model());
+    ground->setGeometryArena(std::make_shared<GeometryArena>());
+    std::vector<Vertex> vertices = {
+        {glm::vec3(-extent, 0.f, -extent), glm::vec3(0.f, 1.f, 0.f), glm::vec2(0.f, 0.f)},
+        {glm::vec3(-extent, 0.f, extent), glm::vec3(0.f, 1.f, 0.f), glm::vec2(0.f, 1.f)},
+        {glm::vec3(extent, 0.f, extent), glm::vec3(0.f, 1.f, 0.f), glm::vec2(1.f, 1.f)},
+        {glm::vec3(extent, 0.f, -extent), glm::vec3(0.f, 1.f, 0.f), glm::vec2(1.f, 0.f)},
+    };
+    ground->addMesh(std::make_unique<Mesh>(std::move(vertices), std::vector<unsigned int>{0, 1, 2, 0, 2, 3}, std::vector<Texture>()));
+    ground->init();
+    std::vector<glm::vec3> centers;
+    for (int i = 0; i < 400; ++i)
+    {
+        centers.push_back(glm::vec3((i % 20 + 0.5f) * 3.f - extent, 1.f, (i / 20 + 0.5f) * 3.f - extent));
+    }
+    std::unique_ptr<Model> spheres = createSpheres(centers, 1.f);
+
+    // one cluster holds every visible light, the shading loop is then the same as without clusters
+    LightClusters all;
+    all.create(1, 1, 1);
+    LightClusters clustered;
+    clustered.create(16, 9, 24);
+
+    auto measure = [&](LightClusters& clusters, const std::vector<LightClusters::Light>& lights) {
+        FrameProfiler profiler;
+        profiler.init(frames);
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            profiler.beginFrame();
+            clusters.update(lights, view, project, width, height);
+            // the engine keeps the stencil test on, a stencil never cleared would reject the draws
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            program->use();
+            clusters.bind(program, firstUnit);
+            program->setUniform3f(albedo, glm::vec3(0.8f));
+            program->setUniform1f(metallic, 0.f);
+            program->setUniform1f(roughness, 0.5f);
+            program->setUniform1f(ao, 1.f);
+            program->setUniformMatrix4fv(modelMatrix, glm::mat4(1.f));
+            ground->draw(program);
+            spheres->draw(program);
+            glFlush();
+            profiler.endFrame();
+        }
+        profiler.finish();
+        const LightClusters::Stats& stats = clusters.stats();
+        nlohmann::json result = profiler.report();
+        result["clusters"] = stats.clusters;
+        result["visible_lights"] = stats.visibleLights;
+        result["occupied_clusters"] = stats.occupiedClusters;
+        result["max_lights_per_cluster"] = stats.maxLights;
+        result["average_lights_per_cluster"] = stats.occupiedClusters ? (double)stats.references / stats.occupiedClusters : 0.0;
+        result["bin_ms"] = stats.binMs;
+        return result;
+    };
+
+    // small lights reaching about 6 units, so a fragment sees only the few around it
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> across(-extent, extent);
+    std::uniform_real_distribution<float> above(0.5f, 3.f);
+    std::uniform_real_distribution<float> channel(0.2f, 1.f);
+    nlohmann::json results = nlohmann::json::array();
+    for (int count : lightCounts)
+    {
+        std::vector<LightClusters::Light> lights;
+        for (int i = 0; i < count; ++i)
+        {
+            glm::vec3 color(channel(random), channel(random), channel(random));
+            lights.push_back({LightClusters::Light::POINT, glm::vec3(across(random), above(random), across(random)), color, 0.15f, glm::vec3(0.f),
+                              0.f, 0.f, ShadowMaps::NONE, -1});
+        }
+        nlohmann::json result;
+        result["lights"] = count;
+        result["all"] = measure(all, lights);
+        result["clustered"] = measure(clustered, lights);
+        results.push_back(result);
+    }
+
+    nlohmann::json json;
+    json["benchmark"] = "clusters";
+    json["frames"] = frames;
+    json["width"] = width;
+    json["height"] = height;
+    json["results"] = results;
+    return json;
+}
@@ -0,0 +1,122 @@
+//
+//  Benchmark.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef Benchmark_h
+#define Benchmark_h
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <nlohmann/json.hpp>
+
+class Model;
+class Program;
+
+/// command line options of the app and the headless benchmark runner, --headless needs a linux build linked against
+/// libEGL, see HeadlessContext
+struct BenchmarkOptions
+{
+    bool headless = false;
+    bool glDebug = false;
+    int frames = 300;
+    int warmupFrames = 10;
+    int width = 1920;
+    int height = 1080;
+    std::string output;
+
+    /// micro benchmark to run instead of the frame loop, "uniforms", "draws", "instancing" (runs --frames frames per count), "bvh",
+    /// "shadows" (runs --frames frames per method), "atlas" (runs --frames frames per budget), "cascades" (runs --frames frames
+    /// per setup) or "clusters" (runs --frames frames per light count and grid)
+    std::string bench;
+    int iterations = 100000;
+
+    /// parse "--headless --frames N --warmup N --width W --height H --output file.json --gl-debug
+    /// --bench name --iterations N"
+    static BenchmarkOptions parse(int argc, char* argv[]);
+};
+
+/// collects per-frame cpu time and gpu time (GL_TIME_ELAPSED queries)
+class FrameProfiler
+{
+public:
+    FrameProfiler();
+    ~FrameProfiler();
+
+    /// reserve one timer query per frame, results are read back in finish()
+    void init(int frames);
+    void beginFrame();
+    void endFrame();
+
+    /// wait for all outstanding queries and release them
+    void finish();
+
+    /// percentiles of the recorded frames
+    nlohmann::json report() const;
+
+    static nlohmann::json percentiles(std::vector<double> samples);
+
+private:
+    std::vector<double> m_cpuMs;
+    std::vector<double> m_gpuMs;
+    std::vector<GLuint> m_queries;
+    std::chrono::steady_clock::time_point m_frameStart;
+    int m_frame;
+};
+
+/// print the report, or write it to output when given
+bool writeReport(const nlohmann::json& report, const std::string& output);
+
+/// isolated measurements of single engine paths, each returns its json report
+namespace MicroBenchmark
+{
+    /// cpu cost per draw of setting the cook-torrance per-object uniforms and the mesh samplers to new values,
+    /// string keyed map lookups with names built per draw versus hashed handles, and of the hashed handles
+    /// setting values unchanged since the last draw, which Program skips
+    nlohmann::json uniforms(Program* program, const std::vector<std::string>& textureTypes, int draws);
+
+    /// cpu cost per frame of submitting a model made of many small meshes, one draw per mesh with
+    /// its own vertex array versus one multi-draw over a geometry arena, base vertex and, where available, indirect
+    nlohmann::json drawSubmission(Program* program, int meshes, int frames);
+
+    /// frame time of a grid of model copies for each instance count, drawn with one instanced draw
+    /// per mesh, and for counts up to loopLimit also with one draw per copy. the grid fills a cube of
+    /// side extent around the origin, the caller sets up the camera and the framebuffer
+    nlohmann::json instancing(Model* model, Program* instanced, Program* single, const std::vector<int>& counts, int frames, float extent, int loopLimit);
+
+    /// SceneBVH over random boxes for each object count: serial and pooled build time, refit time after
+    /// moving a tenth of the objects, and per query time of frustum, ray and sphere queries against
+    /// testing every box (the brute force side runs at most 100 queries)
+    nlohmann::json sceneBVH(const std::vector<int>& objectCounts, int queries);
+
+    /// cpu and gpu time per point light cube shadow map of size x size for each PointShadow method redrawing
+    /// everything, then of the cached map while nothing moves and while an eighth of the casters moves every frame,
+    /// last with each PointShadow::Filter while they move. the casters are sphere meshes scattered around the light,
+    /// most of them seen by one or two faces only
+    nlohmann::json pointShadows(int meshes, GLsizei size, int frames);
+
+    /// ShadowAtlas of size x size shared by lights over a field of sphere meshes, three point lights to one spot light.
+    /// reports how the tiles were sized from a fixed camera, then cpu and gpu time per frame with every light moving,
+    /// drawing every view and under several view budgets, and with nothing moving
+    nlohmann::json shadowAtlas(int lights, int meshes, GLsizei size, int frames);
+
+    /// CascadedShadow of a sun over a large field of sphere meshes with the camera walking and turning. cpu and gpu time
+    /// per frame, the world size of a texel near the camera and how far a fixed point moves within the texels of the first
+    /// cascade, for one map of twice the side and for 1 to 4 cascades of size x size, then for 4 cascades drawn one pass
+    /// per cascade, without texel snapping and with the camera standing still
+    nlohmann::json cascadedShadows(int meshes, GLsizei size, int frames);
+
+    /// cook-torrance program over a ground plane and a grid of spheres lit by each count of small point lights scattered
+    /// above them, with every visible light tested by every fragment (LightClusters of one cluster) and with the lights
+    /// binned into clusters. cpu time includes the binning, the light buffers go to the units firstUnit to firstUnit + 2.
+    /// the caller sets up the frame uniforms for view and project and a framebuffer of width x height
+    nlohmann::json clusteredLighting(Program* program, const glm::mat4& view, const glm::mat4& project, int width, int height, GLuint firstUnit,
+                                     const std::vector<int>& lightCounts, int frames);
+}
+
+#endif /* Benchmark_h */
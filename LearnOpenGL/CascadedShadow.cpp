@@ -0,0 +1,241 @@
+//
+//  CascadedShadow.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "CascadedShadow.h"
+#include "GLExt.h"
+#include "GLState.h"
+#include "Model.h"
+#include "Program.h"
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+/// the LOD of a caster is picked as if seen from this many cascade radii away, where a perspective view
+/// is close enough to the orthographic one
+static const float LOD_EYE_DISTANCE = 1000.f;
+
+namespace Uniforms
+{
+    constexpr UniformName model("model");
+    constexpr UniformName cascadeMatrix("cascadeMatrix");
+    constexpr UniformName cascadeMatrices("cascadeMatrices");
+}
+
+CascadedShadow::CascadedShadow()
+    : m_depthMap(0), m_framebuffer(0), m_size(0), m_cascades(0), m_firstSlot(0), m_splits(), m_texelSizes(), m_matrices(), m_state(),
+      m_valid(false), m_updates(0)
+{
+}
+
+CascadedShadow::~CascadedShadow()
+{
+    GLState::deleteTextures(1, &m_depthMap);
+    glDeleteFramebuffers(1, &m_framebuffer);
+}
+
+void CascadedShadow::create(unsigned int firstSlot)
+{
+    m_firstSlot = firstSlot;
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    m_program.reset(new Program("cascade-shadow"));
+    if (GLExt::hasVertexShaderLayer())
+    {
+        m_layeredProgram.reset(new Program("cascade-shadow", {"LAYERED"}));
+    }
+}
+
+void CascadedShadow::allocate(GLsizei size, int cascades)
+{
+    if (m_depthMap != 0 && size == m_size && cascades == m_cascades)
+    {
+        return;
+    }
+    if (m_depthMap == 0)
+    {
+        glGenTextures(1, &m_depthMap);
+    }
+    m_size = size;
+    m_cascades = cascades;
+    m_valid = false;
+
+    // linear filtering with depth comparison gives 2x2 pcf for one fetch, like the other shadow maps
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, m_depthMap);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, cascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+void CascadedShadow::invalidate()
+{
+    m_valid = false;
+}
+
+void CascadedShadow::render(const glm::vec3& direction, const glm::mat4& cameraView, const glm::mat4& cameraProject,
+                            const std::vector<ShadowCaster>& casters, const Settings& settings)
+{
+    m_stats = Stats();
+    if (m_framebuffer == 0)
+    {
+        return;
+    }
+    int cascades = glm::clamp(settings.cascades, 1, MAX_CASCADES);
+    allocate(settings.size, cascades);
+    bool layered = settings.layered && m_layeredProgram;
+    m_stats.cascades = cascades;
+    m_stats.layered = layered;
+
+    // near and far plane and the half extents one unit in front of the camera, from a gl perspective projection
+    float nearPlane = cameraProject[3][2] / (cameraProject[2][2] - 1.f);
+    float farPlane = std::min(cameraProject[3][2] / (cameraProject[2][2] + 1.f), settings.distance);
+    glm::vec2 tangents(1.f / cameraProject[0][0], 1.f / cameraProject[1][1]);
+    glm::mat4 inverseView = glm::inverse(cameraView);
+
+    // every cascade looks down the light with the same rotation, only its window onto the light space moves
+    glm::vec3 forward = glm::normalize(direction);
+    glm::vec3 up = glm::abs(forward.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.f), forward, up);
+    glm::mat4 inverseLightView = glm::inverse(lightView);
+
+    // the casters in light space, they cast into a cascade from anywhere in front of it
+    MapState state;
+    state.cascades = cascades;
+    state.size = m_size;
+    state.maxPixelError = settings.maxPixelError;
+    std::vector<glm::vec4> spheres;
+    for (const ShadowCaster& caster : casters)
+    {
+        const BoundingSphere& bounds = caster.model->worldBounds(caster.transform);
+        spheres.push_back(glm::vec4(glm::vec3(lightView * glm::vec4(bounds.center, 1.f)), bounds.radius));
+        state.casters.push_back({caster.model, caster.transform, caster.model->residentMeshes()});
+    }
+
+    std::vector<DrawView> views;
+    views.reserve(cascades);
+    float start = nearPlane;
+    for (int i = 0; i < cascades; ++i)
+    {
+        // practical split scheme, a blend of logarithmic and uniform splits
+        float t = (float)(i + 1) / cascades;
+        float end = glm::mix(nearPlane + (farPlane - nearPlane) * t, nearPlane * std::pow(farPlane / nearPlane, t), settings.splitLambda);
+        m_splits[i] = end;
+
+        // the sphere around the eight corners of the slice only moves with the camera, its radius is rounded so
+        // rounding errors while the camera turns do not resize the cascade
+        glm::vec3 corners[8];
+        glm::vec3 center(0.f);
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            float depth = corner < 4 ? start : end;
+            glm::vec2 side((corner & 1) ? 1.f : -1.f, (corner & 2) ? 1.f : -1.f);
+            corners[corner] = glm::vec3(inverseView * glm::vec4(side * tangents * depth, -depth, 1.f));
+            center += corners[corner] / 8.f;
+        }
+        float radius = 0.f;
+        for (const glm::vec3& corner : corners)
+        {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.f) / 16.f;
+        start = end;
+
+        // the window moves in whole texels, a caster then lands on the same texels wherever the camera is
+        float texel = 2.f * radius / m_size;
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.f));
+        if (settings.snap)
+        {
+            lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+            lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+        }
+
+        // receivers lie within the sphere, the depth range reaches back to the casters in front of it
+        float nearDepth = -lightCenter.z - radius;
+        float farDepth = -lightCenter.z + radius;
+        for (const glm::vec4& sphere : spheres)
+        {
+            if (glm::abs(sphere.x - lightCenter.x) < radius + sphere.w && glm::abs(sphere.y - lightCenter.y) < radius + sphere.w)
+            {
+                nearDepth = std::min(nearDepth, -sphere.z - sphere.w);
+            }
+        }
+        glm::mat4 project = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius, nearDepth, farDepth);
+        m_matrices[i] = project * lightView;
+        m_texelSizes[i] = texel;
+        state.matrices[i] = m_matrices[i];
+
+        // a projection without perspective picks LODs as seen from far away, with the pixel scale that distance takes away
+        glm::vec3 worldCenter = glm::vec3(inverseLightView * glm::vec4(lightCenter, 1.f));
+        float eyeDistance = LOD_EYE_DISTANCE * radius;
+        views.emplace_back(lightView, project, worldCenter - forward * eyeDistance, (float)m_size, settings.maxPixelError, m_firstSlot + i);
+        views.back().pixelsPerUnit *= eyeDistance;
+    }
+
+    if (m_valid && state == m_state)
+    {
+        return;
+    }
+    draw(state.casters, views, layered);
+    m_state = std::move(state);
+    m_valid = true;
+    m_updates++;
+    m_stats.updated = true;
+}
+
+void CascadedShadow::draw(const std::vector<ShadowCasterState>& casters, const std::vector<DrawView>& views, bool layered)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, m_size, m_size);
+
+    // back faces into the map as for the point shadows, lit surfaces compare against the far side of their mesh
+    GLState::enable(GL_CULL_FACE);
+    GLState::cullFace(GL_FRONT);
+
+    if (layered)
+    {
+        // one pass, every mesh instanced over the cascades that see it
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthMap, 0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        m_layeredProgram->use();
+        m_layeredProgram->setUniformMatrix4fv(Uniforms::cascadeMatrices, std::vector<glm::mat4>(m_matrices, m_matrices + m_cascades));
+        for (const ShadowCasterState& caster : casters)
+        {
+            m_layeredProgram->setUniformMatrix4fv(Uniforms::model, caster.transform);
+            caster.model->drawDepthLayers(m_layeredProgram.get(), views.data(), views.size(), caster.transform);
+            m_stats.drawCalls += caster.model->depthDrawCalls();
+            m_stats.triangles += caster.model->depthTriangles();
+        }
+        m_stats.passes++;
+    }
+    else
+    {
+        m_program->use();
+        for (int i = 0; i < m_cascades; ++i)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthMap, 0, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            m_program->setUniformMatrix4fv(Uniforms::cascadeMatrix, m_matrices[i]);
+            for (const ShadowCasterState& caster : casters)
+            {
+                m_program->setUniformMatrix4fv(Uniforms::model, caster.transform);
+                caster.model->drawDepth(m_program.get(), views[i], caster.transform);
+                m_stats.drawCalls += caster.model->depthDrawCalls();
+                m_stats.triangles += caster.model->depthTriangles();
+            }
+        }
+        m_stats.passes += m_cascades;
+    }
+
+    // back to the engine default, no culling
+    GLState::cullFace(GL_BACK);
+    GLState::disable(GL_CULL_FACE);
+}
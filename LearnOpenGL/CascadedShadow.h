@@ -0,0 +1,131 @@
+//
+//  CascadedShadow.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef CascadedShadow_h
+#define CascadedShadow_h
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "PointShadow.h"
+
+struct DrawView;
+
+/// shadow of a directional light as cascades of orthographic depth maps in the layers of one texture array.
+/// the camera frustum up to a shadow distance is split into slices, near ones small and sharp, far ones coarse,
+/// and each cascade covers the bounding sphere of its slice. the sphere keeps the cascade size fixed while the
+/// camera turns and its position snaps to whole texels, so the shadow edges do not crawl as the camera moves.
+/// the layers are drawn in one layered pass when the vertex shader can pick the layer, one pass per cascade otherwise.
+/// nothing is drawn again while the cascades and the casters stay the same
+class CascadedShadow
+{
+public:
+    static const int MAX_CASCADES = 4;
+
+    struct Settings
+    {
+        /// 1 to MAX_CASCADES, each size x size texels
+        int cascades = 4;
+        GLsizei size = 2048;
+        /// view depth the last cascade ends at
+        float distance = 100.f;
+        /// splits between uniform (0) and logarithmic (1) in view depth
+        float splitLambda = 0.8f;
+        /// one layered pass over all cascades when supported
+        bool layered = true;
+        /// move the cascades in whole texels only
+        bool snap = true;
+        float maxPixelError = 1.f;
+    };
+
+    /// what the last render() found and drew
+    struct Stats
+    {
+        int cascades = 0;
+        int passes = 0;
+        int drawCalls = 0;
+        int triangles = 0;
+        bool layered = false;
+        bool updated = false;
+    };
+
+    CascadedShadow();
+    ~CascadedShadow();
+    CascadedShadow(const CascadedShadow&) = delete;
+    CascadedShadow& operator=(const CascadedShadow&) = delete;
+
+    /// framebuffer and programs, render thread only. the texture array follows the settings of render().
+    /// the cascades draw the casters with the DrawView slots firstSlot to firstSlot + MAX_CASCADES - 1
+    void create(unsigned int firstSlot);
+
+    /// fit the cascades to the camera, a perspective projection, for light travelling along direction and bring them
+    /// up to date. every caster casts, the cascades cull them. may leave the shadow framebuffer bound
+    void render(const glm::vec3& direction, const glm::mat4& cameraView, const glm::mat4& cameraProject, const std::vector<ShadowCaster>& casters,
+                const Settings& settings);
+
+    /// forget what the layers hold, the next render() draws every cascade
+    void invalidate();
+
+    /// GL_TEXTURE_2D_ARRAY of depth with comparison, one layer per cascade
+    GLuint depthMap() const { return m_depthMap; }
+    GLsizei size() const { return m_size; }
+    int cascades() const { return m_cascades; }
+    /// view depth each cascade ends at
+    float split(int cascade) const { return m_splits[cascade]; }
+    /// world to clip space of a cascade, depth in [-1, 1] like any projection
+    const glm::mat4& matrix(int cascade) const { return m_matrices[cascade]; }
+    /// world size of one texel of a cascade
+    float texelSize(int cascade) const { return m_texelSizes[cascade]; }
+    const Stats& stats() const { return m_stats; }
+    /// times the layers were drawn since create()
+    int updates() const { return m_updates; }
+
+private:
+    struct MapState
+    {
+        int cascades;
+        GLsizei size;
+        float maxPixelError;
+        glm::mat4 matrices[MAX_CASCADES];
+        std::vector<ShadowCasterState> casters;
+
+        bool operator==(const MapState& other) const
+        {
+            return cascades == other.cascades && size == other.size && maxPixelError == other.maxPixelError &&
+                   std::equal(matrices, matrices + cascades, other.matrices) && casters == other.casters;
+        }
+        bool operator!=(const MapState& other) const { return !(*this == other); }
+    };
+
+    /// the texture array for size and cascades, kept while they do not change
+    void allocate(GLsizei size, int cascades);
+
+    void draw(const std::vector<ShadowCasterState>& casters, const std::vector<DrawView>& views, bool layered);
+
+private:
+    GLuint m_depthMap;
+    GLuint m_framebuffer;
+    GLsizei m_size;
+    int m_cascades;
+    unsigned int m_firstSlot;
+    std::unique_ptr<Program> m_program;
+    std::unique_ptr<Program> m_layeredProgram;
+
+    float m_splits[MAX_CASCADES];
+    float m_texelSizes[MAX_CASCADES];
+    glm::mat4 m_matrices[MAX_CASCADES];
+    Stats m_stats;
+
+    /// what the layers hold
+    MapState m_state;
+    bool m_valid;
+    int m_updates;
+};
+
+#endif /* CascadedShadow_h */
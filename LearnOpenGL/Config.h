@@ -14,5 +14,48 @@
 bool renderSkyBox = true;
 bool renderCTPBR = true;
 int frameCount = 0;
+// ÿ֡ϴʱԤ (ms)
+float uploadBudgetMs = 2.f;
+// ģ빲ļλ, ͬʵϲΪһζػ
+bool useGeometryArena = true;
+// ģ͹һλ, Ҫ useGeometryArena
+bool sceneGeometryArena = false;
+// λĶػʹ glMultiDrawElementsIndirect (Ҫ gl 4.3), رʱʹ glMultiDrawElementsBaseVertex.
+// --bench draws к߸, ĬϹر
+bool multiDrawIndirect = false;
+// ѹʽ (16 λλ, 10:10:10:2 , 뾫 UV) ϴ
+bool compactVertices = true;
+// Ᵽһݽյλ, ԤȾӰֻȡλ
+bool positionStream = true;
+// ֻȾ, ɫ׶ֻɼƬԪ
+bool depthPrepass = false;
+// ׶޳ģвɼ
+bool frustumCulling = true;
+// ѡ LOD ʱĻռ ()
+float lodPixelError = 1.f;
+// ԴͶӰ
+bool pointShadows = true;
+// ԴӰȾʽ (PointShadow::Method): 0 ɫÿη, 1 ޳ʵֲȾ, 2 ޳Ⱦ
+int pointShadowMethod = 2;
+// ԴͷΧڵͶ嶼ûб仯ʱһ֡Ӱͼ, ̬ͶֻȾһ
+bool shadowCache = true;
+// Ӱͼ˲ʽ (PointShadow::Filter): 0 Ӳ PCF, 1 ESM, 2 EVSM. Ԥģ mipmap, ʱһβ. Ӱͼֻ PCF
+int shadowFilter = 0;
+// йԴӰŽһӰͼ, ԴĻϵĴСֱ. رʱֻеһԴʹӰͼ
+bool shadowAtlas = true;
+// Ӱͼÿ֡ػͼ (Դ 6 , ۹ 1 ), 0 ʾ
+int shadowAtlasBudget = 8;
+//  (̫) ļӰ, ׶ shadowDistance Ϊֹ
+bool sunShadows = true;
+//  (1-4) ÿһķֱ
+int shadowCascades = 4;
+int cascadeShadowSize = 2048;
+float shadowDistance = 100.f;
+// ָھ (0) Ͷ (1) ֮Ĳֵ
+float cascadeSplitLambda = 0.8f;
+// ִع: Դ;۹ư׶еĴط, ƬԪֻڴеĹԴ
+bool clusteredLighting = true;
+// ڳõĶԴ
+int extraLights = 0;
 
 #endif /* config_h */
@@ -12,14 +12,20 @@
 #include "Camera.h"
 #include "Config.h"
 #include "Engine.h"
+#include "GLExt.h"
+#include "GLState.h"
+#include "HeadlessContext.h"
 #include "Material.hpp"
 #include "System.hpp"
+#include "TextureManager.h"
 #include "VerticesData.h"
 #include <chrono>
+#include <fstream>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
 #include <iostream>
+#include <random>
 #include <thread>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -29,13 +35,26 @@
 #define DEFAULT_RADIUS 2.f
 #define SEGMENTS 100
 
-// 深度贴图尺寸
-#define DEPTHBUFFERWIDTH 1024
-#define DEPTHBUFFERHEIGHT 1024
-
-// 阴影深度贴图
-GLuint pingDepthMap, pongDepthMap;
-GLuint pingFBO, pongFBO;
+// 点光源阴影立方体贴图每个面的尺寸
+#define POINTSHADOWSIZE 1024
+// 阴影贴图使用的纹理单元, 材质纹理从 0 号单元开始
+#define POINTSHADOWUNIT 11
+#define SHADOWATLASUNIT 12
+#define SHADOWMOMENTSUNIT 13
+#define CASCADESHADOWUNIT 14
+// 分簇光照的三个纹理缓冲使用 15-17, 阴影图集中各光源的数据使用 18
+#define LIGHTCLUSTERUNIT 15
+#define SHADOWATLASLIGHTSUNIT 18
+// 分簇光照的屏幕分块数和深度分片数
+#define LIGHTCLUSTERTILESX 16
+#define LIGHTCLUSTERTILESY 9
+#define LIGHTCLUSTERSLICES 24
+// 阴影图集的尺寸和最小的视图, 最大的视图与立方体贴图的面相同
+#define SHADOWATLASSIZE 4096
+#define SHADOWATLASMINTILE 64
+// 立方体贴图的六个面使用 DrawView 槽位 1-6, 级联阴影使用 7-10, 阴影图集中的每个光源从 11 起各占 6 个
+#define CASCADESHADOWSLOT 7
+#define SHADOWATLASSLOT 11
 
 void framebufferSizeCallback(GLFWwindow *pWindow, int width, int height);
 void mouseCallback(GLFWwindow *pWindow, double x, double y);
@@ -46,42 +65,57 @@ void gLClearError();
 bool gLCheckError();
 void generateCircleVertices(float *vertices, int windowWidth, int windowHeight);
 
+// 每帧设置的 uniform 名称, 哈希在编译期计算
+namespace Uniforms
+{
+    constexpr UniformName model("model");
+    constexpr UniformName lightColor("lightColor");
+    constexpr UniformName albedo("albedo");
+    constexpr UniformName metallic("metallic");
+    constexpr UniformName roughness("roughness");
+    constexpr UniformName ao("ao");
+    constexpr UniformName pointShadowMap("pointShadowMap");
+    constexpr UniformName pointShadowFar("pointShadowFar");
+    constexpr UniformName pointShadowTexel("pointShadowTexel");
+    constexpr UniformName pointShadowFilter("pointShadowFilter");
+    constexpr UniformName pointShadowMoments("pointShadowMoments");
+    constexpr UniformName shadowAtlas("shadowAtlas");
+    constexpr UniformName shadowAtlasTexel("shadowAtlasTexel");
+    constexpr UniformName shadowAtlasLights("shadowAtlasLights");
+    constexpr UniformName cascadeShadowMap("cascadeShadowMap");
+    constexpr UniformName clusteredLights("clusteredLights");
+}
+
 static glm::dvec2 g_mousePos;
 static glm::dvec2 g_mouseLastPos;
 static std::atomic_bool bDebugging;
 const double targetFrameTime = 1.0 / 60.0;
 
-float quadVertices[] = {
-    // positions   // texCoords
-    -1.0f,
-    -1.0f,
-    0.0f,
-    0.0f,
-    1.0f,
-    -1.0f,
-    1.0f,
-    0.0f,
-    -1.0f,
-    1.0f,
-    0.0f,
-    1.0f,
-    1.0f,
-    1.0f,
-    1.0f,
-    1.0f,
-};
-
 Engine Engine::engine;
 Engine::Engine()
 {
     m_pWindow = nullptr;
+    m_screenFBO = 0;
     m_pointLight = nullptr;
     m_flashLight = nullptr;
+    m_sunLight = nullptr;
+    m_modelLoader = nullptr;
+    m_pointShadow = nullptr;
+    m_shadowAtlas = nullptr;
+    m_cascadedShadow = nullptr;
+    m_lightClusters = nullptr;
+    m_glDebug = false;
     m_programs.clear();
+    m_sceneVisible = 0;
+    m_pointLightReach = 0;
+    m_picked = RayHit();
+    m_hasPicked = false;
 }
 
 Engine::~Engine()
 {
+    // 退出前等待加载线程结束
+    delete m_modelLoader;
 }
 
 void Engine::start()
@@ -101,25 +135,60 @@ void Engine::start()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return;
     }
+    GLExt::load((GLADloadproc)glfwGetProcAddress);
+    if (m_glDebug)
+    {
+        GLExt::enableDebugOutput();
+    }
 
-    glCullFace(GL_BACK);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
-    // glEnable(GL_CULL_FACE);
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
     glfwSwapInterval(0);
-
-    // stbi_set_flip_vertically_on_load(true);
-    Material::loadMaterial();
-
+    initRenderState();
     initImgui();
     createSceneThings();
     initScene();
     renderLoop();
 }
 
+int Engine::startHeadless(const BenchmarkOptions &options)
+{
+    System::nScreenWidth = options.width;
+    System::nScreenHeight = options.height;
+
+    HeadlessContext context;
+    if (!context.create(options.glDebug))
+    {
+        return 1;
+    }
+
+    if (!gladLoadGLLoader(HeadlessContext::loader()))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+    GLExt::load(HeadlessContext::loader());
+    if (options.glDebug)
+    {
+        GLExt::enableDebugOutput();
+    }
+
+    if (!context.createFramebuffer(options.width, options.height))
+    {
+        return 1;
+    }
+    m_screenFBO = context.framebuffer();
+
+    initRenderState();
+    createSceneThings();
+    // 基准测试需要稳定的帧, 等待模型全部上传
+    m_modelLoader->flush();
+    initScene();
+    if (!options.bench.empty())
+    {
+        return runMicroBenchmark(options);
+    }
+    return renderHeadless(options);
+}
+
 void Engine::init()
 {
     // glfw: initialize and configure
@@ -133,9 +202,31 @@ void Engine::init()
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_SAMPLES, 4);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, m_glDebug ? GLFW_TRUE : GLFW_FALSE);
     glfwSwapInterval(0);
 }
 
+void Engine::initRenderState()
+{
+    GLState::cullFace(GL_BACK);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_MULTISAMPLE);
+    // GLState::enable(GL_CULL_FACE);
+    GLState::enable(GL_STENCIL_TEST);
+    GLState::stencilFunc(GL_NOTEQUAL, 1, 0xFF);
+    GLState::stencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    GLState::enable(GL_BLEND);
+    GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // 所有程序共享的 uniform 块
+    m_frameUniforms.create(UniformBlocks::FRAME, sizeof(FrameConstants));
+    m_lightUniforms.create(UniformBlocks::LIGHTS, sizeof(LightConstants));
+    m_startTime = std::chrono::steady_clock::now();
+
+    // stbi_set_flip_vertically_on_load(true);
+    Material::loadMaterial();
+}
+
 bool Engine::createWindow()
 {
     m_pWindow = nullptr;
@@ -181,7 +272,7 @@ void Engine::createSceneThings()
             //"bulb",
             //"outlining_effect",
 
-            "light", "skybox", "frontsight", "cook-torrance"};
+            "light", "skybox", "frontsight", "cook-torrance", "depth"};
 
     for (int i = 0; i < programNames.size(); ++i)
     {
@@ -189,6 +280,10 @@ void Engine::createSceneThings()
         m_programs[programNames[i]] = program;
     }
 
+    // 实例化版本, 模型矩阵来自逐实例顶点属性
+    m_programs["cook-torrance-instanced"] = new Program("cook-torrance", {"INSTANCED"});
+    m_programs["light-instanced"] = new Program("light", {"INSTANCED"});
+
     // 初始化加载模型
     std::vector<std::pair<std::string, std::string>> modelNamesAndPath =
         {
@@ -199,27 +294,31 @@ void Engine::createSceneThings()
             //{"bulb", "bulb/bulb_body.obj"},
         };
 
+    // 模型在线程池中导入和解码纹理, 渲染线程按每帧预算上传
+    m_modelLoader = new ModelLoader();
+    std::shared_ptr<GeometryArena> sceneArena = sceneGeometryArena ? std::make_shared<GeometryArena>() : nullptr;
     for (int i = 0; i < modelNamesAndPath.size(); ++i)
     {
         Model *model = new Model(modelNamesAndPath[i].second);
-        model->init();
+        if (useGeometryArena)
+            model->setGeometryArena(sceneArena ? sceneArena : std::make_shared<GeometryArena>());
+        model->setCompactVertices(compactVertices);
+        model->setPositionStream(positionStream);
+        model->setMultiDrawIndirect(multiDrawIndirect);
+        m_modelLoader->load(model);
         m_models[modelNamesAndPath[i].first] = model;
     }
 
-    // 放到线程中去初始化模型
-    //     std::thread t([&]() {
-    //         for (auto& model : m_models)
-    //         {
-    //             model.second->init();
-    //         }
-    //     });
-    //     t.join();
-
     m_pointLight = new PointLight(glm::vec3(2.42f, 1.7f, -1.5f));
     m_pointLights.push_back(m_pointLight);
     m_flashLight = new FlashLight(glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, -1.f));
     m_flashLight->on = false;
     m_flashLights.push_back(m_flashLight);
+    m_sunLight = new DirectionalLight(glm::normalize(glm::vec3(-0.4f, -1.f, -0.3f)));
+    m_sunLight->on = false;
+    m_directionalLights.push_back(m_sunLight);
+    m_lightClusters = new LightClusters();
+    m_lightClusters->create(LIGHTCLUSTERTILESX, LIGHTCLUSTERTILESY, LIGHTCLUSTERSLICES);
 
     createVAOs();
     createDepthBuffer();
@@ -230,9 +329,9 @@ void Engine::createVAOs()
 {
     GLuint CubeVAO, CubeVBO;
     glGenVertexArrays(1, &CubeVAO);
-    glBindVertexArray(CubeVAO);
+    GLState::bindVertexArray(CubeVAO);
     glGenBuffers(1, &CubeVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, CubeVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, CubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
@@ -244,9 +343,9 @@ void Engine::createVAOs()
 
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
-    glBindVertexArray(skyboxVAO);
+    GLState::bindVertexArray(skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
@@ -256,15 +355,15 @@ void Engine::createVAOs()
     generateCircleVertices(circle, System::nScreenWidth, System::nScreenHeight);
     unsigned int frontsightVAO, frontsightVBO;
     glGenVertexArrays(1, &frontsightVAO);
-    glBindVertexArray(frontsightVAO);
+    GLState::bindVertexArray(frontsightVAO);
     glGenBuffers(1, &frontsightVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, frontsightVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, frontsightVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(circle), circle, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
     m_VAOs["frontsight"] = frontsightVAO;
 
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 }
 
 void Engine::createTextures()
@@ -274,7 +373,7 @@ void Engine::createTextures()
     {
         // load cubemaps
         glGenTextures(1, &cubeMap);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+        GLState::bindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
         int width, height, nrChannels;
         unsigned char *data;
         for (unsigned int i = 0; i < textures_faces.size(); i++)
@@ -343,9 +442,6 @@ void Engine::initImgui()
 #pragma region Render
 void Engine::renderLoop()
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     double lastTime = 0.0;
     int fCount = 0;
 
@@ -377,10 +473,15 @@ void Engine::renderLoop()
                 Camera::main_camera.update();
             m_flashLight->position = Camera::main_camera.pos();
             m_flashLight->direction = Camera::main_camera.forward();
+            // 上传已解码的网格
+            m_modelLoader->update(uploadBudgetMs);
+            updateLights();
             // === 阶段 2: 渲染深度贴图 ===
-            // renderDepthBuffer();
+            renderDepthBuffer();
             // === 阶段 3: 渲染场景 ===
             renderScreen();
+            Program::endFrame();
+            GLState::endFrame();
             // === 阶段 4: 渲染菜单 ===
             renderIngui();
 
@@ -398,153 +499,574 @@ void Engine::renderLoop()
     }
 }
 
-void Engine::createDepthBuffer()
+int Engine::renderHeadless(const BenchmarkOptions &options)
 {
-    // 创建深度贴图
-    glGenTextures(1, &pingDepthMap);
-    glGenTextures(1, &pongDepthMap);
+    FrameProfiler profiler;
+    profiler.init(options.frames);
 
-    // 为立方体贴图的 6 个面分配空间，并设置纹理参数
-    glBindTexture(GL_TEXTURE_CUBE_MAP, pingDepthMap);
-    for (GLuint i = 0; i < 6; ++i)
+    // 预热帧包含模型网格的首次上传, 不计入统计
+    int totalFrames = options.warmupFrames + options.frames;
+    for (int i = 0; i < totalFrames; ++i)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT,
-                     DEPTHBUFFERWIDTH, DEPTHBUFFERHEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        bool measured = i >= options.warmupFrames;
+        if (measured)
+            profiler.beginFrame();
+
+        Camera::main_camera.update();
+        m_flashLight->position = Camera::main_camera.pos();
+        m_flashLight->direction = Camera::main_camera.forward();
+        updateLights();
+        renderDepthBuffer();
+        renderScreen();
+        Program::endFrame();
+        GLState::endFrame();
+        glFlush();
+
+        if (measured)
+            profiler.endFrame();
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    profiler.finish();
+
+    nlohmann::json report = profiler.report();
+    report["renderer"] = (const char *)glGetString(GL_RENDERER);
+    report["version"] = (const char *)glGetString(GL_VERSION);
+    report["width"] = options.width;
+    report["height"] = options.height;
+    report["warmup"] = options.warmupFrames;
+
+    // 最后一帧的 uniform 提交与跳过次数
+    report["uniforms"] = {
+        {"submitted", Program::frameStats().submitted},
+        {"skipped", Program::frameStats().skipped},
+    };
+
+    // 最后一帧的 gl 状态调用与被过滤的次数
+    report["state"] = {
+        {"issued", GLState::frameStats().issued},
+        {"elided", GLState::frameStats().elided},
+    };
+
+    // 模型加载耗时, 解码时间为所有工作线程之和
+    ModelLoader::Stats loadStats = m_modelLoader->stats();
+    report["loading"] = {
+        {"decode_ms", loadStats.decodeMs},
+        {"upload_ms", loadStats.uploadMs},
+        {"textures_decoded", loadStats.texturesDecoded},
+        {"textures_uploaded", loadStats.texturesUploaded},
+        {"meshes_uploaded", loadStats.meshesUploaded},
+        {"bytes_uploaded", loadStats.bytesUploaded},
+    };
+
+    // 几何缓冲与绘制调用
+    Model *ball = m_models.at("pool-ball");
+    report["geometry"] = {
+        {"arena", ball->geometryArena() != nullptr},
+        {"multi_draw_indirect", multiDrawIndirect && GLExt::hasMultiDrawIndirect()},
+        {"draw_calls", ball->drawCalls()},
+        {"frustum_culling", frustumCulling},
+        {"meshes_drawn", ball->drawnMeshes()},
+        {"meshes_culled", ball->culledMeshes()},
+        {"triangles_drawn", ball->drawnTriangles()},
+        {"compact_vertices", compactVertices},
+        {"depth_prepass", depthPrepass},
+        {"position_stream", positionStream},
+        {"vertex_bytes", ball->vertexBytes()},
+    };
+
+    // 导入时处理过的网格的顶点缓存未命中率 (ACMR), 从网格缓存映射的网格没有
+    nlohmann::json meshStats = nlohmann::json::array();
+    for (auto &model : m_models)
+    {
+        for (size_t i = 0; i < model.second->meshCount(); ++i)
+        {
+            Mesh *mesh = model.second->mesh(i);
+            if (const Mesh::ImportStats *stats = mesh->importStats())
+            {
+                meshStats.push_back({
+                    {"model", model.first},
+                    {"mesh", stats->name},
+                    {"vertices", mesh->vertexCount()},
+                    {"triangles", mesh->lods().empty() ? mesh->indexCount() / 3 : mesh->lods()[0].indexCount / 3},
+                    {"lods", mesh->lods().size()},
+                    {"acmr_imported", stats->importedAcmr},
+                    {"acmr_welded", stats->weldedAcmr},
+                    {"acmr_optimized", stats->optimizedAcmr},
+                });
+            }
+        }
+    }
+    report["geometry"]["mesh_processing"] = meshStats;
+
+    // 点光源阴影, 最后一帧的渲染统计和静态缓存的重绘次数
+    report["shadows"] = {
+        {"point_shadows", pointShadows},
+        {"method", PointShadow::methodName(m_pointShadow->method())},
+        {"filter", PointShadow::filterName(m_pointShadow->filter())},
+        {"size", m_pointShadow->size()},
+        {"passes", m_pointShadow->stats().passes},
+        {"draw_calls", m_pointShadow->stats().drawCalls},
+        {"face_triangles", m_pointShadow->stats().faceTriangles},
+        {"shadow_cache", shadowCache},
+        {"static_updates", m_pointShadow->staticUpdates()},
+        {"static_casters", m_pointShadow->stats().staticCasters},
+        {"dynamic_casters", m_pointShadow->stats().dynamicCasters},
+    };
+
+    // 阴影图集, 最后一帧重绘的视图和仍然过期的视图
+    const ShadowAtlas::Stats &atlasStats = m_shadowAtlas->stats();
+    report["shadow_atlas"] = {
+        {"enabled", shadowAtlas},
+        {"size", m_shadowAtlas->size()},
+        {"budget", shadowAtlasBudget},
+        {"lights", atlasStats.lights},
+        {"shadowed_lights", atlasStats.shadowedLights},
+        {"views", atlasStats.views},
+        {"drawn_views", atlasStats.drawnViews},
+        {"stale_views", atlasStats.staleViews},
+        {"draw_calls", atlasStats.drawCalls},
+        {"triangles", atlasStats.triangles},
+        {"occupancy", atlasStats.occupancy},
+    };
+
+    // 太阳的级联阴影, 最后一帧的渲染统计
+    const CascadedShadow::Stats &cascadeStats = m_cascadedShadow->stats();
+    report["cascades"] = {
+        {"enabled", sunShadows && m_sunLight->on},
+        {"cascades", cascadeStats.cascades},
+        {"size", m_cascadedShadow->size()},
+        {"distance", shadowDistance},
+        {"layered", cascadeStats.layered},
+        {"passes", cascadeStats.passes},
+        {"draw_calls", cascadeStats.drawCalls},
+        {"triangles", cascadeStats.triangles},
+        {"updates", m_cascadedShadow->updates()},
+    };
+
+    // 分簇光照, 最后一帧的分组统计
+    const LightClusters::Stats &clusterStats = m_lightClusters->stats();
+    report["lighting"] = {
+        {"clustered", clusteredLighting},
+        {"lights", clusterStats.lights},
+        {"visible_lights", clusterStats.visibleLights},
+        {"clusters", clusterStats.clusters},
+        {"occupied_clusters", clusterStats.occupiedClusters},
+        {"references", clusterStats.references},
+        {"max_lights_per_cluster", clusterStats.maxLights},
+        {"bin_ms", clusterStats.binMs},
+    };
+
+    // 场景包围体层次的查询结果
+    report["scene"] = {
+        {"objects", m_sceneBVH.size()},
+        {"nodes", m_sceneBVH.nodeCount()},
+        {"in_view", m_sceneVisible},
+        {"point_light_reach", m_pointLightReach},
+        {"picked", m_hasPicked},
+    };
+
+    // 全局纹理缓存, 同一文件只解码上传一次
+    TextureManager::Stats textureStats = TextureManager::instance().stats();
+    report["textures"] = {
+        {"live", textureStats.live},
+        {"hits", textureStats.hits},
+        {"misses", textureStats.misses},
+    };
+
+    if (!writeReport(report, options.output))
+    {
+        return 1;
+    }
+    return gLCheckError() ? 0 : 1;
+}
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, pongDepthMap);
-    for (GLuint i = 0; i < 6; ++i)
+int Engine::runMicroBenchmark(const BenchmarkOptions &options)
+{
+    nlohmann::json report;
+    if (options.bench == "uniforms")
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT,
-                     DEPTHBUFFERWIDTH, DEPTHBUFFERHEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        std::vector<std::string> textureTypes;
+        Model *ball = m_models.at("pool-ball");
+        for (size_t i = 0; i < ball->meshCount(); ++i)
+        {
+            for (const Texture &texture : ball->mesh(i)->textures())
+            {
+                textureTypes.push_back(texture.type);
+            }
+        }
+        report = MicroBenchmark::uniforms(m_programs.at("cook-torrance"), textureTypes, options.iterations);
+    }
+    else if (options.bench == "draws")
+    {
+        // 每帧提交 256 个小网格
+        report = MicroBenchmark::drawSubmission(m_programs.at("cook-torrance"), 256, options.iterations);
+    }
+    else if (options.bench == "instancing")
+    {
+        // 灯光沿用场景的, 相机改为从斜上方看向原点处边长 40 的网格
+        updateFrameUniforms();
+        FrameConstants frame = {};
+        frame.view = glm::lookAt(glm::vec3(0.f, 30.f, 75.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+        frame.project = m_project;
+        frame.viewPos = glm::vec3(0.f, 30.f, 75.f);
+        m_frameUniforms.update(frame);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_screenFBO);
+        glViewport(0, 0, System::nScreenWidth, System::nScreenHeight);
+
+        std::vector<int> counts = {1, 10, 100, 1000, 10000, 100000};
+        report = MicroBenchmark::instancing(m_models.at("pool-ball"), m_programs.at("cook-torrance-instanced"), m_programs.at("cook-torrance"),
+                                            counts, options.frames, 40.f, 10000);
+    }
+    else if (options.bench == "bvh")
+    {
+        // 随机生成的大场景, 不依赖已加载的模型
+        report = MicroBenchmark::sceneBVH({10000, 100000}, options.iterations);
+    }
+    else if (options.bench == "shadows")
+    {
+        // 光源周围随机分布的 512 个球体
+        report = MicroBenchmark::pointShadows(512, POINTSHADOWSIZE, options.frames);
+    }
+    else if (options.bench == "atlas")
+    {
+        // 32 个光源照亮场地上随机分布的 1024 个球体
+        report = MicroBenchmark::shadowAtlas(32, 1024, SHADOWATLASSIZE, options.frames);
+    }
+    else if (options.bench == "cascades")
+    {
+        // 400 x 400 的场地上随机分布的 4096 个球体, 相机在场地上走动
+        report = MicroBenchmark::cascadedShadows(4096, 2048, options.frames);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    else if (options.bench == "clusters")
+    {
+        // 场地上的球体被越来越多的点光源照亮, 逐片元计算所有光源和只计算所在簇中的光源
+        updateFrameUniforms();
+        glm::vec3 eye(0.f, 12.f, 40.f);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+        FrameConstants frame = {};
+        frame.view = view;
+        frame.project = m_project;
+        frame.viewPos = eye;
+        m_frameUniforms.update(frame);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_screenFBO);
+        glViewport(0, 0, System::nScreenWidth, System::nScreenHeight);
+        // 阴影采样器各自占用一个纹理单元, 否则不同类型的采样器落在同一单元上无法绘制
+        Program *ct = m_programs.at("cook-torrance");
+        ct->use();
+        bindShadowMaps(ct);
 
-    glGenFramebuffers(1, &pingFBO);
-    glGenFramebuffers(1, &pongFBO);
+        std::vector<int> counts = {8, 64, 256, 1024};
+        report = MicroBenchmark::clusteredLighting(ct, view, m_project, System::nScreenWidth, System::nScreenHeight,
+                                                   LIGHTCLUSTERUNIT, counts, options.frames);
+    }
+    else
+    {
+        std::cerr << "unknown benchmark: " << options.bench << std::endl;
+        return 1;
+    }
+
+    report["renderer"] = (const char *)glGetString(GL_RENDERER);
+    if (!writeReport(report, options.output))
+    {
+        return 1;
+    }
+    return gLCheckError() ? 0 : 1;
+}
+
+void Engine::createDepthBuffer()
+{
+    m_pointShadow = new PointShadow();
+    m_pointShadow->create(POINTSHADOWSIZE);
+    m_shadowAtlas = new ShadowAtlas();
+    m_shadowAtlas->create(SHADOWATLASSIZE, POINTSHADOWSIZE, SHADOWATLASMINTILE, SHADOWATLASSLOT);
+    m_cascadedShadow = new CascadedShadow();
+    m_cascadedShadow->create(CASCADESHADOWSLOT);
 }
 
 void Engine::renderDepthBuffer()
 {
-    // 为点光源的 6 个方向设置视角矩阵和投影矩阵
-    float nearPlane = 1.0f, farPlane = 100.f;
-    glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
-    glm::vec3 lightPos = m_pointLight->position;
-    std::vector<glm::mat4> shadowTransforms;
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
-    if (m_pointLight->on)
+    // 所有已导入的模型都投射阴影, 远平面取光源照射范围. 场景中的模型不会移动, 作为静态投射体缓存
+    std::vector<ShadowCaster> casters;
+    for (const auto &model : m_models)
     {
-        // 第一步：渲染到 pingDepthMap
-        gLClearError();
-        glViewport(0, 0, DEPTHBUFFERWIDTH, DEPTHBUFFERHEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, pingFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        Program *shadowShader = m_programs.at("shadow");
-        shadowShader->use();
-        shadowShader->setUniform3f("lightPos", lightPos);
-        shadowShader->setUniform1f("far_plane", farPlane);
-        shadowShader->setUniformMatrix4fv("shadowMatrices", shadowTransforms);
-
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pingDepthMap, 0);
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-
-        //         if (nanosuit->loadFinished())
-        //         {
-        //             glm::mat4 model = glm::translate(glm::mat4(1.0f), nanosuit->getPosition());
-        //             shadowShader->setUniformMatrix4fv("model", model);
-        //             //nanosuit->draw(shadowShader);
-        //         }
-        //
-        //         if (plane->loadFinished())
-        //         {
-        //             glm::mat4 model = glm::translate(glm::mat4(1.0f), plane->getPosition());
-        //             shadowShader->setUniformMatrix4fv("model", model);
-        //             //plane->draw(shadowShader);
-        //         }
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        assert(gLCheckError());
-
-        // 第二步：模糊到 pongDepthMap
-        gLClearError();
-        glViewport(0, 0, DEPTHBUFFERWIDTH, DEPTHBUFFERHEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, pongFBO);
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        glActiveTexture(GL_TEXTURE11);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, pingDepthMap);
-        Program *blurshadowShader = m_programs.at("blurshadow");
-        blurshadowShader->use();
-        blurshadowShader->setUniform1i("sourceDepthMap", 11);
-
-        GLuint quadVAO, quadVBO;
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
-
-        for (int i = 0; i < 6; ++i)
+        if (model.second->isImported())
+            casters.push_back({model.second, glm::translate(glm::mat4(1.0f), model.second->getPosition()), false});
+    }
+
+    if (shadowAtlas)
+    {
+        // 所有开启的光源按照射范围在屏幕上的大小分配图集中的分辨率, 图集放不下时最不重要的光源没有阴影
+        DrawView camera(Camera::main_camera.view(), m_project, Camera::main_camera.pos(), (float)System::nScreenHeight, lodPixelError);
+        std::vector<ShadowLight> lights;
+        for (PointLight *light : m_pointLights)
+        {
+            if (!light->on || !pointShadows)
+                continue;
+            ShadowLight shadowLight = {light, ShadowLight::POINT, light->position, glm::vec3(0.f), 0.f, light->color, light->intensity, 0.f};
+            shadowLight.screenSize = ShadowAtlas::screenSize(shadowLight, camera);
+            lights.push_back(shadowLight);
+        }
+        for (FlashLight *light : m_flashLights)
         {
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, pongDepthMap, 0);
-            glClear(GL_DEPTH_BUFFER_BIT);
-            blurshadowShader->setUniform1i("faceIndex", i);
-            glBindVertexArray(quadVAO);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            if (!light->on)
+                continue;
+            ShadowLight shadowLight = {light, ShadowLight::SPOT, light->position, light->direction, 2.f * glm::acos(light->outerCutOff), light->color,
+                                       light->intensity, 0.f};
+            shadowLight.screenSize = ShadowAtlas::screenSize(shadowLight, camera);
+            lights.push_back(shadowLight);
         }
-        assert(gLCheckError());
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDeleteVertexArrays(1, &quadVAO);
-        glDeleteBuffers(1, &quadVBO);
+        if (!shadowCache)
+            m_shadowAtlas->invalidate();
+        m_shadowAtlas->update(lights, casters, shadowAtlasBudget, lodPixelError);
+    }
+    else if (pointShadows && m_pointLight->on)
+    {
+        if (!shadowCache)
+            m_pointShadow->invalidate();
+        m_pointShadow->render(m_pointLight->position, m_pointLight->reach(), casters, (PointShadow::Method)pointShadowMethod, lodPixelError,
+                              (PointShadow::Filter)shadowFilter);
+    }
+
+    // 太阳照亮整个场景, 所有投射体都画进覆盖它们的级联
+    if (sunShadows && m_sunLight->on)
+    {
+        CascadedShadow::Settings settings;
+        settings.cascades = shadowCascades;
+        settings.size = cascadeShadowSize;
+        settings.distance = shadowDistance;
+        settings.splitLambda = cascadeSplitLambda;
+        settings.maxPixelError = lodPixelError;
+        if (!shadowCache)
+            m_cascadedShadow->invalidate();
+        m_cascadedShadow->render(m_sunLight->direction, Camera::main_camera.view(), m_project, casters, settings);
+    }
+}
+
+void Engine::updateFrameUniforms()
+{
+    FrameConstants frame;
+    frame.view = Camera::main_camera.view();
+    frame.project = m_project;
+    frame.viewPos = Camera::main_camera.pos();
+    frame.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_startTime).count();
+    m_frameUniforms.update(frame);
+
+    // 只上传开启的光源, 阴影图集中还没画完的光源暂时不投射阴影
+    LightConstants lights = {};
+    for (PointLight *light : m_pointLights)
+    {
+        if (!light->on || lights.pointLightCount >= UniformBlocks::MAX_POINT_LIGHTS)
+            continue;
+        PointLightData &data = lights.pointLights[lights.pointLightCount++];
+        data.position = light->position;
+        data.intensity = light->intensity;
+        data.color = light->color;
+        data.range = light->reach();
+        pointShadowMap(light, data.shadowMap, data.shadowIndex);
+    }
+    for (FlashLight *light : m_flashLights)
+    {
+        if (!light->on || lights.spotLightCount >= UniformBlocks::MAX_SPOT_LIGHTS)
+            continue;
+        SpotLightData &data = lights.spotLights[lights.spotLightCount++];
+        data.position = light->position;
+        data.intensity = light->intensity;
+        data.direction = light->direction;
+        data.cutOff = light->cutOff;
+        data.color = light->color;
+        data.outerCutOff = light->outerCutOff;
+        data.range = light->reach();
+        spotShadowMap(light, data.shadowMap, data.shadowIndex);
+    }
+    for (DirectionalLight *light : m_directionalLights)
+    {
+        if (!light->on || lights.directionalLightCount >= UniformBlocks::MAX_DIRECTIONAL_LIGHTS)
+            continue;
+        DirectionalLightData &data = lights.directionalLights[lights.directionalLightCount++];
+        data.direction = glm::normalize(light->direction);
+        data.intensity = light->intensity;
+        data.color = light->color;
+        data.shadowMap = ShadowMaps::NONE;
+        if (light == m_sunLight && sunShadows && m_cascadedShadow->cascades() > 0)
+        {
+            data.shadowMap = ShadowMaps::CASCADES;
+            data.cascadeCount = m_cascadedShadow->cascades();
+            for (int i = 0; i < data.cascadeCount; ++i)
+            {
+                data.cascadeSplits[i] = m_cascadedShadow->split(i);
+                data.cascadeTexels[i] = m_cascadedShadow->texelSize(i);
+                data.cascadeMatrices[i] = m_cascadedShadow->matrix(i);
+            }
+        }
+    }
+    m_lightUniforms.update(lights);
+
+    // 分簇光照包含所有开启的点光源和聚光灯, 阴影与 uniform 块中的光源一样从阴影图集的光源数据中读取
+    std::vector<LightClusters::Light> clusterLights;
+    for (PointLight *light : m_pointLights)
+    {
+        if (!light->on)
+            continue;
+        int shadowMap, shadowIndex;
+        pointShadowMap(light, shadowMap, shadowIndex);
+        clusterLights.push_back({LightClusters::Light::POINT, light->position, light->color, light->intensity, glm::vec3(0.f), 0.f, 0.f, shadowMap,
+                                 shadowIndex});
+    }
+    for (FlashLight *light : m_flashLights)
+    {
+        if (!light->on)
+            continue;
+        int shadowMap, shadowIndex;
+        spotShadowMap(light, shadowMap, shadowIndex);
+        clusterLights.push_back({LightClusters::Light::SPOT, light->position, light->color, light->intensity, light->direction, light->cutOff,
+                                 light->outerCutOff, shadowMap, shadowIndex});
+    }
+    if (clusteredLighting)
+        m_lightClusters->update(clusterLights, Camera::main_camera.view(), m_project, System::nScreenWidth, System::nScreenHeight);
+}
+
+void Engine::pointShadowMap(PointLight *light, int &shadowMap, int &shadowIndex) const
+{
+    // 阴影图集中还没画完的光源暂时不投射阴影, 关闭图集时只有 m_pointLight 使用立方体阴影贴图
+    const ShadowAtlas::Entry *entry = shadowAtlas ? m_shadowAtlas->find(light) : nullptr;
+    shadowMap = ShadowMaps::NONE;
+    shadowIndex = entry ? entry->index : -1;
+    if (entry)
+        shadowMap = ShadowMaps::ATLAS;
+    else if (!shadowAtlas && light == m_pointLight && pointShadows)
+        shadowMap = ShadowMaps::CUBE;
+}
+
+void Engine::spotShadowMap(FlashLight *light, int &shadowMap, int &shadowIndex) const
+{
+    const ShadowAtlas::Entry *entry = shadowAtlas ? m_shadowAtlas->find(light) : nullptr;
+    shadowMap = entry ? ShadowMaps::ATLAS : ShadowMaps::NONE;
+    shadowIndex = entry ? entry->index : -1;
+}
+
+void Engine::bindShadowMaps(Program *ct)
+{
+    // 阴影: 立方体贴图和阴影图集, 两种采样器不能共用纹理单元
+    GLState::bindTexture(POINTSHADOWUNIT, GL_TEXTURE_CUBE_MAP, m_pointShadow->depthMap());
+    ct->setUniform1i(Uniforms::pointShadowMap, POINTSHADOWUNIT);
+    ct->setUniform1f(Uniforms::pointShadowFar, m_pointShadow->farPlane());
+    ct->setUniform1f(Uniforms::pointShadowTexel, 2.f / m_pointShadow->size());
+    GLState::bindTexture(SHADOWMOMENTSUNIT, GL_TEXTURE_CUBE_MAP, m_pointShadow->momentMap());
+    ct->setUniform1i(Uniforms::pointShadowMoments, SHADOWMOMENTSUNIT);
+    ct->setUniform1i(Uniforms::pointShadowFilter, m_pointShadow->filter());
+    GLState::bindTexture(SHADOWATLASUNIT, GL_TEXTURE_2D, m_shadowAtlas->depthMap());
+    ct->setUniform1i(Uniforms::shadowAtlas, SHADOWATLASUNIT);
+    ct->setUniform1f(Uniforms::shadowAtlasTexel, 1.f / m_shadowAtlas->size());
+    GLState::bindTexture(SHADOWATLASLIGHTSUNIT, GL_TEXTURE_BUFFER, m_shadowAtlas->lightBuffer());
+    ct->setUniform1i(Uniforms::shadowAtlasLights, SHADOWATLASLIGHTSUNIT);
+    GLState::bindTexture(CASCADESHADOWUNIT, GL_TEXTURE_2D_ARRAY, m_cascadedShadow->depthMap());
+    ct->setUniform1i(Uniforms::cascadeShadowMap, CASCADESHADOWUNIT);
+}
+
+void Engine::updateLights()
+{
+    // 额外的点光源排在 m_pointLight 之后, 位置和颜色只由序号决定, 数量变化时已有的光源不动
+    int count = std::max(extraLights, 0);
+    while ((int)m_pointLights.size() - 1 > count)
+    {
+        delete m_pointLights.back();
+        m_pointLights.pop_back();
+    }
+    while ((int)m_pointLights.size() - 1 < count)
+    {
+        std::mt19937 random((unsigned int)m_pointLights.size());
+        std::uniform_real_distribution<float> across(-30.f, 30.f);
+        std::uniform_real_distribution<float> height(0.5f, 4.f);
+        std::uniform_real_distribution<float> channel(0.2f, 1.f);
+        PointLight *light = new PointLight(glm::vec3(across(random), height(random), across(random)),
+                                           glm::vec3(channel(random), channel(random), channel(random)));
+        light->intensity = 0.25f;
+        m_pointLights.push_back(light);
+    }
+}
+
+void Engine::updateScene()
+{
+    // 模型在后台导入, 网格数变化时重建, 否则只更新移动过的包围盒
+    size_t objectCount = 0;
+    for (const auto &model : m_models)
+    {
+        objectCount += model.second->meshCount();
+    }
+    if (objectCount != m_sceneObjects.size())
+    {
+        m_sceneBVH.clear();
+        m_sceneObjects.clear();
+    }
+    uint32_t object = 0;
+    for (const auto &model : m_models)
+    {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), model.second->getPosition());
+        for (size_t i = 0; i < model.second->meshCount(); ++i, ++object)
+        {
+            AABB box = model.second->mesh(i)->bounds().transformed(transform);
+            if (object == m_sceneObjects.size())
+            {
+                m_sceneBVH.add(box);
+                m_sceneObjects.push_back({model.first, i});
+            }
+            else if (box.min != m_sceneBVH.bounds(object).min || box.max != m_sceneBVH.bounds(object).max)
+            {
+                m_sceneBVH.update(object, box);
+            }
+        }
+    }
+    if (m_sceneBVH.needsBuild())
+    {
+        m_sceneBVH.build();
+    }
+    else
+    {
+        m_sceneBVH.refit();
+    }
+
+    std::vector<uint32_t> objects;
+    m_sceneBVH.cull(Frustum(m_project * Camera::main_camera.view()), objects);
+    m_sceneVisible = (int)objects.size();
+
+    // 准星拾取: 沿相机朝向最近的包围盒
+    m_hasPicked = m_sceneBVH.raycast(Camera::main_camera.pos(), Camera::main_camera.forward(), 500.f, m_picked);
+
+    // 点光源按平方反比衰减, 辐射度低于 1/256 之外视为照不到
+    m_pointLightReach = 0;
+    if (m_pointLight->on)
+    {
+        BoundingSphere reach = {m_pointLight->position, m_pointLight->reach()};
+        objects.clear();
+        m_sceneBVH.overlap(reach, objects);
+        m_pointLightReach = (int)objects.size();
     }
 }
 
 void Engine::renderScreen()
 {
+    updateFrameUniforms();
+    updateScene();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_screenFBO);
     glViewport(0, 0, System::nScreenWidth, System::nScreenHeight);
     glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     if (renderSkyBox)
     {
-        glDepthFunc(GL_LEQUAL);
+        GLState::depthFunc(GL_LEQUAL);
         Program *skyboxShader = m_programs.at("skybox");
         skyboxShader->use();
-        skyboxShader->setUniformMatrix4fv("project", m_project);
-        skyboxShader->setUniformMatrix4fv("view", Camera::main_camera.view());
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, m_textures.at("skybox"));
-        glBindVertexArray(m_VAOs.at("skybox"));
+        GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, m_textures.at("skybox"));
+        GLState::bindVertexArray(m_VAOs.at("skybox"));
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDepthFunc(GL_LESS);
+        GLState::depthFunc(GL_LESS);
     }
 
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_ALWAYS, 1, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-    glEnable(GL_DEPTH_TEST);
+    // 状态缓存会过滤掉与上一帧相同的设置
+    GLState::enable(GL_STENCIL_TEST);
+    GLState::stencilFunc(GL_ALWAYS, 1, 0xFF);
+    GLState::stencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    GLState::enable(GL_DEPTH_TEST);
 
     // 渲染模型
     renderCookTorrancePBR();
@@ -556,18 +1078,15 @@ void Engine::renderScreen()
         lightShader->use();
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, -.5f, -10.0f));
-        lightShader->setUniform3f("lightColor", m_pointLight->color * m_pointLight->intensity);
-        lightShader->setUniformMatrix4fv("model", model);
-        lightShader->setUniformMatrix4fv("project", m_project);
-        lightShader->setUniformMatrix4fv("view", Camera::main_camera.view());
+        lightShader->setUniform3f(Uniforms::lightColor, m_pointLight->color * m_pointLight->intensity);
+        lightShader->setUniformMatrix4fv(Uniforms::model, model);
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, m_pointLight->position);
         model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
-        lightShader->setUniformMatrix4fv("model", model);
-        glBindVertexArray(m_VAOs.at("cube"));
+        lightShader->setUniformMatrix4fv(Uniforms::model, model);
+        GLState::bindVertexArray(m_VAOs.at("cube"));
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
     }
 
     //     {
@@ -686,6 +1205,31 @@ void Engine::renderIngui()
             ImGui::PopItemWidth();
         }
 
+        if (ImGui::CollapsingHeader("sun light"))
+        {
+            ImGui::Text("direction:");
+            ImGui::SameLine();
+            float direction[3] = {m_sunLight->direction.x, m_sunLight->direction.y, m_sunLight->direction.z};
+            if (ImGui::DragFloat3("##sun direction", direction, 0.01f, -1.f, 1.f, "%.2f") && glm::length(glm::vec3(direction[0], direction[1], direction[2])) > 0.01f)
+                m_sunLight->direction = glm::normalize(glm::vec3(direction[0], direction[1], direction[2]));
+            ImGui::Checkbox("##enable sun light", &m_sunLight->on);
+            ImGui::SameLine();
+            ImVec4 selectedColor = ImVec4(m_sunLight->color.x, m_sunLight->color.y, m_sunLight->color.z, 1.0f);
+            ImGui::ColorButton("##sun light color", selectedColor);
+            ImGui::PushItemWidth(60.0f);
+            ImGui::SameLine();
+            ImGui::SliderFloat("##sun light r", &m_sunLight->color.x, 0.0f, 1.0f, "%.2f");
+            ImGui::SameLine();
+            ImGui::SliderFloat("##sun light g", &m_sunLight->color.y, 0.0f, 1.0f, "%.2f");
+            ImGui::SameLine();
+            ImGui::SliderFloat("##sun light b", &m_sunLight->color.z, 0.0f, 1.0f, "%.2f");
+            ImGui::PopItemWidth();
+            ImGui::Text("intensity:");
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(100.0f);
+            ImGui::SliderFloat("##sun light intensity", &m_sunLight->intensity, 0.f, 10.f, "%.2f");
+        }
+
         if (ImGui::CollapsingHeader("point light 1", ImGuiTreeNodeFlags_DefaultOpen))
         {
             ImGui::Text("light pos:");
@@ -715,6 +1259,22 @@ void Engine::renderIngui()
             };
             ImGui::PopItemWidth();
         }
+
+        if (ImGui::CollapsingHeader("clustered lights"))
+        {
+            ImGui::Checkbox("clustered lighting", &clusteredLighting);
+            ImGui::Text("extra point lights:");
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(150.0f);
+            ImGui::SliderInt("##extra lights", &extraLights, 0, 1024);
+            if (clusteredLighting)
+            {
+                const LightClusters::Stats &stats = m_lightClusters->stats();
+                ImGui::Text("lights: %d visible / %d, clusters: %d used / %d", stats.visibleLights, stats.lights, stats.occupiedClusters, stats.clusters);
+                ImGui::Text("lights per cluster: %.2f avg, %d max, binning %.3f ms", stats.occupiedClusters ? (float)stats.references / stats.occupiedClusters : 0.f,
+                            stats.maxLights, stats.binMs);
+            }
+        }
         ImGui::Unindent(DEFAULT_INDENT);
     }
 
@@ -725,6 +1285,99 @@ void Engine::renderIngui()
         ImGui::Text("frame: %d", frameCount);
         ImGui::Text("camera pos: %.2f %.2f %.2f", Camera::main_camera.pos().x, Camera::main_camera.pos().y, Camera::main_camera.pos().z);
         ImGui::Text("camera forward: %.2f %.2f %.2f", Camera::main_camera.forward().x, Camera::main_camera.forward().y, Camera::main_camera.forward().z);
+        ImGui::Text("uniforms: %llu submitted, %llu skipped", (unsigned long long)Program::frameStats().submitted, (unsigned long long)Program::frameStats().skipped);
+        ImGui::Text("state changes: %llu issued, %llu elided", (unsigned long long)GLState::frameStats().issued, (unsigned long long)GLState::frameStats().elided);
+        ImGui::Text("pending uploads: %d", m_modelLoader->pending());
+        ModelLoader::Stats loadStats = m_modelLoader->stats();
+        ImGui::Text("texture decode: %.1f ms (%d textures, all threads)", loadStats.decodeMs, loadStats.texturesDecoded);
+        ImGui::Text("gpu upload: %.1f ms (%d meshes, %.1f MB)", loadStats.uploadMs, loadStats.meshesUploaded, loadStats.bytesUploaded / (1024.0 * 1024.0));
+        Model *ball = m_models.at("pool-ball");
+        ImGui::Text("pool-ball: %d draw calls (%s)", ball->drawCalls(),
+                    !ball->geometryArena() ? "per mesh" : multiDrawIndirect && GLExt::hasMultiDrawIndirect() ? "multi-draw indirect" : "multi-draw base vertex");
+        ImGui::Text("scene: %d objects, %d in view, %d lit by point light", (int)m_sceneBVH.size(), m_sceneVisible, m_pointLightReach);
+        if (m_hasPicked)
+        {
+            const SceneObject &picked = m_sceneObjects[m_picked.object];
+            ImGui::Text("picked: %s mesh %d at %.2f", picked.model.c_str(), (int)picked.mesh, m_picked.distance);
+        }
+        else
+        {
+            ImGui::Text("picked: none");
+        }
+        ImGui::Text("frustum culling:");
+        ImGui::SameLine();
+        ImGui::Checkbox("##frustum culling", &frustumCulling);
+        ImGui::SameLine();
+        ImGui::Text("%d meshes drawn, %d culled, %d triangles", ball->drawnMeshes(), ball->culledMeshes(), ball->drawnTriangles());
+        ImGui::Text("lod error:");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderFloat("##lod error", &lodPixelError, 0.1f, 16.f, "%.1f px");
+        ImGui::Text("depth prepass:");
+        ImGui::SameLine();
+        ImGui::Checkbox("##depth prepass", &depthPrepass);
+        ImGui::Text("point shadows:");
+        ImGui::SameLine();
+        ImGui::Checkbox("##point shadows", &pointShadows);
+        ImGui::SameLine();
+        ImGui::BeginDisabled(shadowAtlas);
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::Combo("##point shadow method", &pointShadowMethod, "geometry shader\0layered\0culled faces\0");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(80.0f);
+        ImGui::Combo("##shadow filter", &shadowFilter, "pcf\0esm\0evsm\0");
+        ImGui::EndDisabled();
+        if (shadowAtlas)
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(cube map only)");
+        }
+        const PointShadow::Stats &shadowStats = m_pointShadow->stats();
+        ImGui::Text("shadow: %s, %d passes, %d draw calls, %d face triangles", PointShadow::methodName(m_pointShadow->method()), shadowStats.passes,
+                    shadowStats.drawCalls, shadowStats.faceTriangles);
+        ImGui::Text("shadow cache:");
+        ImGui::SameLine();
+        ImGui::Checkbox("##shadow cache", &shadowCache);
+        ImGui::SameLine();
+        ImGui::Text("%d static casters (%d updates), %d dynamic", shadowStats.staticCasters, m_pointShadow->staticUpdates(), shadowStats.dynamicCasters);
+        ImGui::Text("shadow atlas:");
+        ImGui::SameLine();
+        ImGui::Checkbox("##shadow atlas", &shadowAtlas);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderInt("##shadow atlas budget", &shadowAtlasBudget, 0, 48, "%d views");
+        const ShadowAtlas::Stats &atlasStats = m_shadowAtlas->stats();
+        ImGui::Text("atlas: %d/%d lights, %d views (%d drawn, %d stale), %.0f%% used", atlasStats.shadowedLights, atlasStats.lights, atlasStats.views,
+                    atlasStats.drawnViews, atlasStats.staleViews, atlasStats.occupancy * 100.f);
+        ImGui::Text("sun shadows:");
+        ImGui::SameLine();
+        ImGui::Checkbox("##sun shadows", &sunShadows);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(100.0f);
+        ImGui::SliderInt("##shadow cascades", &shadowCascades, 1, CascadedShadow::MAX_CASCADES, "%d cascades");
+        ImGui::SameLine();
+        int cascadeSize = 0;
+        while (cascadeSize < 3 && (512 << cascadeSize) < cascadeShadowSize)
+            cascadeSize++;
+        ImGui::SetNextItemWidth(80.0f);
+        if (ImGui::Combo("##cascade size", &cascadeSize, "512\0" "1024\0" "2048\0" "4096\0"))
+            cascadeShadowSize = 512 << cascadeSize;
+        ImGui::Text("shadow distance:");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderFloat("##shadow distance", &shadowDistance, 10.f, 500.f, "%.0f");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderFloat("##cascade split", &cascadeSplitLambda, 0.f, 1.f, "split %.2f");
+        const CascadedShadow::Stats &cascadeStats = m_cascadedShadow->stats();
+        ImGui::Text("cascades: %s, %d passes, %d draw calls, %d triangles (%d updates)", cascadeStats.layered ? "layered" : "per cascade",
+                    cascadeStats.passes, cascadeStats.drawCalls, cascadeStats.triangles, m_cascadedShadow->updates());
+        TextureManager::Stats textureStats = TextureManager::instance().stats();
+        ImGui::Text("texture cache: %d live, %d hits, %d misses", textureStats.live, textureStats.hits, textureStats.misses);
+        ImGui::Text("upload budget:");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderFloat("##upload budget", &uploadBudgetMs, 0.1f, 16.f, "%.1f ms");
         ImGui::Unindent(DEFAULT_INDENT);
     }
 
@@ -735,35 +1388,65 @@ void Engine::renderIngui()
 
 void Engine::renderCookTorrancePBR()
 {
-    gLClearError();
     if (renderCTPBR)
     {
-        Program *ct = m_programs.at("cook-torrance");
-        ct->use();
-
+        // 已上传的网格先画出来, 其余网格在后续帧陆续出现
         Model *ball = m_models.at("pool-ball");
-        if (ball->loadFinished())
+        if (ball->isImported())
         {
             glm::mat4 model = glm::translate(glm::mat4(1.0f), ball->getPosition());
+            DrawView view(Camera::main_camera.view(), m_project, Camera::main_camera.pos(), (float)System::nScreenHeight, lodPixelError);
 
-            // vertex attributes
-            ct->setUniformMatrix4fv("project", m_project);
-            ct->setUniformMatrix4fv("view", Camera::main_camera.view());
-            ct->setUniformMatrix4fv("model", model);
+            if (depthPrepass)
+            {
+                // 深度预渲染: 只写深度, 颜色和模板留给着色阶段
+                Program *depth = m_programs.at("depth");
+                depth->use();
+                depth->setUniformMatrix4fv(Uniforms::model, model);
+                GLState::colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                GLState::stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+                if (frustumCulling)
+                {
+                    ball->drawDepth(depth, view, model);
+                }
+                else
+                {
+                    ball->drawDepth(depth);
+                }
+                GLState::colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                GLState::stencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+                // 着色阶段只有深度相等的片元通过
+                GLState::depthFunc(GL_LEQUAL);
+            }
+
+            Program *ct = m_programs.at("cook-torrance");
+            ct->use();
+
+            // vertex attributes, camera and lights come from the uniform blocks
+            ct->setUniformMatrix4fv(Uniforms::model, model);
 
             // fragment attributes
-            ct->setUniform3f("pointLight.position", m_pointLight->position);
-            ct->setUniform3f("pointLight.color", m_pointLight->color);
-            ct->setUniform1f("pointLight.intensity", m_pointLight->intensity);
-            ct->setUniform3f("viewPos", Camera::main_camera.pos());
-            ct->setUniform3f("albedo", Material::cCT_PBR.albedo);
-            ct->setUniform1f("metallic", Material::cCT_PBR.metallic);
-            ct->setUniform1f("roughness", Material::cCT_PBR.roughness);
-            ct->setUniform1f("ao", Material::cCT_PBR.ao);
-            ball->draw(ct);
+            ct->setUniform3f(Uniforms::albedo, Material::cCT_PBR.albedo);
+            ct->setUniform1f(Uniforms::metallic, Material::cCT_PBR.metallic);
+            ct->setUniform1f(Uniforms::roughness, Material::cCT_PBR.roughness);
+            ct->setUniform1f(Uniforms::ao, Material::cCT_PBR.ao);
+
+            bindShadowMaps(ct);
+            if (clusteredLighting)
+                m_lightClusters->bind(ct, LIGHTCLUSTERUNIT);
+            else
+                ct->setUniform1i(Uniforms::clusteredLights, 0);
+            if (frustumCulling)
+            {
+                ball->draw(ct, view, model);
+            }
+            else
+            {
+                ball->draw(ct);
+            }
+            GLState::depthFunc(GL_LESS);
         }
     }
-    assert(gLCheckError());
 }
 
 #pragma endregion
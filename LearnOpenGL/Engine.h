@@ -16,11 +16,26 @@
 #include "Model.h"
 #include "Program.h"
 #include "Light.hpp"
+#include "Benchmark.h"
+#include "CascadedShadow.h"
+#include "LightClusters.h"
+#include "ModelLoader.h"
+#include "PointShadow.h"
+#include "SceneBVH.h"
+#include "ShadowAtlas.h"
+#include "UniformBuffer.h"
+#include <chrono>
 
 class Engine
 {
 public:
     void start();
+
+    //  KHR_debug ,  start ֮ǰ
+    void setDebugOutput(bool enable) { m_glDebug = enable; }
+
+    // ޴Ⱦ N ֡֡ʱͳ, ؽ˳
+    int startHeadless(const BenchmarkOptions& options);
     
 private:
     Engine();
@@ -28,6 +43,7 @@ private:
     
     void init();
     bool createWindow();
+    void initRenderState();
     void createSceneThings();
     void createVAOs();
     void createTextures();
@@ -37,12 +53,34 @@ private:
     // Ⱦѭ
     void renderLoop();
 
+    // ޴Ⱦѭ
+    int renderHeadless(const BenchmarkOptions& options);
+
+    //  --bench ָ΢׼
+    int runMicroBenchmark(const BenchmarkOptions& options);
+
     // ʼͼ
     void createDepthBuffer();
 
-    // Ⱦͼ
+    //  extraLights õĵԴ
+    void updateLights();
+
+    // Ӱͼ󶨵 cook-torrance Ĳ, Ҫʹ
+    void bindShadowMaps(Program* ct);
+
+    // ԴԵӰͼ (ShadowMaps) ӰͼԴе
+    void pointShadowMap(PointLight* light, int& shadowMap, int& shadowIndex) const;
+    void spotShadowMap(FlashLight* light, int& shadowMap, int& shadowIndex) const;
+
+    // ȾԴӰͼ
     void renderDepthBuffer();
 
+    // ÿ֡һ͹Դ uniform 
+    void updateFrameUniforms();
+
+    // ³Χ, ׶޳, ʰȡ͵ԴΧѯ
+    void updateScene();
+
     // Ⱦ
     void renderScreen();
 
@@ -57,19 +95,65 @@ public:
     
 private:
     GLFWwindow* m_pWindow;
+
+    // ȾĿ, ģʽΪĬ֡ 0
+    GLuint m_screenFBO;
+
+    // Ƿ񴴽Ĳ gl Ϣ
+    bool m_glDebug;
     
     std::map<std::string, Program*> m_programs;
     std::map<std::string, Model*> m_models;
+
+    // ̨ģ
+    ModelLoader* m_modelLoader;
     std::map<std::string, GLuint> m_VAOs;
     std::map<std::string, GLuint> m_textures;
     
     std::vector<PointLight*> m_pointLights;
     std::vector<FlashLight*> m_flashLights;
+    std::vector<DirectionalLight*> m_directionalLights;
     
     PointLight* m_pointLight;
     FlashLight* m_flashLight;
+    // ̫, ΨһͶ伶Ӱķ
+    DirectionalLight* m_sunLight;
     
     glm::mat4 m_project;
+
+    // ÿ֡͵Դб, 󶨵г
+    UniformBuffer m_frameUniforms;
+    UniformBuffer m_lightUniforms;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // ΧеĶ: һģ͵һ
+    struct SceneObject
+    {
+        std::string model;
+        size_t mesh;
+    };
+
+    // ģΧ, ż m_sceneObjects ±
+    SceneBVH m_sceneBVH;
+    std::vector<SceneObject> m_sceneObjects;
+
+    // m_pointLight Ӱͼ
+    PointShadow* m_pointShadow;
+
+    // пĹԴõӰͼ
+    ShadowAtlas* m_shadowAtlas;
+
+    // m_sunLight ļӰ
+    CascadedShadow* m_cascadedShadow;
+
+    // Դ;۹ư׶еĴط
+    LightClusters* m_lightClusters;
+
+    // ֡Ĳѯ
+    int m_sceneVisible;
+    int m_pointLightReach;
+    RayHit m_picked;
+    bool m_hasPicked;
 };
 
 #endif /* Engine_h */
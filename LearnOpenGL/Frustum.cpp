@@ -0,0 +1,237 @@
+//
+//  Frustum.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "Frustum.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+AABB AABB::empty()
+{
+    AABB box;
+    box.min = glm::vec3(FLT_MAX);
+    box.max = glm::vec3(-FLT_MAX);
+    return box;
+}
+
+AABB AABB::fromPoints(const glm::vec3* points, size_t count, size_t stride)
+{
+    AABB box = empty();
+    const char* point = (const char*)points;
+    for (size_t i = 0; i < count; ++i, point += stride)
+    {
+        const glm::vec3& p = *(const glm::vec3*)point;
+        box.min = glm::min(box.min, p);
+        box.max = glm::max(box.max, p);
+    }
+    return box;
+}
+
+AABB AABB::transformed(const glm::mat4& transform) const
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4(this->center(), 1.f));
+    glm::vec3 extent = this->extent();
+    glm::vec3 worldExtent;
+    for (int row = 0; row < 3; ++row)
+    {
+        worldExtent[row] = std::abs(transform[0][row]) * extent.x + std::abs(transform[1][row]) * extent.y + std::abs(transform[2][row]) * extent.z;
+    }
+    AABB box;
+    box.min = center - worldExtent;
+    box.max = center + worldExtent;
+    return box;
+}
+
+float AABB::rayDistance(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) const
+{
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.f));
+    float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+bool AABB::intersects(const BoundingSphere& sphere) const
+{
+    glm::vec3 offset = sphere.center - glm::clamp(sphere.center, min, max);
+    return glm::dot(offset, offset) <= sphere.radius * sphere.radius;
+}
+
+BoundingSphere BoundingSphere::fromBox(const AABB& box, const glm::vec3* points, size_t count, size_t stride)
+{
+    BoundingSphere sphere;
+    sphere.center = box.center();
+    float radius2 = 0.f;
+    const char* point = (const char*)points;
+    for (size_t i = 0; i < count; ++i, point += stride)
+    {
+        glm::vec3 offset = *(const glm::vec3*)point - sphere.center;
+        radius2 = std::max(radius2, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radius2);
+    return sphere;
+}
+
+void AABBList::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    m_count = 0;
+}
+
+void AABBList::push_back(const AABB& box)
+{
+    if (m_count == centerX.size())
+    {
+        size_t padded = m_count + 4;
+        centerX.resize(padded);
+        centerY.resize(padded);
+        centerZ.resize(padded);
+        extentX.resize(padded);
+        extentY.resize(padded);
+        extentZ.resize(padded);
+    }
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    centerX[m_count] = center.x;
+    centerY[m_count] = center.y;
+    centerZ[m_count] = center.z;
+    extentX[m_count] = extent.x;
+    extentY[m_count] = extent.y;
+    extentZ[m_count] = extent.z;
+    m_count++;
+}
+
+Frustum::Frustum(const glm::mat4& viewProject)
+{
+    // rows of the matrix, glm stores columns
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        rows[i] = glm::vec4(viewProject[0][i], viewProject[1][i], viewProject[2][i], viewProject[3][i]);
+    }
+    m_planes[0] = rows[3] + rows[0]; // left
+    m_planes[1] = rows[3] - rows[0]; // right
+    m_planes[2] = rows[3] + rows[1]; // bottom
+    m_planes[3] = rows[3] - rows[1]; // top
+    m_planes[4] = rows[3] + rows[2]; // near
+    m_planes[5] = rows[3] - rows[2]; // far
+    for (glm::vec4& plane : m_planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const
+{
+    for (const glm::vec4& plane : m_planes)
+    {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const AABB& box) const
+{
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    for (const glm::vec4& plane : m_planes)
+    {
+        glm::vec3 normal(plane);
+        // distance of the corner furthest along the normal
+        if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + plane.w < 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Frustum::Containment Frustum::classify(const AABB& box) const
+{
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    Containment result = INSIDE;
+    for (const glm::vec4& plane : m_planes)
+    {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance + radius < 0.f)
+        {
+            return OUTSIDE;
+        }
+        if (distance - radius < 0.f)
+        {
+            result = INTERSECTS;
+        }
+    }
+    return result;
+}
+
+size_t Frustum::intersects(const AABBList& boxes, uint8_t* visible) const
+{
+    size_t count = boxes.size();
+    size_t inside = 0;
+#if FRUSTUM_SSE
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+        // a lane turns on when its box is fully behind any plane
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4& plane : m_planes)
+        {
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                       _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < 4 && i + lane < count; ++lane)
+        {
+            visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+            inside += visible[i + lane];
+        }
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        AABB box;
+        glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+        glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+        box.min = center - extent;
+        box.max = center + extent;
+        visible[i] = intersects(box) ? 1 : 0;
+        inside += visible[i];
+    }
+#endif
+    return inside;
+}
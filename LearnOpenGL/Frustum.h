@@ -0,0 +1,107 @@
+//
+//  Frustum.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef Frustum_h
+#define Frustum_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct BoundingSphere;
+
+/// axis aligned bounding box
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+    float surfaceArea() const
+    {
+        glm::vec3 size = glm::max(max - min, glm::vec3(0.f));
+        return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    void expand(const AABB& box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    /// inverted box, expand() by anything gives that thing
+    static AABB empty();
+
+    /// distance along origin + t * direction to the box for 0 <= t <= maxDistance, FLT_MAX when missed.
+    /// takes 1 / direction so a ray tested against many boxes divides once
+    float rayDistance(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) const;
+
+    bool intersects(const BoundingSphere& sphere) const;
+
+    /// box of the points, an inverted empty box when count is 0
+    static AABB fromPoints(const glm::vec3* points, size_t count, size_t stride);
+
+    /// box around this box moved by transform (Arvo), tight for translation and scale
+    AABB transformed(const glm::mat4& transform) const;
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+
+    /// sphere around the box, centred on it
+    static BoundingSphere fromBox(const AABB& box, const glm::vec3* points, size_t count, size_t stride);
+};
+
+/// boxes stored as centre and half extent per axis, the layout the batch test reads four at a time.
+/// the arrays grow four boxes at a time so a step never reads past them. the lanes past size() hold empty boxes at
+/// the origin, the batch test reads them but writes no result for them
+struct AABBList
+{
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    void clear();
+    void push_back(const AABB& box);
+    size_t size() const { return m_count; }
+
+private:
+    size_t m_count = 0;
+};
+
+/// the six planes of a view projection, normals point inside
+class Frustum
+{
+public:
+    enum Containment
+    {
+        OUTSIDE = 0,
+        INTERSECTS,
+        INSIDE,
+    };
+
+    /// planes of viewProject (Gribb/Hartmann), normalized so the sphere test gets distances
+    explicit Frustum(const glm::mat4& viewProject);
+
+    bool intersects(const BoundingSphere& sphere) const;
+    bool intersects(const AABB& box) const;
+
+    /// like intersects() but tells a box fully inside apart, so a hierarchy can accept whole subtrees
+    Containment classify(const AABB& box) const;
+
+    /// visible[i] = 1 when box i is at least partly inside, 0 otherwise. four boxes per step with sse,
+    /// a plain loop elsewhere (arm64 macs). returns the number of visible boxes
+    size_t intersects(const AABBList& boxes, uint8_t* visible) const;
+
+private:
+    glm::vec4 m_planes[6];
+};
+
+#endif /* Frustum_h */
@@ -0,0 +1,150 @@
+//
+//  GLExt.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "GLExt.h"
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+
+namespace GLExt
+{
+    PFNGLDEBUGMESSAGECALLBACKPROC glDebugMessageCallback = nullptr;
+    PFNGLDEBUGMESSAGECONTROLPROC glDebugMessageControl = nullptr;
+    PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC glProgramBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect = nullptr;
+}
+
+namespace
+{
+    int g_major = 0;
+    int g_minor = 0;
+    int g_programBinaryFormats = 0;
+    std::set<std::string> g_extensions;
+
+    const char* sourceName(GLenum source)
+    {
+        switch (source)
+        {
+        case GL_DEBUG_SOURCE_API: return "api";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        default: return "other";
+        }
+    }
+
+    const char* typeName(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_DEBUG_TYPE_ERROR: return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+        case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+        default: return "other";
+        }
+    }
+
+    const char* severityName(GLenum severity)
+    {
+        switch (severity)
+        {
+        case GL_DEBUG_SEVERITY_HIGH: return "high";
+        case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+        case GL_DEBUG_SEVERITY_LOW: return "low";
+        default: return "notification";
+        }
+    }
+
+    void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei, const GLchar* message, const void*)
+    {
+        std::cerr << "[OpenGL " << typeName(type) << ", " << severityName(severity) << ", " << sourceName(source)
+                  << " #" << id << "] " << message << std::endl;
+    }
+}
+
+void GLExt::load(GLADloadproc loader)
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &g_major);
+    glGetIntegerv(GL_MINOR_VERSION, &g_minor);
+
+    g_extensions.clear();
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        g_extensions.insert((const char*)glGetStringi(GL_EXTENSIONS, i));
+    }
+
+    // KHR_debug entry points have no suffix on desktop gl
+    if (hasVersion(4, 3) || hasExtension("GL_KHR_debug"))
+    {
+        glDebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)loader("glDebugMessageCallback");
+        glDebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)loader("glDebugMessageControl");
+    }
+
+    g_programBinaryFormats = 0;
+    if (hasVersion(4, 1) || hasExtension("GL_ARB_get_program_binary"))
+    {
+        glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+        glProgramBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+        glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &g_programBinaryFormats);
+    }
+
+    glMultiDrawElementsIndirect = nullptr;
+    if (hasVersion(4, 3) || hasExtension("GL_ARB_multi_draw_indirect"))
+    {
+        glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+    }
+}
+
+bool GLExt::hasVersion(int major, int minor)
+{
+    return g_major > major || (g_major == major && g_minor >= minor);
+}
+
+bool GLExt::hasExtension(const char* name)
+{
+    return g_extensions.count(name) > 0;
+}
+
+bool GLExt::hasProgramBinary()
+{
+    return glGetProgramBinary != nullptr && glProgramBinary != nullptr && glProgramParameteri != nullptr && g_programBinaryFormats > 0;
+}
+
+bool GLExt::hasMultiDrawIndirect()
+{
+    return glMultiDrawElementsIndirect != nullptr;
+}
+
+bool GLExt::hasVertexShaderLayer()
+{
+    return hasExtension("GL_ARB_shader_viewport_layer_array") || hasExtension("GL_AMD_vertex_shader_layer");
+}
+
+bool GLExt::enableDebugOutput()
+{
+    if (glDebugMessageCallback == nullptr || glDebugMessageControl == nullptr)
+    {
+        std::cerr << "KHR_debug is not supported, debug output disabled" << std::endl;
+        return false;
+    }
+
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(debugCallback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+    return true;
+}
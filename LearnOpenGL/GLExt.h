@@ -0,0 +1,87 @@
+//
+//  GLExt.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef GLExt_h
+#define GLExt_h
+
+#include <glad/glad.h>
+
+// KHR_debug (core in 4.3)
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// ARB_draw_indirect (core in 4.0)
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+typedef void (APIENTRYP PFNGLDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void* userParam);
+typedef void (APIENTRYP PFNGLDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint* ids, GLboolean enabled);
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+/// entry points and capabilities beyond the GL 3.3 core covered by glad. the engine targets 4.1 (macOS)
+/// and uses newer features only when the driver reports them, so everything here is optional
+namespace GLExt
+{
+    /// query the version and extensions and load the optional entry points, call after gladLoadGLLoader
+    void load(GLADloadproc loader);
+
+    bool hasVersion(int major, int minor);
+    bool hasExtension(const char* name);
+
+    /// KHR_debug: report errors and warnings through a callback instead of polling glGetError.
+    /// messages are synchronous so a breakpoint in the callback stops at the failing call,
+    /// full output needs a debug context. returns false when KHR_debug is missing (e.g. macOS)
+    bool enableDebugOutput();
+
+    /// ARB_get_program_binary with at least one binary format
+    bool hasProgramBinary();
+
+    /// ARB_multi_draw_indirect (core in 4.3), not available on macOS
+    bool hasMultiDrawIndirect();
+
+    /// ARB_shader_viewport_layer_array or AMD_vertex_shader_layer: the vertex shader may write gl_Layer,
+    /// so instancing can spread a draw over the layers of a layered framebuffer. not available on macOS
+    bool hasVertexShaderLayer();
+
+    extern PFNGLDEBUGMESSAGECALLBACKPROC glDebugMessageCallback;
+    extern PFNGLDEBUGMESSAGECONTROLPROC glDebugMessageControl;
+    extern PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+    extern PFNGLPROGRAMBINARYPROC glProgramBinary;
+    extern PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+    extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect;
+}
+
+#endif /* GLExt_h */
@@ -0,0 +1,379 @@
+//
+//  GLState.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "GLState.h"
+#include "GLExt.h"
+
+namespace
+{
+    const GLuint UNKNOWN = ~0u;
+    const GLenum UNKNOWN_ENUM = 0;
+
+    // units beyond this are passed through uncached
+    const GLuint MAX_UNITS = 32;
+
+    const GLenum BUFFER_TARGETS[] = {GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_PACK_BUFFER,
+                                     GL_TEXTURE_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DRAW_INDIRECT_BUFFER};
+    const GLenum TEXTURE_TARGETS[] = {GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_MULTISAMPLE};
+    const GLenum CAPS[] = {GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_STENCIL_TEST, GL_MULTISAMPLE, GL_SCISSOR_TEST,
+                           GL_POLYGON_OFFSET_FILL, GL_TEXTURE_CUBE_MAP_SEAMLESS, GL_FRAMEBUFFER_SRGB};
+
+    const int BUFFER_TARGET_COUNT = sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0]);
+    const int TEXTURE_TARGET_COUNT = sizeof(TEXTURE_TARGETS) / sizeof(TEXTURE_TARGETS[0]);
+    const int CAP_COUNT = sizeof(CAPS) / sizeof(CAPS[0]);
+
+    struct State
+    {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint buffers[BUFFER_TARGET_COUNT];
+        GLuint activeUnit;
+        GLuint textures[MAX_UNITS][TEXTURE_TARGET_COUNT];
+        // -1 unknown, 0 disabled, 1 enabled
+        signed char caps[CAP_COUNT];
+        GLenum depthFunc;
+        GLuint depthMask;
+        /// one bit per channel, rgba from the lowest
+        GLuint colorMask;
+        GLenum stencilFunc;
+        GLint stencilRef;
+        GLuint stencilMask;
+        GLenum stencilFail;
+        GLenum stencilDepthFail;
+        GLenum stencilDepthPass;
+        GLenum blendSource;
+        GLenum blendDestination;
+        GLenum cullFace;
+    };
+
+    State makeUnknown()
+    {
+        State state;
+        state.program = UNKNOWN;
+        state.vertexArray = UNKNOWN;
+        for (GLuint& buffer : state.buffers)
+        {
+            buffer = UNKNOWN;
+        }
+        state.activeUnit = UNKNOWN;
+        for (auto& unit : state.textures)
+        {
+            for (GLuint& texture : unit)
+            {
+                texture = UNKNOWN;
+            }
+        }
+        for (signed char& cap : state.caps)
+        {
+            cap = -1;
+        }
+        state.depthFunc = UNKNOWN_ENUM;
+        state.depthMask = UNKNOWN;
+        state.colorMask = UNKNOWN;
+        state.stencilFunc = UNKNOWN_ENUM;
+        state.stencilRef = 0;
+        state.stencilMask = 0;
+        state.stencilFail = UNKNOWN_ENUM;
+        state.stencilDepthFail = UNKNOWN_ENUM;
+        state.stencilDepthPass = UNKNOWN_ENUM;
+        state.blendSource = UNKNOWN_ENUM;
+        state.blendDestination = UNKNOWN_ENUM;
+        state.cullFace = UNKNOWN_ENUM;
+        return state;
+    }
+
+    State s_state = makeUnknown();
+    GLStateStats s_frameStats;
+    GLStateStats s_lastFrameStats;
+
+    template <typename T>
+    int indexOf(const T* table, int count, GLenum value)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (table[i] == value)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /// true when the call has to go to gl, counts either way
+    bool issue(bool changed)
+    {
+        if (changed)
+        {
+            s_frameStats.issued++;
+        }
+        else
+        {
+            s_frameStats.elided++;
+        }
+        return changed;
+    }
+}
+
+void GLState::useProgram(GLuint program)
+{
+    if (issue(s_state.program != program))
+    {
+        glUseProgram(program);
+        s_state.program = program;
+    }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray)
+{
+    if (issue(s_state.vertexArray != vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        s_state.vertexArray = vertexArray;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    int index = indexOf(BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+    if (index < 0)
+    {
+        issue(true);
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (issue(s_state.buffers[index] != buffer))
+    {
+        glBindBuffer(target, buffer);
+        s_state.buffers[index] = buffer;
+    }
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    // indexed bindings are not cached, but the call also replaces the generic binding
+    issue(true);
+    glBindBufferBase(target, index, buffer);
+    int targetIndex = indexOf(BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+    if (targetIndex >= 0)
+    {
+        s_state.buffers[targetIndex] = buffer;
+    }
+}
+
+void GLState::activeTexture(GLuint unit)
+{
+    if (issue(s_state.activeUnit != unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        s_state.activeUnit = unit;
+    }
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+    int index = indexOf(TEXTURE_TARGETS, TEXTURE_TARGET_COUNT, target);
+    if (index < 0 || s_state.activeUnit >= MAX_UNITS)
+    {
+        issue(true);
+        glBindTexture(target, texture);
+        return;
+    }
+    GLuint& bound = s_state.textures[s_state.activeUnit][index];
+    if (issue(bound != texture))
+    {
+        glBindTexture(target, texture);
+        bound = texture;
+    }
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int index = indexOf(TEXTURE_TARGETS, TEXTURE_TARGET_COUNT, target);
+    if (index >= 0 && unit < MAX_UNITS && s_state.textures[unit][index] == texture)
+    {
+        issue(false);
+        return;
+    }
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void GLState::enable(GLenum cap)
+{
+    setEnabled(cap, true);
+}
+
+void GLState::disable(GLenum cap)
+{
+    setEnabled(cap, false);
+}
+
+void GLState::setEnabled(GLenum cap, bool enabled)
+{
+    int index = indexOf(CAPS, CAP_COUNT, cap);
+    if (index >= 0 && !issue(s_state.caps[index] != (enabled ? 1 : 0)))
+    {
+        return;
+    }
+    if (index < 0)
+    {
+        issue(true);
+    }
+    else
+    {
+        s_state.caps[index] = enabled ? 1 : 0;
+    }
+    if (enabled)
+    {
+        glEnable(cap);
+    }
+    else
+    {
+        glDisable(cap);
+    }
+}
+
+void GLState::depthFunc(GLenum func)
+{
+    if (issue(s_state.depthFunc != func))
+    {
+        glDepthFunc(func);
+        s_state.depthFunc = func;
+    }
+}
+
+void GLState::depthMask(GLboolean flag)
+{
+    if (issue(s_state.depthMask != flag))
+    {
+        glDepthMask(flag);
+        s_state.depthMask = flag;
+    }
+}
+
+void GLState::colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+    GLuint mask = (red ? 1u : 0u) | (green ? 2u : 0u) | (blue ? 4u : 0u) | (alpha ? 8u : 0u);
+    if (issue(s_state.colorMask != mask))
+    {
+        glColorMask(red, green, blue, alpha);
+        s_state.colorMask = mask;
+    }
+}
+
+void GLState::stencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+    if (issue(s_state.stencilFunc != func || s_state.stencilRef != ref || s_state.stencilMask != mask))
+    {
+        glStencilFunc(func, ref, mask);
+        s_state.stencilFunc = func;
+        s_state.stencilRef = ref;
+        s_state.stencilMask = mask;
+    }
+}
+
+void GLState::stencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+{
+    if (issue(s_state.stencilFail != stencilFail || s_state.stencilDepthFail != depthFail || s_state.stencilDepthPass != depthPass))
+    {
+        glStencilOp(stencilFail, depthFail, depthPass);
+        s_state.stencilFail = stencilFail;
+        s_state.stencilDepthFail = depthFail;
+        s_state.stencilDepthPass = depthPass;
+    }
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+    if (issue(s_state.blendSource != source || s_state.blendDestination != destination))
+    {
+        glBlendFunc(source, destination);
+        s_state.blendSource = source;
+        s_state.blendDestination = destination;
+    }
+}
+
+void GLState::cullFace(GLenum mode)
+{
+    if (issue(s_state.cullFace != mode))
+    {
+        glCullFace(mode);
+        s_state.cullFace = mode;
+    }
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+    if (s_state.program == program)
+    {
+        // the name may be handed out again, the next useProgram has to reach gl
+        s_state.program = UNKNOWN;
+    }
+    glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        // deleting the bound object reverts the binding to 0
+        if (s_state.vertexArray == vertexArrays[i])
+        {
+            s_state.vertexArray = 0;
+        }
+    }
+    glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLState::deleteBuffers(GLsizei count, const GLuint* buffers)
+{
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        for (GLuint& buffer : s_state.buffers)
+        {
+            if (buffer == buffers[i])
+            {
+                buffer = 0;
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void GLState::deleteTextures(GLsizei count, const GLuint* textures)
+{
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        for (auto& unit : s_state.textures)
+        {
+            for (GLuint& texture : unit)
+            {
+                if (texture == textures[i])
+                {
+                    texture = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void GLState::invalidate()
+{
+    s_state = makeUnknown();
+}
+
+void GLState::endFrame()
+{
+    s_lastFrameStats = s_frameStats;
+    s_frameStats = GLStateStats();
+}
+
+const GLStateStats& GLState::frameStats()
+{
+    return s_lastFrameStats;
+}
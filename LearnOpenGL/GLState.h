@@ -0,0 +1,69 @@
+//
+//  GLState.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef GLState_h
+#define GLState_h
+
+#include <cstdint>
+#include <glad/glad.h>
+
+/// gl calls issued versus dropped because the state was already set
+struct GLStateStats
+{
+    uint64_t issued = 0;
+    uint64_t elided = 0;
+};
+
+/// shadow copy of the gl state the renderer touches. every setter compares against the last
+/// value it set and only calls gl when it differs. the state starts out unknown, so the first
+/// call after context creation or invalidate() always reaches gl. the tracked state must not be
+/// changed with raw gl calls, code that does so (and does not restore it) has to invalidate()
+namespace GLState
+{
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+
+    /// GL_ELEMENT_ARRAY_BUFFER is part of the vertex array state and is passed through uncached
+    void bindBuffer(GLenum target, GLuint buffer);
+    /// indexed binding, always issued, keeps the generic binding it replaces in sync
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    /// unit is an index, not GL_TEXTURE0 + index
+    void activeTexture(GLuint unit);
+    /// bind to the active unit
+    void bindTexture(GLenum target, GLuint texture);
+    /// bind to a unit, does not even switch the active unit when the texture is bound already
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void setEnabled(GLenum cap, bool enabled);
+
+    void depthFunc(GLenum func);
+    void depthMask(GLboolean flag);
+    void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+    void stencilFunc(GLenum func, GLint ref, GLuint mask);
+    void stencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+    void blendFunc(GLenum source, GLenum destination);
+    void cullFace(GLenum mode);
+
+    /// delete objects and forget their bindings, gl may hand the names out again
+    void deleteProgram(GLuint program);
+    void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+    void deleteBuffers(GLsizei count, const GLuint* buffers);
+    void deleteTextures(GLsizei count, const GLuint* textures);
+
+    /// forget everything, for a new context or after foreign code changed the state
+    void invalidate();
+
+    /// close the counters of the current frame
+    void endFrame();
+    /// counters of the last finished frame
+    const GLStateStats& frameStats();
+}
+
+#endif /* GLState_h */
@@ -0,0 +1,294 @@
+//
+//  GeometryArena.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "GeometryArena.h"
+#include "GLExt.h"
+#include "GLState.h"
+#include "Mesh.h"
+
+namespace
+{
+    // enough for a few typical models before the first grow
+    const size_t INITIAL_VERTICES = 64 * 1024;
+    const size_t INITIAL_INDICES = 192 * 1024;
+
+    /// new buffer of size bytes holding the first used bytes of the old one, the old one is deleted
+    GLuint resizeBuffer(GLuint buffer, GLsizeiptr used, GLsizeiptr size)
+    {
+        GLuint resized;
+        glGenBuffers(1, &resized);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, resized);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        if (buffer != 0)
+        {
+            if (used > 0)
+            {
+                GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            }
+            GLState::deleteBuffers(1, &buffer);
+        }
+        return resized;
+    }
+}
+
+GeometryArena::GeometryArena()
+{
+    for (int format = 0; format < VERTEX_FORMAT_COUNT; ++format)
+    {
+        m_vertexBuffers[format] = Buffer{0, 0, 0};
+        m_positionBuffers[format] = Buffer{0, 0, 0};
+        for (int type = 0; type < 2; ++type)
+        {
+            m_vertexArrays[format][type] = 0;
+            m_positionArrays[format][type] = 0;
+        }
+    }
+    for (Buffer& indices : m_indexBuffers)
+    {
+        indices = Buffer{0, 0, 0};
+    }
+}
+
+GeometryArena::~GeometryArena()
+{
+    for (int format = 0; format < VERTEX_FORMAT_COUNT; ++format)
+    {
+        for (int type = 0; type < 2; ++type)
+        {
+            if (m_vertexArrays[format][type] != 0)
+            {
+                GLState::deleteVertexArrays(1, &m_vertexArrays[format][type]);
+            }
+            if (m_positionArrays[format][type] != 0)
+            {
+                GLState::deleteVertexArrays(1, &m_positionArrays[format][type]);
+            }
+        }
+        if (m_vertexBuffers[format].buffer != 0)
+        {
+            GLState::deleteBuffers(1, &m_vertexBuffers[format].buffer);
+        }
+        if (m_positionBuffers[format].buffer != 0)
+        {
+            GLState::deleteBuffers(1, &m_positionBuffers[format].buffer);
+        }
+    }
+    for (Buffer& indices : m_indexBuffers)
+    {
+        if (indices.buffer != 0)
+        {
+            GLState::deleteBuffers(1, &indices.buffer);
+        }
+    }
+}
+
+ArenaRange GeometryArena::allocate(VertexFormat vertexFormat, const void* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                                   bool positionStream)
+{
+    GLenum type = indexType(vertexCount);
+    Buffer& vertexBuffer = m_vertexBuffers[vertexFormat];
+    Buffer& positionBuffer = m_positionBuffers[vertexFormat];
+    Buffer& indexBuffer = m_indexBuffers[slot(type)];
+    size_t vertexBytes = Mesh::vertexSize(vertexFormat);
+    size_t positionBytes = Mesh::positionSize(vertexFormat);
+    size_t indexBytes = indexSize(type);
+
+    GLuint vertexBufferBefore = vertexBuffer.buffer;
+    GLuint positionBufferBefore = positionBuffer.buffer;
+    GLuint indexBufferBefore = indexBuffer.buffer;
+    reserve(vertexBuffer, vertexCount, vertexBytes, INITIAL_VERTICES);
+    if (positionStream)
+    {
+        reserve(positionBuffer, vertexCount, positionBytes, INITIAL_VERTICES);
+    }
+    reserve(indexBuffer, indexCount, indexBytes, INITIAL_INDICES);
+
+    // every vertex array reading a replaced buffer is repointed, not only the one this mesh uses
+    if (vertexBuffer.buffer != vertexBufferBefore || positionBuffer.buffer != positionBufferBefore)
+    {
+        setupVertexArrays(vertexFormat, GL_UNSIGNED_SHORT);
+        setupVertexArrays(vertexFormat, GL_UNSIGNED_INT);
+    }
+    if (indexBuffer.buffer != indexBufferBefore)
+    {
+        for (int format = 0; format < VERTEX_FORMAT_COUNT; ++format)
+        {
+            setupVertexArrays((VertexFormat)format, type);
+        }
+    }
+    if (m_vertexArrays[vertexFormat][slot(type)] == 0 || (positionStream && m_positionArrays[vertexFormat][slot(type)] == 0))
+    {
+        setupVertexArrays(vertexFormat, type);
+    }
+
+    ArenaRange range;
+    range.vertexFormat = vertexFormat;
+    range.baseVertex = (GLint)vertexBuffer.count;
+    range.positionBaseVertex = positionStream ? (GLint)positionBuffer.count : -1;
+    range.firstIndex = (GLuint)indexBuffer.count;
+    range.indexCount = (GLsizei)indexCount;
+    range.indexType = type;
+
+    // the copy targets leave the element binding of whatever vertex array is bound alone
+    std::vector<GLushort> scratch;
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexBuffer.count * vertexBytes, vertexCount * vertexBytes, vertices);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexBuffer.count * indexBytes, indexCount * indexBytes, packIndices(indices, indexCount, type, scratch));
+    if (positionStream)
+    {
+        std::vector<uint8_t> positions;
+        Mesh::gatherPositions(vertexFormat, vertices, vertexCount, positions);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, positionBuffer.count * positionBytes, positions.size(), positions.data());
+        positionBuffer.count += vertexCount;
+    }
+
+    vertexBuffer.count += vertexCount;
+    indexBuffer.count += indexCount;
+    return range;
+}
+
+const void* GeometryArena::packIndices(const unsigned int* indices, size_t indexCount, GLenum indexType, std::vector<GLushort>& scratch)
+{
+    if (indexType == GL_UNSIGNED_INT)
+    {
+        return indices;
+    }
+    scratch.assign(indices, indices + indexCount);
+    return scratch.data();
+}
+
+void GeometryArena::reserve(Buffer& buffer, size_t count, size_t elementSize, size_t initialCapacity)
+{
+    if (buffer.buffer != 0 && buffer.count + count <= buffer.capacity)
+    {
+        return;
+    }
+    // double so streaming in many meshes copies each byte only a few times
+    size_t capacity = buffer.capacity > 0 ? buffer.capacity : initialCapacity;
+    while (buffer.count + count > capacity)
+    {
+        capacity *= 2;
+    }
+    buffer.buffer = resizeBuffer(buffer.buffer, buffer.count * elementSize, capacity * elementSize);
+    buffer.capacity = capacity;
+}
+
+void GeometryArena::setupVertexArrays(VertexFormat vertexFormat, GLenum indexType)
+{
+    const Buffer& indices = m_indexBuffers[slot(indexType)];
+    if (indices.buffer == 0)
+    {
+        return;
+    }
+
+    const Buffer& vertices = m_vertexBuffers[vertexFormat];
+    if (vertices.buffer != 0)
+    {
+        GLuint& vertexArray = m_vertexArrays[vertexFormat][slot(indexType)];
+        if (vertexArray == 0)
+        {
+            glGenVertexArrays(1, &vertexArray);
+        }
+        GLState::bindVertexArray(vertexArray);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, vertices.buffer);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+        Mesh::setupVertexAttributes(vertexFormat);
+    }
+
+    const Buffer& positions = m_positionBuffers[vertexFormat];
+    if (positions.buffer != 0)
+    {
+        GLuint& positionArray = m_positionArrays[vertexFormat][slot(indexType)];
+        if (positionArray == 0)
+        {
+            glGenVertexArrays(1, &positionArray);
+        }
+        GLState::bindVertexArray(positionArray);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, positions.buffer);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+        Mesh::setupPositionAttributes(vertexFormat);
+    }
+    GLState::bindVertexArray(0);
+}
+
+MultiDraw::MultiDraw()
+    : m_indirectBuffer(0), m_preferIndirect(false)
+{
+}
+
+MultiDraw::~MultiDraw()
+{
+    if (m_indirectBuffer != 0)
+    {
+        GLState::deleteBuffers(1, &m_indirectBuffer);
+    }
+}
+
+void MultiDraw::clear()
+{
+    m_commands.clear();
+    m_counts.clear();
+    m_offsets.clear();
+    m_baseVertices.clear();
+    m_indexTypes.clear();
+}
+
+void MultiDraw::add(const ArenaRange& range)
+{
+    DrawElementsIndirectCommand command;
+    command.count = (GLuint)range.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = range.firstIndex;
+    command.baseVertex = range.baseVertex;
+    command.baseInstance = 0;
+    m_commands.push_back(command);
+
+    m_counts.push_back(range.indexCount);
+    m_offsets.push_back((const void*)(range.firstIndex * GeometryArena::indexSize(range.indexType)));
+    m_baseVertices.push_back(range.baseVertex);
+    m_indexTypes.push_back(range.indexType);
+}
+
+bool MultiDraw::indirect() const
+{
+    return m_preferIndirect && GLExt::hasMultiDrawIndirect();
+}
+
+void MultiDraw::finish()
+{
+    if (!indirect() || m_commands.empty())
+    {
+        return;
+    }
+    if (m_indirectBuffer == 0)
+    {
+        glGenBuffers(1, &m_indirectBuffer);
+    }
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand), m_commands.data(), GL_STATIC_DRAW);
+}
+
+void MultiDraw::draw(size_t first, size_t count) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (indirect())
+    {
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+        GLExt::glMultiDrawElementsIndirect(GL_TRIANGLES, m_indexTypes[first], (const void*)(first * sizeof(DrawElementsIndirectCommand)), (GLsizei)count, 0);
+    }
+    else
+    {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_counts.data() + first, m_indexTypes[first], m_offsets.data() + first, (GLsizei)count,
+                                      m_baseVertices.data() + first);
+    }
+}
@@ -0,0 +1,153 @@
+//
+//  GeometryArena.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef GeometryArena_h
+#define GeometryArena_h
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+/// layout of the vertices of a mesh on the gpu, Vertex or PackedVertex (Mesh.h)
+enum VertexFormat
+{
+    VERTEX_FLOAT = 0,
+    VERTEX_PACKED,
+    VERTEX_FORMAT_COUNT,
+};
+
+/// place of a mesh inside the arena buffers
+struct ArenaRange
+{
+    VertexFormat vertexFormat;
+    /// in vertices of vertexFormat
+    GLint baseVertex;
+    /// start of the positions in the position stream of vertexFormat, -1 without one
+    GLint positionBaseVertex;
+    /// in units of indexType
+    GLuint firstIndex;
+    GLsizei indexCount;
+    GLenum indexType;
+};
+
+/// a vertex buffer per vertex format and an index buffer per index type shared by many meshes, so the meshes
+/// can be drawn without rebinding and merged into multi-draws. meshes small enough get 16 bit indices, which are
+/// relative to the base vertex of the mesh. meshes may also keep their positions alone in a position stream
+/// for depth only passes. allocation only bumps, the space of a mesh is never reused
+class GeometryArena
+{
+public:
+    /// no gl calls, the buffers are created by the first allocate()
+    GeometryArena();
+
+    /// deletes the buffers, render thread only
+    ~GeometryArena();
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    /// copy a mesh into the arena, vertices are in vertexFormat. with positionStream their positions are also copied
+    /// into the position stream. the buffers grow when it does not fit. render thread only
+    ArenaRange allocate(VertexFormat vertexFormat, const void* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                        bool positionStream = false);
+
+    /// vertex array over the vertices of vertexFormat and the indices of indexType, it stays the same when the buffers grow
+    GLuint vertexArray(VertexFormat vertexFormat, GLenum indexType) const { return m_vertexArrays[vertexFormat][slot(indexType)]; }
+
+    /// vertex array over the position stream of vertexFormat and the indices of indexType, draws with positionBaseVertex
+    GLuint positionArray(VertexFormat vertexFormat, GLenum indexType) const { return m_positionArrays[vertexFormat][slot(indexType)]; }
+
+    size_t vertexCount(VertexFormat vertexFormat) const { return m_vertexBuffers[vertexFormat].count; }
+    size_t indexCount(GLenum indexType) const { return m_indexBuffers[slot(indexType)].count; }
+
+    /// GL_UNSIGNED_SHORT when every vertex of a mesh can be addressed with 16 bits, GL_UNSIGNED_INT otherwise
+    static GLenum indexType(size_t vertexCount) { return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+    static size_t indexSize(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+
+    /// indices in the layout of indexType, either the input itself or a copy narrowed into scratch
+    static const void* packIndices(const unsigned int* indices, size_t indexCount, GLenum indexType, std::vector<GLushort>& scratch);
+
+private:
+    /// count and capacity in vertices or indices
+    struct Buffer
+    {
+        GLuint buffer;
+        size_t count;
+        size_t capacity;
+    };
+
+    static size_t slot(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? 0 : 1; }
+
+    /// make room for count more elements of elementSize bytes, doubling the capacity
+    void reserve(Buffer& buffer, size_t count, size_t elementSize, size_t initialCapacity);
+
+    /// point the vertex arrays of the pair at their buffers, created on first use
+    void setupVertexArrays(VertexFormat vertexFormat, GLenum indexType);
+
+private:
+    Buffer m_vertexBuffers[VERTEX_FORMAT_COUNT];
+    Buffer m_positionBuffers[VERTEX_FORMAT_COUNT];
+    /// 16 bit and 32 bit indices
+    Buffer m_indexBuffers[2];
+    GLuint m_vertexArrays[VERTEX_FORMAT_COUNT][2];
+    GLuint m_positionArrays[VERTEX_FORMAT_COUNT][2];
+};
+
+/// list of arena draws submitted in one call per range of commands. uses glMultiDrawElementsBaseVertex (gl 3.2)
+/// with the commands in client memory, or glMultiDrawElementsIndirect with the commands in a gpu buffer when
+/// asked for and available. the base vertex path is the default, it measured faster on the drivers tried
+class MultiDraw
+{
+public:
+    MultiDraw();
+
+    /// deletes the indirect buffer, render thread only
+    ~MultiDraw();
+    MultiDraw(const MultiDraw&) = delete;
+    MultiDraw& operator=(const MultiDraw&) = delete;
+
+    void clear();
+    void add(const ArenaRange& range);
+
+    /// prefer glMultiDrawElementsIndirect, set before finish()
+    void setIndirect(bool indirect) { m_preferIndirect = indirect; }
+
+    /// whether draw() goes through the indirect buffer
+    bool indirect() const;
+
+    /// upload the commands after the last add()
+    void finish();
+
+    /// draw commands [first, first + count) in one call. the commands must share one index type and
+    /// the arena vertex array of that type must be bound
+    void draw(size_t first, size_t count) const;
+
+    size_t size() const { return m_commands.size(); }
+
+private:
+    /// layout fixed by ARB_draw_indirect
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    std::vector<DrawElementsIndirectCommand> m_commands;
+
+    /// glMultiDrawElementsBaseVertex reads the commands from client memory
+    std::vector<GLsizei> m_counts;
+    std::vector<const void*> m_offsets;
+    std::vector<GLint> m_baseVertices;
+    std::vector<GLenum> m_indexTypes;
+
+    GLuint m_indirectBuffer;
+    bool m_preferIndirect;
+};
+
+#endif /* GeometryArena_h */
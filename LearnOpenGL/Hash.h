@@ -0,0 +1,42 @@
+//
+//  Hash.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef Hash_h
+#define Hash_h
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Hash
+{
+
+/// 64-bit FNV-1a, used to key on-disk caches
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/// FNV-1a of a zero terminated string, same value as fnv1a64 over its characters.
+/// constexpr so names known at compile time are hashed by the compiler
+constexpr uint64_t fnv1a64String(const char* string, uint64_t hash = 14695981039346656037ull)
+{
+    while (*string != '\0')
+    {
+        hash ^= (unsigned char)*string++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+#endif /* Hash_h */
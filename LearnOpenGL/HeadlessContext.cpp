@@ -0,0 +1,148 @@
+//
+//  HeadlessContext.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "HeadlessContext.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext()
+    : m_display(nullptr), m_context(nullptr), m_FBO(0), m_colorRBO(0), m_depthRBO(0)
+{
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    destroy();
+}
+
+bool HeadlessContext::create(bool debug)
+{
+#ifdef __linux__
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    // prefer the surfaceless platform, it needs neither X11/Wayland nor a gpu device node
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr)
+    {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY)
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        std::cerr << "Failed to initialize EGL display" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cerr << "EGL does not support desktop OpenGL" << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_NONE};
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+
+    // same version and profile as the glfw window, see Engine::init
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+        EGL_NONE};
+    EGLContext context = eglCreateContext(display, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Failed to create EGL context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::cerr << "Failed to make EGL context current" << std::endl;
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    m_display = display;
+    m_context = context;
+    return true;
+#else
+    std::cerr << "Headless rendering is only supported with EGL on linux" << std::endl;
+    return false;
+#endif
+}
+
+bool HeadlessContext::createFramebuffer(int width, int height)
+{
+    glGenRenderbuffers(1, &m_colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &m_depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthRBO);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete)
+    {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+    }
+    return complete;
+}
+
+void HeadlessContext::destroy()
+{
+#ifdef __linux__
+    if (m_context != nullptr)
+    {
+        if (m_FBO != 0)
+        {
+            glDeleteFramebuffers(1, &m_FBO);
+            glDeleteRenderbuffers(1, &m_colorRBO);
+            glDeleteRenderbuffers(1, &m_depthRBO);
+            m_FBO = m_colorRBO = m_depthRBO = 0;
+        }
+        eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)m_display, (EGLContext)m_context);
+        eglTerminate((EGLDisplay)m_display);
+        m_context = nullptr;
+        m_display = nullptr;
+    }
+#endif
+}
+
+GLADloadproc HeadlessContext::loader()
+{
+#ifdef __linux__
+    return (GLADloadproc)eglGetProcAddress;
+#else
+    return nullptr;
+#endif
+}
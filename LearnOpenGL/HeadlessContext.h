@@ -0,0 +1,42 @@
+//
+//  HeadlessContext.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef HeadlessContext_h
+#define HeadlessContext_h
+
+#include <glad/glad.h>
+
+/// OpenGL context without window or display (EGL surfaceless, e.g. Mesa llvmpipe),
+/// the scene is rendered into an offscreen framebuffer instead of the back buffer.
+/// only available on linux and only when the app is linked against libEGL, which neither the
+/// xcode nor the visual studio project does. everywhere else create() fails and --headless exits
+class HeadlessContext
+{
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    /// create the context and make it current, optionally as a debug context
+    bool create(bool debug = false);
+
+    /// create the offscreen framebuffer, requires the gl functions to be loaded
+    bool createFramebuffer(int width, int height);
+    void destroy();
+
+    GLuint framebuffer() const { return m_FBO; }
+    static GLADloadproc loader();
+
+private:
+    void* m_display;
+    void* m_context;
+
+    GLuint m_FBO;
+    GLuint m_colorRBO;
+    GLuint m_depthRBO;
+};
+
+#endif /* HeadlessContext_h */
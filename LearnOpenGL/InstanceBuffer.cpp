@@ -0,0 +1,52 @@
+//
+//  InstanceBuffer.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "InstanceBuffer.h"
+#include "GLState.h"
+
+InstanceBuffer::InstanceBuffer()
+    : m_buffer(0), m_capacity(0), m_count(0)
+{
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    if (m_buffer != 0)
+    {
+        GLState::deleteBuffers(1, &m_buffer);
+    }
+}
+
+void InstanceBuffer::update(const glm::mat4* transforms, size_t count)
+{
+    if (m_buffer == 0)
+    {
+        glGenBuffers(1, &m_buffer);
+    }
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    // keep the largest size seen, so a changing instance count does not reallocate every frame
+    if (count > m_capacity)
+    {
+        m_capacity = count;
+    }
+    glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+    m_count = count;
+}
+
+void InstanceBuffer::bindAttributes() const
+{
+    // the buffer name never changes, but a vertex array may have been set up by another instance buffer
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        GLuint location = MODEL_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
@@ -0,0 +1,44 @@
+//
+//  InstanceBuffer.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef InstanceBuffer_h
+#define InstanceBuffer_h
+
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/// per-instance model matrices for instanced draws, read by the INSTANCED shader variants
+/// through the attribute locations 4-7 (glsl 4.1 has no storage buffers)
+class InstanceBuffer
+{
+public:
+    /// first of the four locations of the mat4 attribute
+    static const GLuint MODEL_LOCATION = 4;
+
+    InstanceBuffer();
+
+    /// deletes the buffer, render thread only
+    ~InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    /// replace the matrices, the old storage is orphaned so draws still reading it never stall the update
+    void update(const glm::mat4* transforms, size_t count);
+
+    /// point the instance attributes of the bound vertex array at the buffer
+    void bindAttributes() const;
+
+    size_t count() const { return m_count; }
+
+private:
+    GLuint m_buffer;
+    size_t m_capacity;
+    size_t m_count;
+};
+
+#endif /* InstanceBuffer_h */
@@ -9,6 +9,13 @@
 #define Light_hpp
 #include <glm/glm.hpp>
 
+/// distance at which the inverse square falloff takes the brightest channel under 1/256
+inline float lightReach(const glm::vec3 &color, float intensity)
+{
+    float peak = intensity * glm::max(color.r, glm::max(color.g, color.b));
+    return glm::sqrt(peak * 256.f);
+}
+
 struct PointLight
 {
     PointLight(glm::vec3 _position, glm::vec3 _color = glm::vec3(1.f, 1.f, 1.f))
@@ -25,6 +32,9 @@ struct PointLight
     float constant = 1.0f;
     float linear = 0.01f;
     float quadratic = 0.0005f;
+
+    /// see lightReach()
+    float reach() const { return lightReach(color, intensity); }
 };
 
 struct FlashLight
@@ -48,5 +58,23 @@ struct FlashLight
     float constant = 1.f;
     float linear = 0.09f;
     float quadratic = 0.032f;
+
+    /// see lightReach()
+    float reach() const { return lightReach(color, intensity); }
+};
+
+struct DirectionalLight
+{
+    DirectionalLight(glm::vec3 _direction, glm::vec3 _color = glm::vec3(1.f, 1.f, 1.f))
+    {
+        direction = _direction;
+        color = _color;
+    }
+    bool on = true;
+
+    /// the way the light travels, from the light into the scene
+    glm::vec3 direction;
+    glm::vec3 color;
+    float intensity = 3.f;
 };
 #endif /* Light_hpp */
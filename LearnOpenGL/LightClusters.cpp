@@ -0,0 +1,207 @@
+//
+//  LightClusters.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "LightClusters.h"
+#include "GLState.h"
+#include "Program.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/// light lists hold 16 bit indices
+static const size_t MAX_LIGHTS = 65535;
+
+namespace Uniforms
+{
+    constexpr UniformName clusteredLights("clusteredLights");
+    constexpr UniformName clusterLights("clusterLights");
+    constexpr UniformName clusterRanges("clusterRanges");
+    constexpr UniformName clusterIndices("clusterIndices");
+    constexpr UniformName clusterCounts("clusterCounts");
+    constexpr UniformName clusterScale("clusterScale");
+    constexpr UniformName clusterBias("clusterBias");
+}
+
+/// squared distance from point to the box, 0 inside
+static float distanceSquared(const AABB& box, const glm::vec3& point)
+{
+    glm::vec3 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.f));
+    return glm::dot(d, d);
+}
+
+LightClusters::LightClusters()
+    : m_grid(0), m_boundsProject(0.f), m_width(0), m_height(0), m_near(0.f), m_far(0.f)
+{
+}
+
+void LightClusters::create(int tilesX, int tilesY, int slices)
+{
+    m_grid = glm::max(glm::ivec3(tilesX, tilesY, slices), glm::ivec3(1));
+    m_bounds.clear();
+    m_width = m_height = 0;
+    if (m_lightBuffer.texture() == 0)
+    {
+        m_lightBuffer.create(GL_RGBA32F);
+        m_clusterBuffer.create(GL_RG32UI);
+        m_indexBuffer.create(GL_R16UI);
+    }
+}
+
+void LightClusters::updateBounds(const glm::mat4& project, int width, int height)
+{
+    if (!m_bounds.empty() && project == m_boundsProject && width == m_width && height == m_height)
+    {
+        return;
+    }
+    m_boundsProject = project;
+    m_width = width;
+    m_height = height;
+    m_near = project[3][2] / (project[2][2] - 1.f);
+    m_far = project[3][2] / (project[2][2] + 1.f);
+
+    // a tile spans a range of ndc, at a depth d the view space x of ndc x is x * d / project[0][0]
+    m_bounds.resize((size_t)m_grid.x * m_grid.y * m_grid.z);
+    glm::vec2 tangents(1.f / project[0][0], 1.f / project[1][1]);
+    for (int slice = 0; slice < m_grid.z; ++slice)
+    {
+        float nearDepth = m_near * std::pow(m_far / m_near, (float)slice / m_grid.z);
+        float farDepth = m_near * std::pow(m_far / m_near, (float)(slice + 1) / m_grid.z);
+        for (int y = 0; y < m_grid.y; ++y)
+        {
+            for (int x = 0; x < m_grid.x; ++x)
+            {
+                glm::vec2 low = glm::vec2((float)x / m_grid.x, (float)y / m_grid.y) * 2.f - 1.f;
+                glm::vec2 high = glm::vec2((float)(x + 1) / m_grid.x, (float)(y + 1) / m_grid.y) * 2.f - 1.f;
+                glm::vec2 corners[4] = {low * tangents * nearDepth, high * tangents * nearDepth, low * tangents * farDepth, high * tangents * farDepth};
+                AABB& box = m_bounds[((size_t)slice * m_grid.y + y) * m_grid.x + x];
+                box.min = glm::vec3(glm::min(glm::min(corners[0], corners[1]), glm::min(corners[2], corners[3])), -farDepth);
+                box.max = glm::vec3(glm::max(glm::max(corners[0], corners[1]), glm::max(corners[2], corners[3])), -nearDepth);
+            }
+        }
+    }
+}
+
+void LightClusters::update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& project, int width, int height)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_stats = Stats();
+    if (m_lightBuffer.texture() == 0)
+    {
+        return;
+    }
+    updateBounds(project, width, height);
+    size_t clusterCount = m_bounds.size();
+    m_stats.lights = (int)lights.size();
+    m_stats.clusters = (int)clusterCount;
+
+    Frustum frustum(project * view);
+    float logScale = m_grid.z / std::log(m_far / m_near);
+    m_lightData.clear();
+    m_references.clear();
+    for (const Light& light : lights)
+    {
+        if (m_lightData.size() / 4 >= MAX_LIGHTS)
+        {
+            break;
+        }
+        float r = light.reach();
+        if (!frustum.intersects(BoundingSphere{light.position, r}))
+        {
+            continue;
+        }
+        uint16_t index = (uint16_t)(m_lightData.size() / 4);
+        m_lightData.push_back(glm::vec4(light.position, r));
+        m_lightData.push_back(glm::vec4(light.color * light.intensity, (float)light.type));
+        m_lightData.push_back(glm::vec4(light.type == Light::SPOT ? glm::normalize(light.direction) : glm::vec3(0.f), (float)light.shadowIndex));
+        m_lightData.push_back(glm::vec4(light.cutOff, light.outerCutOff, (float)light.shadowMap, 0.f));
+
+        // the clusters the sphere can touch: the depth slices of its depth range and the tiles of the box around its
+        // projection. x / d over the box around the sphere is largest and smallest at the corners
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.f));
+        float depth = -center.z;
+        glm::ivec3 low(0);
+        glm::ivec3 high = m_grid - 1;
+        low.z = glm::clamp((int)std::floor(std::log(std::max(depth - r, m_near) / m_near) * logScale), 0, m_grid.z - 1);
+        high.z = glm::clamp((int)std::floor(std::log(std::max(depth + r, m_near) / m_near) * logScale), 0, m_grid.z - 1);
+        if (depth - r > m_near)
+        {
+            for (int axis = 0; axis < 2; ++axis)
+            {
+                float scale = project[axis][axis];
+                float a = (center[axis] - r) / (depth - r), b = (center[axis] - r) / (depth + r);
+                float c = (center[axis] + r) / (depth - r), d = (center[axis] + r) / (depth + r);
+                float ndcLow = std::min(std::min(a, b), std::min(c, d)) * scale;
+                float ndcHigh = std::max(std::max(a, b), std::max(c, d)) * scale;
+                low[axis] = glm::clamp((int)std::floor((ndcLow * 0.5f + 0.5f) * m_grid[axis]), 0, m_grid[axis] - 1);
+                high[axis] = glm::clamp((int)std::floor((ndcHigh * 0.5f + 0.5f) * m_grid[axis]), 0, m_grid[axis] - 1);
+            }
+        }
+
+        float rangeSquared = r * r;
+        for (int z = low.z; z <= high.z; ++z)
+        {
+            for (int y = low.y; y <= high.y; ++y)
+            {
+                for (int x = low.x; x <= high.x; ++x)
+                {
+                    uint32_t cluster = ((uint32_t)z * m_grid.y + y) * m_grid.x + x;
+                    if (distanceSquared(m_bounds[cluster], center) <= rangeSquared)
+                    {
+                        m_references.emplace_back(cluster, index);
+                    }
+                }
+            }
+        }
+    }
+    m_stats.visibleLights = (int)(m_lightData.size() / 4);
+    m_stats.references = (int)m_references.size();
+
+    // counting sort by cluster, every list keeps the order of the lights so the sums come out as without clusters
+    m_clusterData.assign(clusterCount * 2, 0);
+    for (const auto& reference : m_references)
+    {
+        m_clusterData[reference.first * 2 + 1]++;
+    }
+    uint32_t offset = 0;
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        uint32_t count = m_clusterData[cluster * 2 + 1];
+        m_clusterData[cluster * 2] = offset;
+        m_clusterData[cluster * 2 + 1] = 0;
+        offset += count;
+        m_stats.occupiedClusters += count > 0;
+        m_stats.maxLights = std::max(m_stats.maxLights, (int)count);
+    }
+    m_indexData.resize(m_references.size());
+    for (const auto& reference : m_references)
+    {
+        uint32_t* range = &m_clusterData[reference.first * 2];
+        m_indexData[range[0] + range[1]++] = reference.second;
+    }
+
+    m_lightBuffer.update(m_lightData.data(), m_lightData.size() * sizeof(glm::vec4));
+    m_clusterBuffer.update(m_clusterData.data(), m_clusterData.size() * sizeof(uint32_t));
+    m_indexBuffer.update(m_indexData.data(), m_indexData.size() * sizeof(uint16_t));
+    m_stats.binMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightClusters::bind(Program* program, GLuint firstUnit) const
+{
+    GLState::bindTexture(firstUnit, GL_TEXTURE_BUFFER, m_lightBuffer.texture());
+    GLState::bindTexture(firstUnit + 1, GL_TEXTURE_BUFFER, m_clusterBuffer.texture());
+    GLState::bindTexture(firstUnit + 2, GL_TEXTURE_BUFFER, m_indexBuffer.texture());
+    program->setUniform1i(Uniforms::clusteredLights, 1);
+    program->setUniform1i(Uniforms::clusterLights, firstUnit);
+    program->setUniform1i(Uniforms::clusterRanges, firstUnit + 1);
+    program->setUniform1i(Uniforms::clusterIndices, firstUnit + 2);
+
+    // the shader finds its cluster from the pixel and the view depth, slice = log(depth) * scale + bias
+    float logScale = m_grid.z / std::log(m_far / m_near);
+    program->setUniform3f(Uniforms::clusterCounts, glm::vec3(m_grid));
+    program->setUniform3f(Uniforms::clusterScale, glm::vec3((float)m_grid.x / m_width, (float)m_grid.y / m_height, logScale));
+    program->setUniform1f(Uniforms::clusterBias, -std::log(m_near) * logScale);
+}
@@ -0,0 +1,112 @@
+//
+//  LightClusters.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef LightClusters_h
+#define LightClusters_h
+
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+#include "Light.hpp"
+#include "UniformBuffer.h"
+
+class Program;
+
+/// point and spot lights binned into the clusters of the camera frustum, screen tiles times depth slices spaced
+/// evenly in log depth. each cluster lists the lights whose range reaches into it, so a fragment only lights itself
+/// with the lights of its cluster and the cost follows the lights around it rather than all lights in the scene.
+/// glsl 4.1 has neither storage buffers nor compute shaders, the lights are binned on the cpu every frame and the
+/// lights, the clusters and the light lists go to the gpu as texture buffers
+class LightClusters
+{
+public:
+    /// a light handed to update()
+    struct Light
+    {
+        enum Type
+        {
+            POINT = 0,
+            SPOT,
+        };
+
+        Type type;
+        glm::vec3 position;
+        glm::vec3 color;
+        float intensity;
+        /// spot lights only, the cone axis and the cosines of the inner and outer half angles
+        glm::vec3 direction;
+        float cutOff;
+        float outerCutOff;
+        /// one of ShadowMaps, for ATLAS the light's record in ShadowAtlas::lightBuffer()
+        int shadowMap;
+        int shadowIndex;
+
+        /// distance the light ends at, see lightReach()
+        float reach() const { return lightReach(color, intensity); }
+    };
+
+    /// what the last update() found
+    struct Stats
+    {
+        int lights = 0;
+        /// lights inside the view frustum
+        int visibleLights = 0;
+        int clusters = 0;
+        /// clusters with at least one light, entries of all light lists and the longest list
+        int occupiedClusters = 0;
+        int references = 0;
+        int maxLights = 0;
+        double binMs = 0.0;
+    };
+
+    LightClusters();
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    /// texture buffers for tilesX x tilesY screen tiles and slices depth slices, render thread only
+    void create(int tilesX, int tilesY, int slices);
+
+    /// bin the lights for the camera, a gl perspective projection, over a viewport of width x height pixels and upload
+    /// them. the first 65535 lights are kept
+    void update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& project, int width, int height);
+
+    /// bind the buffers to the texture units firstUnit to firstUnit + 2 and set the cluster uniforms of program,
+    /// which must be in use
+    void bind(Program* program, GLuint firstUnit) const;
+
+    const Stats& stats() const { return m_stats; }
+    glm::ivec3 grid() const { return m_grid; }
+
+private:
+    /// view space bounds of every cluster, kept while the projection and the viewport stay the same
+    void updateBounds(const glm::mat4& project, int width, int height);
+
+private:
+    glm::ivec3 m_grid;
+    TextureBuffer m_lightBuffer;
+    TextureBuffer m_clusterBuffer;
+    TextureBuffer m_indexBuffer;
+
+    glm::mat4 m_boundsProject;
+    int m_width;
+    int m_height;
+    float m_near;
+    float m_far;
+    std::vector<AABB> m_bounds;
+
+    /// four texels per light, offset and count per cluster, the light lists one after another
+    std::vector<glm::vec4> m_lightData;
+    std::vector<uint32_t> m_clusterData;
+    std::vector<uint16_t> m_indexData;
+    /// cluster and light of every light reaching into a cluster, in light order
+    std::vector<std::pair<uint32_t, uint16_t>> m_references;
+    Stats m_stats;
+};
+
+#endif /* LightClusters_h */
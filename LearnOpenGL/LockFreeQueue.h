@@ -0,0 +1,74 @@
+//
+//  LockFreeQueue.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef LockFreeQueue_h
+#define LockFreeQueue_h
+
+#include <atomic>
+#include <utility>
+
+/// unbounded multi-producer single-consumer queue (Vyukov), producers never block each other
+/// and the consumer never takes a lock, used to hand work from worker threads to the render thread
+template <typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue()
+    {
+        Node* stub = new Node();
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    ~LockFreeQueue()
+    {
+        T value;
+        while (pop(value))
+        {
+        }
+        delete m_tail;
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    /// may be called from any thread
+    void push(T value)
+    {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /// consumer thread only
+    bool pop(T& value)
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        value = std::move(next->value);
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+};
+
+#endif /* LockFreeQueue_h */
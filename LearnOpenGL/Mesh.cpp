@@ -5,24 +5,245 @@
 //  Created by asi on 2024/8/31.
 //
 
+#include "GLState.h"
 #include "Mesh.h"
-#include <stb/stb_image.h>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
 
-Mesh::Mesh(std::vector<Vertex> _vetexs, std::vector<unsigned int> _indices, std::vector<Texture> _texture)
-    : m_vertexs(_vetexs), m_indices(_indices), m_textures(_texture)
+namespace
 {
-    m_initialized = false;
+    constexpr UniformName POSITION_SCALE("positionScale");
+    constexpr UniformName POSITION_BIAS("positionBias");
+
+    /// largest texCoord packed as half float, steps there are 1/512
+    const float MAX_PACKED_TEXCOORD = 4.f;
+    /// fewest quantization steps across the largest axis of a mesh before it gets a box of its own
+    const float MIN_QUANTIZATION_STEPS = 4096.f;
+    const float QUANTIZATION_STEPS = 65535.f;
+}
+
+Mesh::Mesh(std::vector<Vertex> _vetexs, std::vector<unsigned int> _indices, std::vector<Texture> _texture, std::vector<MeshLod> _lods)
+    : m_vertexs(std::move(_vetexs)), m_indices(std::move(_indices)), m_textures(std::move(_texture)), m_lods(std::move(_lods))
+{
+    m_externalVertexs = nullptr;
+    m_externalIndices = nullptr;
+    m_vertexCount = m_vertexs.size();
+    m_indexCount = m_indices.size();
+    m_residency = UNLOADED;
+    m_decodeRemaining = 0;
+    m_VAO = m_VBO = m_EBO = 0;
+    m_positionVAO = m_positionVBO = 0;
+    m_positionStream = false;
+    m_arena = nullptr;
+    m_arenaRange = ArenaRange();
+    m_vertexFormat = VERTEX_FLOAT;
+    m_positionScale = glm::vec3(1.f);
+    m_positionBias = glm::vec3(0.f);
+    if (m_lods.empty())
+    {
+        m_lods.push_back({0, (uint32_t)m_indexCount, 0.f});
+    }
+    setupSamplerNames();
+    computeBounds();
+}
+
+Mesh::Mesh(const Vertex* _vertexs, size_t _vertexCount, const unsigned int* _indices, size_t _indexCount, std::vector<Texture> _texture,
+           std::shared_ptr<const void> _storage, std::vector<MeshLod> _lods)
+    : m_textures(std::move(_texture)), m_storage(std::move(_storage)), m_lods(std::move(_lods))
+{
+    m_externalVertexs = _vertexs;
+    m_externalIndices = _indices;
+    m_vertexCount = _vertexCount;
+    m_indexCount = _indexCount;
+    m_residency = UNLOADED;
+    m_decodeRemaining = 0;
+    m_VAO = m_VBO = m_EBO = 0;
+    m_positionVAO = m_positionVBO = 0;
+    m_positionStream = false;
+    m_arena = nullptr;
+    m_arenaRange = ArenaRange();
+    m_vertexFormat = VERTEX_FLOAT;
+    m_positionScale = glm::vec3(1.f);
+    m_positionBias = glm::vec3(0.f);
+    if (m_lods.empty())
+    {
+        m_lods.push_back({0, (uint32_t)m_indexCount, 0.f});
+    }
+    setupSamplerNames();
+    computeBounds();
 }
 
 Mesh::~Mesh()
 {
-    
+    if (m_positionVAO != 0)
+    {
+        GLState::deleteVertexArrays(1, &m_positionVAO);
+    }
+    if (m_positionVBO != 0)
+    {
+        GLState::deleteBuffers(1, &m_positionVBO);
+    }
 }
 
-void Mesh::draw(Program* program)
+void Mesh::draw(Program* program, size_t lod)
 {
     if (program == nullptr) return;
     
+    bindMaterial(program);
+    bindVertexDecode(program);
+    if (m_arena)
+    {
+        ArenaRange range = arenaRange(lod);
+        GLState::bindVertexArray(m_arena->vertexArray(range.vertexFormat, range.indexType));
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, (void*)(range.firstIndex * GeometryArena::indexSize(range.indexType)),
+                                 range.baseVertex);
+    }
+    else
+    {
+        GLState::bindVertexArray(m_VAO);
+        glDrawElements(GL_TRIANGLES, (int)m_lods[lod].indexCount, indexType(), (void*)(m_lods[lod].firstIndex * GeometryArena::indexSize(indexType())));
+    }
+}
+
+void Mesh::drawDepth(Program* program, size_t lod, GLsizei instances)
+{
+    if (program == nullptr) return;
+
+    bindVertexDecode(program);
+    if (m_arena)
+    {
+        ArenaRange range = m_positionStream ? positionRange(lod) : arenaRange(lod);
+        GLState::bindVertexArray(m_positionStream ? m_arena->positionArray(range.vertexFormat, range.indexType)
+                                                  : m_arena->vertexArray(range.vertexFormat, range.indexType));
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, (void*)(range.firstIndex * GeometryArena::indexSize(range.indexType)),
+                                          instances, range.baseVertex);
+    }
+    else
+    {
+        GLState::bindVertexArray(m_positionStream ? m_positionVAO : m_VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, (int)m_lods[lod].indexCount, indexType(), (void*)(m_lods[lod].firstIndex * GeometryArena::indexSize(indexType())),
+                                instances);
+    }
+}
+
+void Mesh::drawInstanced(Program* program, const InstanceBuffer& instances, GLsizei count)
+{
+    if (program == nullptr || count <= 0) return;
+
+    bindMaterial(program);
+    bindVertexDecode(program);
+    if (m_arena)
+    {
+        ArenaRange range = arenaRange(0);
+        GLState::bindVertexArray(m_arena->vertexArray(range.vertexFormat, range.indexType));
+        instances.bindAttributes();
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, (void*)(range.firstIndex * GeometryArena::indexSize(range.indexType)),
+                                          count, range.baseVertex);
+    }
+    else
+    {
+        GLState::bindVertexArray(m_VAO);
+        instances.bindAttributes();
+        glDrawElementsInstanced(GL_TRIANGLES, (int)m_lods[0].indexCount, indexType(), 0, count);
+    }
+}
+
+ArenaRange Mesh::arenaRange(size_t lod) const
+{
+    ArenaRange range = m_arenaRange;
+    range.firstIndex += m_lods[lod].firstIndex;
+    range.indexCount = (GLsizei)m_lods[lod].indexCount;
+    return range;
+}
+
+ArenaRange Mesh::positionRange(size_t lod) const
+{
+    ArenaRange range = arenaRange(lod);
+    range.baseVertex = m_arenaRange.positionBaseVertex;
+    return range;
+}
+
+void Mesh::bindMaterial(Program* program)
+{
+    // bindings are left in place, the next draw usually wants the same ones
+    for (int i = 0; i < (int)m_textures.size(); i++)
+    {
+        program->setUniform1i(m_samplerUniforms[i], i);
+        GLState::bindTexture(i, GL_TEXTURE_2D, m_textures[i].id);
+    }
+}
+
+VertexFormat Mesh::setPackedVertices(const AABB& box)
+{
+    if (m_vertexCount == 0)
+    {
+        return m_vertexFormat;
+    }
+    const Vertex* vertexs = vertices();
+    for (size_t i = 0; i < m_vertexCount; ++i)
+    {
+        if (glm::abs(vertexs[i].texCoords.x) > MAX_PACKED_TEXCOORD || glm::abs(vertexs[i].texCoords.y) > MAX_PACKED_TEXCOORD)
+        {
+            return m_vertexFormat;
+        }
+    }
+
+    // a small part of a large model would come out blocky on the grid of the model box
+    glm::vec3 meshSize = m_bounds.max - m_bounds.min;
+    glm::vec3 boxSize = box.max - box.min;
+    float meshExtent = std::max(meshSize.x, std::max(meshSize.y, meshSize.z));
+    float boxExtent = std::max(boxSize.x, std::max(boxSize.y, boxSize.z));
+    m_quantization = meshExtent * QUANTIZATION_STEPS < MIN_QUANTIZATION_STEPS * boxExtent ? m_bounds : box;
+    m_vertexFormat = VERTEX_PACKED;
+    return m_vertexFormat;
+}
+
+void Mesh::bindVertexDecode(Program* program)
+{
+    program->setUniform3f(POSITION_SCALE, m_positionScale);
+    program->setUniform3f(POSITION_BIAS, m_positionBias);
+}
+
+void Mesh::packVertices()
+{
+    if (m_vertexFormat != VERTEX_PACKED)
+    {
+        return;
+    }
+
+    // the attribute arrives normalized to [0, 1], the decode stretches it back over the box
+    glm::vec3 size = m_quantization.max - m_quantization.min;
+    glm::vec3 inverseSize(size.x > 0.f ? 1.f / size.x : 0.f, size.y > 0.f ? 1.f / size.y : 0.f, size.z > 0.f ? 1.f / size.z : 0.f);
+    m_positionScale = size;
+    m_positionBias = m_quantization.min;
+
+    const Vertex* vertexs = vertices();
+    m_packedVertexs.resize(m_vertexCount);
+    for (size_t i = 0; i < m_vertexCount; ++i)
+    {
+        const Vertex& vertex = vertexs[i];
+        PackedVertex& packed = m_packedVertexs[i];
+        glm::vec3 position = glm::clamp((vertex.position - m_positionBias) * inverseSize, 0.f, 1.f);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            packed.position[axis] = (uint16_t)std::lround(position[axis] * QUANTIZATION_STEPS);
+        }
+        packed.position[3] = 0;
+        float length = glm::length(vertex.normal);
+        packed.normal = glm::packSnorm3x10_1x2(glm::vec4(length > 0.f ? vertex.normal / length : vertex.normal, 0.f));
+        packed.texCoords[0] = glm::packHalf1x16(vertex.texCoords.x);
+        packed.texCoords[1] = glm::packHalf1x16(vertex.texCoords.y);
+    }
+}
+
+const void* Mesh::uploadVertices() const
+{
+    return m_vertexFormat == VERTEX_PACKED ? (const void*)m_packedVertexs.data() : (const void*)vertices();
+}
+
+void Mesh::setupSamplerNames()
+{
+    // "material.<type><n>", numbered per type in texture order
     unsigned int diffIndex = 1;
     unsigned int specIndex = 1;
     unsigned int emisIndex = 1;
@@ -31,7 +252,6 @@ void Mesh::draw(Program* program)
     unsigned int opacIndex = 1;
     for (int i = 0; i < m_textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
         int num = 0;
         if (m_textures[i].type == "diffuse")
         {
@@ -57,24 +277,90 @@ void Mesh::draw(Program* program)
         {
             num = opacIndex++;
         }
-        program->setUniform1i("material." + m_textures[i].type + std::to_string(num), i);
-        glBindTexture(GL_TEXTURE_2D, m_textures[i].id);
+        m_samplerNames.push_back("material." + m_textures[i].type + std::to_string(num));
+    }
+
+    // the names are complete, the uniform names can point into them now
+    for (const std::string& name : m_samplerNames)
+    {
+        m_samplerUniforms.emplace_back(name);
     }
-    glBindVertexArray(m_VAO);
-    glDrawElements(GL_TRIANGLES, (int)m_indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-    
-    glActiveTexture(GL_TEXTURE0);
 }
 
-void Mesh::init()
+void Mesh::computeBounds()
+{
+    const glm::vec3* positions = m_vertexCount > 0 ? &vertices()->position : nullptr;
+    m_bounds = AABB::fromPoints(positions, m_vertexCount, sizeof(Vertex));
+    m_boundingSphere = BoundingSphere::fromBox(m_bounds, positions, m_vertexCount, sizeof(Vertex));
+}
+
+void Mesh::decode()
+{
+    if (!beginDecode())
+    {
+        return;
+    }
+    for (size_t i = 0; i < m_textures.size(); i++)
+    {
+        decodeTexture(i);
+    }
+}
+
+bool Mesh::beginDecode()
+{
+    packVertices();
+    for (Texture& texture : m_textures)
+    {
+        texture.handle = TextureManager::instance().acquire(texture.path);
+    }
+    m_decodeRemaining = m_textures.size();
+    m_residency = m_textures.empty() ? DECODED : DECODING;
+    return !m_textures.empty();
+}
+
+bool Mesh::decodeTexture(size_t index)
 {
-    setupMesh();
+    // a file shared with another mesh is decoded once, this waits for or skips the other decode
+    m_textures[index].handle->decode();
+
+    if (m_decodeRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        m_residency = DECODED;
+        return true;
+    }
+    return false;
+}
+
+void Mesh::upload(TextureUploader* uploader)
+{
+    if (residency() != DECODED)
+    {
+        return;
+    }
+
+    if (m_arena)
+    {
+        m_arenaRange = m_arena->allocate(m_vertexFormat, uploadVertices(), m_vertexCount, indices(), m_indexCount, m_positionStream);
+    }
+    else
+    {
+        setupMesh();
+    }
+    std::vector<PackedVertex>().swap(m_packedVertexs);
     for (int i = 0; i < m_textures.size(); i++)
     {
-        m_textures[i].id = loadTexture(m_textures[i].path);
+        m_textures[i].id = m_textures[i].handle->upload(uploader);
+    }
+    m_residency = RESIDENT;
+}
+
+void Mesh::init()
+{
+    if (residency() == UNLOADED)
+    {
+        decode();
     }
-    m_initialized = true;
+    upload();
 }
 
 void Mesh::setupMesh()
@@ -84,65 +370,81 @@ void Mesh::setupMesh()
     glGenBuffers(1, &m_VBO);
     glGenBuffers(1, &m_EBO);
     
-    glBindVertexArray(m_VAO);
+    GLState::bindVertexArray(m_VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    glBufferData(GL_ARRAY_BUFFER, m_vertexs.size() * sizeof(Vertex), &m_vertexs[0], GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, m_vertexCount * vertexSize(m_vertexFormat), uploadVertices(), GL_STATIC_DRAW);
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_STATIC_DRAW);
+    std::vector<GLushort> scratch;
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexCount * GeometryArena::indexSize(indexType()),
+                 GeometryArena::packIndices(indices(), m_indexCount, indexType(), scratch), GL_STATIC_DRAW);
     
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    glEnableVertexAttribArray(0);
-    
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-    
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-    glEnableVertexAttribArray(2);
+    setupVertexAttributes(m_vertexFormat);
+
+    if (m_positionStream)
+    {
+        // a second vertex array over the same indices
+        std::vector<uint8_t> positions;
+        gatherPositions(m_vertexFormat, uploadVertices(), m_vertexCount, positions);
+        glGenVertexArrays(1, &m_positionVAO);
+        glGenBuffers(1, &m_positionVBO);
+        GLState::bindVertexArray(m_positionVAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size(), positions.data(), GL_STATIC_DRAW);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        setupPositionAttributes(m_vertexFormat);
+    }
     
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 }
 
-unsigned int Mesh::loadTexture(const std::string& file)
+void Mesh::setupPositionAttributes(VertexFormat format)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    if (format == VERTEX_PACKED)
+    {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, (GLsizei)positionSize(format), (void*)0);
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)positionSize(format), (void*)0);
+    }
+    glEnableVertexAttribArray(0);
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(file.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+void Mesh::gatherPositions(VertexFormat format, const void* vertices, size_t count, std::vector<uint8_t>& positions)
+{
+    size_t stride = vertexSize(format);
+    size_t size = positionSize(format);
+    positions.resize(count * size);
+    for (size_t i = 0; i < count; ++i)
     {
-        GLenum format;
-        if (nrComponents == 1)
-        {
-            format = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            format = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            format = GL_RGBA;
-        }
+        memcpy(&positions[i * size], (const uint8_t*)vertices + i * stride, size);
+    }
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+void Mesh::setupVertexAttributes(VertexFormat format)
+{
+    if (format == VERTEX_PACKED)
+    {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(0);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // packed types always have 4 components, the shader reads xyz
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(1);
 
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << file << std::endl;
-        stbi_image_free(data);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+        glEnableVertexAttribArray(2);
+        return;
     }
 
-    return textureID;
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+    
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+    glEnableVertexAttribArray(2);
 }
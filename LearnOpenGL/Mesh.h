@@ -8,11 +8,17 @@
 #ifndef Mesh_h
 #define Mesh_h
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "InstanceBuffer.h"
 #include "Program.h"
+#include "TextureManager.h"
 
 struct Vertex {
     glm::vec3 position;
@@ -20,36 +26,195 @@ struct Vertex {
     glm::vec2 texCoords;
 };
 
+/// Vertex in 16 bytes: position as 16 bit unorm inside the quantization box of the mesh (w unused),
+/// normal as 10:10:10:2 snorm and texCoords as half floats. the gpu unpacks all but the box
+struct PackedVertex {
+    uint16_t position[4];
+    uint32_t normal;
+    uint16_t texCoords[2];
+};
+
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
+    /// shared with every other mesh using the same file, acquired when decoding starts
+    TextureRef handle;
+};
+
+/// one level of detail, a range of the index array over the shared vertices
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    /// how far the surface may be from LOD 0, in object space units
+    float error;
 };
 
 class Mesh
 {
 public:
-    Mesh(std::vector<Vertex> _vetexs, std::vector<unsigned int> _indices, std::vector<Texture> _texture);
+    /// where the mesh data currently lives, meshes are only drawn when RESIDENT
+    enum RESIDENCY
+    {
+        UNLOADED = 0,
+        DECODING,
+        DECODED,
+        RESIDENT,
+    };
+
+    /// the indices hold every LOD back to back as described by lods, no lods means one LOD over all of them
+    Mesh(std::vector<Vertex> _vetexs, std::vector<unsigned int> _indices, std::vector<Texture> _texture, std::vector<MeshLod> _lods = {});
+
+    /// mesh over vertex and index arrays owned by storage (e.g. a mapped cache file),
+    /// the storage is kept alive as long as the mesh
+    Mesh(const Vertex* _vertexs, size_t _vertexCount, const unsigned int* _indices, size_t _indexCount, std::vector<Texture> _texture,
+         std::shared_ptr<const void> _storage, std::vector<MeshLod> _lods = {});
     ~Mesh();
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
     
-    void draw(Program* program);
+    void draw(Program* program, size_t lod = 0);
+
+    /// draw positions only, from the position stream when the mesh keeps one. no textures are bound.
+    /// more than one instance only makes sense for programs that use gl_InstanceID, e.g. to pick a layer
+    void drawDepth(Program* program, size_t lod = 0, GLsizei instances = 1);
+
+    /// draw the first count instances of the buffer, the program must be an INSTANCED variant
+    void drawInstanced(Program* program, const InstanceBuffer& instances, GLsizei count);
+
+    /// bind the textures and set the sampler uniforms, draw() does this itself
+    void bindMaterial(Program* program);
+
+    /// keep the geometry in a shared arena instead of own buffers, set before upload
+    void setArena(GeometryArena* arena) { m_arena = arena; }
+    GeometryArena* arena() const { return m_arena; }
+    /// where the geometry of a LOD lives in the arena, valid once resident
+    ArenaRange arenaRange(size_t lod = 0) const;
+    /// the same with baseVertex in the position stream, for the arena position arrays
+    ArenaRange positionRange(size_t lod = 0) const;
+
+    /// also keep the positions tightly packed in a stream of their own, so depth only passes fetch nothing else.
+    /// set before upload
+    void setPositionStream(bool positionStream) { m_positionStream = positionStream; }
+    bool hasPositionStream() const { return m_positionStream; }
+
+    /// keep the vertices as PackedVertex on the gpu with positions quantized inside box, set before decode.
+    /// a mesh whose texCoords leave the range half floats resolve stays VERTEX_FLOAT, one that would get
+    /// too few steps of box is quantized inside its own bounds instead. returns the format it ended up with
+    VertexFormat setPackedVertices(const AABB& box);
+    VertexFormat vertexFormat() const { return m_vertexFormat; }
+
+    /// set the position decode uniforms of the vertex format, draw() does this itself
+    void bindVertexDecode(Program* program);
+
+    /// aPosition * positionScale + positionBias is the object space position
+    const glm::vec3& positionScale() const { return m_positionScale; }
+    const glm::vec3& positionBias() const { return m_positionBias; }
+
+    /// attribute layout of the format for the bound vertex array and array buffer
+    static void setupVertexAttributes(VertexFormat format = VERTEX_FLOAT);
+    static size_t vertexSize(VertexFormat format) { return format == VERTEX_PACKED ? sizeof(PackedVertex) : sizeof(Vertex); }
+
+    /// layout of the position stream of the format, the position is what both vertex layouts start with
+    static void setupPositionAttributes(VertexFormat format = VERTEX_FLOAT);
+    static size_t positionSize(VertexFormat format) { return format == VERTEX_PACKED ? sizeof(PackedVertex::position) : sizeof(Vertex::position); }
+    /// copy the positions out of count interleaved vertices of the format
+    static void gatherPositions(VertexFormat format, const void* vertices, size_t count, std::vector<uint8_t>& positions);
+
+    /// decode the textures into memory, safe to call from a worker thread
+    void decode();
+
+    /// start decoding texture by texture and pack the vertices, returns false when there is no texture to decode
+    bool beginDecode();
+
+    /// decode one texture, different indices may be decoded concurrently.
+    /// returns true for the call that finished the last texture
+    bool decodeTexture(size_t index);
+
+    /// create the gl buffers and textures from the decoded data, render thread only.
+    /// without an uploader the textures are uploaded straight from client memory
+    void upload(TextureUploader* uploader = nullptr);
+
+    /// decode and upload at once, render thread only
     void init();
-    bool isInitialized() { return m_initialized; };
+
+    RESIDENCY residency() const { return m_residency.load(std::memory_order_acquire); }
+    bool isResident() const { return residency() == RESIDENT; }
+
+    const Vertex* vertices() const { return m_storage ? m_externalVertexs : m_vertexs.data(); }
+    const unsigned int* indices() const { return m_storage ? m_externalIndices : m_indices.data(); }
+    size_t vertexCount() const { return m_vertexCount; }
+    /// indices of all LODs together
+    size_t indexCount() const { return m_indexCount; }
+    const std::vector<MeshLod>& lods() const { return m_lods; }
+
+    /// vertex cache miss ratios (see MeshProcessing::vertexCacheMissRatio) of the index order as imported, after welding
+    /// and after optimizing. only meshes processed at import have them, meshes mapped from the cache do not
+    struct ImportStats
+    {
+        std::string name;
+        float importedAcmr = 0.f;
+        float weldedAcmr = 0.f;
+        float optimizedAcmr = 0.f;
+    };
+    void setImportStats(ImportStats stats) { m_importStats = std::make_unique<ImportStats>(std::move(stats)); }
+    const ImportStats* importStats() const { return m_importStats.get(); }
+
+    /// type of the indices on the gpu, 16 bit whenever the vertex count allows
+    GLenum indexType() const { return GeometryArena::indexType(m_vertexCount); }
+    const std::vector<Texture>& textures() const { return m_textures; }
+
+    /// object space bounds of the vertices, computed when the mesh is created
+    const AABB& bounds() const { return m_bounds; }
+    const BoundingSphere& boundingSphere() const { return m_boundingSphere; }
 
 private:
     void setupMesh();
-    unsigned int loadTexture(const std::string& file);
+    void setupSamplerNames();
+    void computeBounds();
+    void packVertices();
+    /// vertices in m_vertexFormat for the upload
+    const void* uploadVertices() const;
     
 private:
     std::vector<Vertex> m_vertexs;
     std::vector<unsigned int> m_indices;
     std::vector<Texture> m_textures;
+
+    /// sampler uniform of each texture, built once instead of per draw
+    std::vector<std::string> m_samplerNames;
+    std::vector<UniformName> m_samplerUniforms;
+
+    const Vertex* m_externalVertexs;
+    const unsigned int* m_externalIndices;
+    std::shared_ptr<const void> m_storage;
+    size_t m_vertexCount;
+    size_t m_indexCount;
+    std::vector<MeshLod> m_lods;
+    std::unique_ptr<ImportStats> m_importStats;
     
     unsigned int m_VAO;
     unsigned int m_VBO;
     unsigned int m_EBO;
+    unsigned int m_positionVAO;
+    unsigned int m_positionVBO;
+    bool m_positionStream;
+
+    GeometryArena* m_arena;
+    ArenaRange m_arenaRange;
+
+    VertexFormat m_vertexFormat;
+    AABB m_quantization;
+    glm::vec3 m_positionScale;
+    glm::vec3 m_positionBias;
+    /// packed between decode and upload
+    std::vector<PackedVertex> m_packedVertexs;
+
+    AABB m_bounds;
+    BoundingSphere m_boundingSphere;
 
-    bool m_initialized;
+    std::atomic<RESIDENCY> m_residency;
+    std::atomic<size_t> m_decodeRemaining;
 };
 
 
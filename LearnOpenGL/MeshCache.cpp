@@ -0,0 +1,437 @@
+//
+//  MeshCache.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "MeshCache.h"
+#include "Hash.h"
+#include "System.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // file layout:
+    //   CacheHeader
+    //   CacheMesh[meshCount]
+    //   CacheTexture[textureCount]
+    //   string data, then vertex data, index data (all LODs) and LOD table of each mesh (8 byte aligned)
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t vertexSize;
+        uint32_t meshCount;
+        uint32_t textureCount;
+        uint32_t reserved;
+        uint64_t fileSize;
+    };
+
+    struct CacheMesh
+    {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t firstTexture;
+        uint32_t textureCount;
+        uint64_t lodOffset;
+        uint32_t lodCount;
+        uint32_t reserved;
+    };
+
+    struct CacheTexture
+    {
+        uint64_t typeOffset;
+        uint64_t pathOffset;
+        uint32_t typeLength;
+        uint32_t pathLength;
+    };
+
+    const char MAGIC[4] = {'L', 'G', 'M', 'C'};
+
+    uint64_t align8(uint64_t offset)
+    {
+        return (offset + 7) & ~uint64_t(7);
+    }
+
+    bool inRange(uint64_t offset, uint64_t length, uint64_t size)
+    {
+        return offset <= size && length <= size - offset;
+    }
+}
+
+MappedFile::MappedFile()
+    : m_data(nullptr), m_size(0)
+{
+#ifdef _WIN32
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    m_data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    m_data = (const unsigned char*)data;
+    m_size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle((HANDLE)m_mapping);
+    CloseHandle((HANDLE)m_file);
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = nullptr;
+#else
+    munmap((void*)m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+/// mix the contents of a file into hash, false when it can not be read
+static bool hashFile(const std::string& path, uint64_t& hash)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::vector<char> buffer(1 << 16);
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        hash = Hash::fnv1a64(buffer.data(), (size_t)file.gcount(), hash);
+    }
+    return true;
+}
+
+/// material libraries named by the mtllib lines of an obj file, relative to the directory of the obj
+static std::vector<std::string> materialLibraries(const std::string& path)
+{
+    std::vector<std::string> libraries;
+    std::filesystem::path source(path);
+    std::string extension = source.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (extension != ".obj")
+    {
+        return libraries;
+    }
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 7, "mtllib ") != 0)
+        {
+            continue;
+        }
+        size_t begin = line.find_first_not_of(" \t", 7);
+        size_t end = line.find_last_not_of(" \t\r");
+        if (begin != std::string::npos && end >= begin)
+        {
+            libraries.push_back((source.parent_path() / line.substr(begin, end - begin + 1)).string());
+        }
+    }
+    return libraries;
+}
+
+uint64_t MeshCache::sourceHash(const std::string& path, unsigned int importFlags)
+{
+    uint64_t hash = Hash::fnv1a64(&VERSION, sizeof(VERSION));
+    hash = Hash::fnv1a64(&importFlags, sizeof(importFlags), hash);
+    if (!hashFile(path, hash))
+    {
+        return 0;
+    }
+
+    // the materials end up in the cache too, a changed or missing .mtl changes the key
+    for (const std::string& library : materialLibraries(path))
+    {
+        uint8_t found = hashFile(library, hash) ? 1 : 0;
+        hash = Hash::fnv1a64(&found, sizeof(found), hash);
+    }
+    return hash;
+}
+
+std::string MeshCache::cachePath(const std::string& path)
+{
+    // the source path is part of the name so models with the same file name do not collide
+    uint64_t pathHash = Hash::fnv1a64(path.data(), path.size());
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "-%016llx.meshcache", (unsigned long long)pathHash);
+    std::string name = std::filesystem::path(path).stem().string() + suffix;
+    return System::cachePathWithFile("meshes/" + name);
+}
+
+bool MeshCache::load(const std::string& cacheFile, uint64_t sourceHash, const std::string& resourceDir, std::vector<std::unique_ptr<Mesh>>& meshes)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (sourceHash == 0 || !file->open(cacheFile))
+    {
+        return false;
+    }
+
+    const unsigned char* data = file->data();
+    uint64_t size = file->size();
+    if (size < sizeof(CacheHeader))
+    {
+        return false;
+    }
+
+    const CacheHeader* header = (const CacheHeader*)data;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+        header->sourceHash != sourceHash || header->vertexSize != sizeof(Vertex) || header->fileSize != size)
+    {
+        return false;
+    }
+
+    uint64_t tableSize = header->meshCount * sizeof(CacheMesh) + header->textureCount * sizeof(CacheTexture);
+    if (!inRange(sizeof(CacheHeader), tableSize, size))
+    {
+        return false;
+    }
+    const CacheMesh* cacheMeshes = (const CacheMesh*)(data + sizeof(CacheHeader));
+    const CacheTexture* cacheTextures = (const CacheTexture*)(cacheMeshes + header->meshCount);
+
+    // validate everything before handing out pointers into the mapping
+    for (uint32_t i = 0; i < header->textureCount; ++i)
+    {
+        const CacheTexture& texture = cacheTextures[i];
+        if (!inRange(texture.typeOffset, texture.typeLength, size) || !inRange(texture.pathOffset, texture.pathLength, size))
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->meshCount; ++i)
+    {
+        const CacheMesh& mesh = cacheMeshes[i];
+        if (!inRange(mesh.vertexOffset, (uint64_t)mesh.vertexCount * sizeof(Vertex), size) ||
+            !inRange(mesh.indexOffset, (uint64_t)mesh.indexCount * sizeof(unsigned int), size) ||
+            !inRange(mesh.lodOffset, (uint64_t)mesh.lodCount * sizeof(MeshLod), size) ||
+            (uint64_t)mesh.firstTexture + mesh.textureCount > header->textureCount)
+        {
+            return false;
+        }
+        const MeshLod* lods = (const MeshLod*)(data + mesh.lodOffset);
+        for (uint32_t l = 0; l < mesh.lodCount; ++l)
+        {
+            if ((uint64_t)lods[l].firstIndex + lods[l].indexCount > mesh.indexCount)
+            {
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < header->meshCount; ++i)
+    {
+        const CacheMesh& mesh = cacheMeshes[i];
+        std::vector<Texture> textures(mesh.textureCount);
+        for (uint32_t t = 0; t < mesh.textureCount; ++t)
+        {
+            const CacheTexture& texture = cacheTextures[mesh.firstTexture + t];
+            textures[t].id = 0;
+            textures[t].type.assign((const char*)data + texture.typeOffset, texture.typeLength);
+            textures[t].path = resourceDir + std::string((const char*)data + texture.pathOffset, texture.pathLength);
+        }
+        const MeshLod* lods = (const MeshLod*)(data + mesh.lodOffset);
+        meshes.push_back(std::make_unique<Mesh>((const Vertex*)(data + mesh.vertexOffset), mesh.vertexCount,
+                                                (const unsigned int*)(data + mesh.indexOffset), mesh.indexCount,
+                                                std::move(textures), file, std::vector<MeshLod>(lods, lods + mesh.lodCount)));
+    }
+    return true;
+}
+
+bool MeshCache::save(const std::string& cacheFile, uint64_t sourceHash, const std::string& resourceDir, const std::vector<std::unique_ptr<Mesh>>& meshes)
+{
+    if (sourceHash == 0)
+    {
+        return false;
+    }
+
+    CacheHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceHash = sourceHash;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = (uint32_t)meshes.size();
+
+    // texture paths are stored relative to the model directory
+    std::vector<CacheMesh> cacheMeshes(meshes.size());
+    std::vector<CacheTexture> cacheTextures;
+    std::vector<std::pair<std::string, std::string>> textureStrings;
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        cacheMeshes[i].firstTexture = (uint32_t)cacheTextures.size();
+        cacheMeshes[i].textureCount = (uint32_t)meshes[i]->textures().size();
+        for (const Texture& texture : meshes[i]->textures())
+        {
+            std::string path = texture.path;
+            if (path.compare(0, resourceDir.size(), resourceDir) == 0)
+            {
+                path = path.substr(resourceDir.size());
+            }
+            textureStrings.emplace_back(texture.type, path);
+            cacheTextures.push_back(CacheTexture());
+        }
+    }
+    header.textureCount = (uint32_t)cacheTextures.size();
+
+    uint64_t offset = sizeof(CacheHeader) + cacheMeshes.size() * sizeof(CacheMesh) + cacheTextures.size() * sizeof(CacheTexture);
+    for (size_t i = 0; i < cacheTextures.size(); ++i)
+    {
+        cacheTextures[i].typeOffset = offset;
+        cacheTextures[i].typeLength = (uint32_t)textureStrings[i].first.size();
+        offset += cacheTextures[i].typeLength;
+        cacheTextures[i].pathOffset = offset;
+        cacheTextures[i].pathLength = (uint32_t)textureStrings[i].second.size();
+        offset += cacheTextures[i].pathLength;
+    }
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        offset = align8(offset);
+        cacheMeshes[i].vertexOffset = offset;
+        cacheMeshes[i].vertexCount = (uint32_t)meshes[i]->vertexCount();
+        offset += meshes[i]->vertexCount() * sizeof(Vertex);
+        offset = align8(offset);
+        cacheMeshes[i].indexOffset = offset;
+        cacheMeshes[i].indexCount = (uint32_t)meshes[i]->indexCount();
+        offset += meshes[i]->indexCount() * sizeof(unsigned int);
+        offset = align8(offset);
+        cacheMeshes[i].lodOffset = offset;
+        cacheMeshes[i].lodCount = (uint32_t)meshes[i]->lods().size();
+        offset += meshes[i]->lods().size() * sizeof(MeshLod);
+    }
+    header.fileSize = offset;
+
+    std::filesystem::path path(cacheFile);
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    // write to a temporary file and rename, so a concurrent or interrupted run never maps a half written cache
+    std::string tempFile = cacheFile + ".tmp";
+    {
+        std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "Failed to write mesh cache " << cacheFile << std::endl;
+            return false;
+        }
+
+        uint64_t written = 0;
+        auto write = [&file, &written](const void* data, uint64_t length) {
+            file.write((const char*)data, (std::streamsize)length);
+            written += length;
+        };
+        auto pad = [&write, &written]() {
+            static const char zeros[8] = {};
+            write(zeros, align8(written) - written);
+        };
+
+        write(&header, sizeof(header));
+        write(cacheMeshes.data(), cacheMeshes.size() * sizeof(CacheMesh));
+        write(cacheTextures.data(), cacheTextures.size() * sizeof(CacheTexture));
+        for (const auto& strings : textureStrings)
+        {
+            write(strings.first.data(), strings.first.size());
+            write(strings.second.data(), strings.second.size());
+        }
+        for (const std::unique_ptr<Mesh>& mesh : meshes)
+        {
+            pad();
+            write(mesh->vertices(), mesh->vertexCount() * sizeof(Vertex));
+            pad();
+            write(mesh->indices(), mesh->indexCount() * sizeof(unsigned int));
+            pad();
+            write(mesh->lods().data(), mesh->lods().size() * sizeof(MeshLod));
+        }
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempFile, cacheFile, error);
+    if (error)
+    {
+        std::filesystem::remove(tempFile, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+//
+//  MeshCache.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef MeshCache_h
+#define MeshCache_h
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+/// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+};
+
+/// binary cache of the processed vertex/index/LOD/texture data of a model.
+/// the file is versioned and keyed by the hash of the source file and its materials, a warm load maps it
+/// and hands the vertex and index arrays to the meshes without parsing or copying
+namespace MeshCache
+{
+    /// bump when the layout of the cache or of Vertex changes, or when import processing changes its output
+    const uint32_t VERSION = 3;
+
+    /// hash of the source model file and of the material libraries it names, mixed with the cache version and import flags
+    uint64_t sourceHash(const std::string& path, unsigned int importFlags);
+
+    /// cache file location of a source model
+    std::string cachePath(const std::string& path);
+
+    /// map the cache and append its meshes, returns false when missing or stale
+    bool load(const std::string& cacheFile, uint64_t sourceHash, const std::string& resourceDir, std::vector<std::unique_ptr<Mesh>>& meshes);
+
+    bool save(const std::string& cacheFile, uint64_t sourceHash, const std::string& resourceDir, const std::vector<std::unique_ptr<Mesh>>& meshes);
+}
+
+#endif /* MeshCache_h */
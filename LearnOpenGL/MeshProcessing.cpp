@@ -0,0 +1,682 @@
+//
+//  MeshProcessing.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "MeshProcessing.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    /// hash and equality of the bytes of whatever a key points at
+    template <typename T>
+    struct BitwiseKey
+    {
+        const T* value;
+
+        bool operator==(const BitwiseKey& other) const { return memcmp(value, other.value, sizeof(T)) == 0; }
+    };
+
+    template <typename T>
+    struct BitwiseHash
+    {
+        size_t operator()(const BitwiseKey<T>& key) const { return (size_t)Hash::fnv1a64(key.value, sizeof(T)); }
+    };
+
+    /// sum of squared distances to a set of planes, weighted by triangle area
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+
+        void addPlane(const glm::dvec3& normal, double distance, double planeWeight)
+        {
+            a00 += planeWeight * normal.x * normal.x;
+            a01 += planeWeight * normal.x * normal.y;
+            a02 += planeWeight * normal.x * normal.z;
+            a11 += planeWeight * normal.y * normal.y;
+            a12 += planeWeight * normal.y * normal.z;
+            a22 += planeWeight * normal.z * normal.z;
+            b0 += planeWeight * normal.x * distance;
+            b1 += planeWeight * normal.y * distance;
+            b2 += planeWeight * normal.z * distance;
+            c += planeWeight * distance * distance;
+            weight += planeWeight;
+        }
+
+        void add(const Quadric& other)
+        {
+            a00 += other.a00;
+            a01 += other.a01;
+            a02 += other.a02;
+            a11 += other.a11;
+            a12 += other.a12;
+            a22 += other.a22;
+            b0 += other.b0;
+            b1 += other.b1;
+            b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+        }
+
+        /// mean squared distance of p to the planes
+        double error(const glm::vec3& point) const
+        {
+            double x = point.x, y = point.y, z = point.z;
+            double sum = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                         2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    /// smallest LOD worth a separate range, in triangles
+    const size_t MIN_LOD_TRIANGLES = 32;
+    /// a LOD must drop at least this share of the triangles of the previous one
+    const float MIN_LOD_REDUCTION = 0.15f;
+    /// largest surface deviation a LOD may have, relative to the size of the mesh
+    const float MAX_LOD_ERROR = 0.05f;
+    /// overdraw clusters may be split where their ACMR stays within this factor of the whole cluster
+    const float OVERDRAW_THRESHOLD = 1.05f;
+
+    /// fifo post-transform cache, a vertex stays cached until cacheSize other vertices were missed after it
+    class VertexCache
+    {
+    public:
+        VertexCache(size_t vertexCount, size_t cacheSize)
+            : m_timestamps(vertexCount, 0), m_time(cacheSize + 1), m_size(cacheSize)
+        {
+        }
+
+        /// vertex shader runs the triangle causes, 0 to 3
+        unsigned int add(const unsigned int* triangle)
+        {
+            return add(triangle[0]) + add(triangle[1]) + add(triangle[2]);
+        }
+
+        unsigned int add(unsigned int vertex)
+        {
+            if (contains(vertex))
+            {
+                return 0;
+            }
+            m_timestamps[vertex] = m_time++;
+            return 1;
+        }
+
+        bool contains(unsigned int vertex) const { return m_time - m_timestamps[vertex] <= m_size; }
+
+        /// how long ago the vertex entered the cache, in misses
+        size_t age(unsigned int vertex) const { return m_time - m_timestamps[vertex]; }
+
+        /// start over with nothing cached
+        void flush() { m_time += m_size + 1; }
+
+    private:
+        std::vector<size_t> m_timestamps;
+        size_t m_time;
+        size_t m_size;
+    };
+}
+
+void MeshProcessing::weld(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<Vertex> unique;
+    std::vector<unsigned int> remap(vertices.size());
+    unique.reserve(vertices.size());
+
+    // keys point into vertices, which is left alone until the end
+    std::unordered_map<BitwiseKey<Vertex>, unsigned int, BitwiseHash<Vertex>> known;
+    known.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        auto inserted = known.emplace(BitwiseKey<Vertex>{&vertices[i]}, (unsigned int)unique.size());
+        if (inserted.second)
+        {
+            unique.push_back(vertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    for (unsigned int& index : indices)
+    {
+        index = remap[index];
+    }
+    vertices.swap(unique);
+}
+
+std::vector<unsigned int> MeshProcessing::simplify(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                                                   size_t targetIndexCount, float maxError, float* error)
+{
+    std::vector<unsigned int> result(indices, indices + indexCount);
+    if (error)
+    {
+        *error = 0.f;
+    }
+
+    // corners of different uv or normal at one spot share a position, the quadrics live on positions
+    std::vector<unsigned int> positionOf(vertexCount);
+    std::vector<unsigned int> wedges(vertexCount, 0);
+    {
+        std::unordered_map<BitwiseKey<glm::vec3>, unsigned int, BitwiseHash<glm::vec3>> known;
+        known.reserve(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            positionOf[i] = known.emplace(BitwiseKey<glm::vec3>{&vertices[i].position}, (unsigned int)i).first->second;
+            wedges[positionOf[i]]++;
+        }
+    }
+
+    // positions on a seam, an open border or a non-manifold edge never move
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        if (wedges[positionOf[i]] > 1)
+        {
+            locked[positionOf[i]] = 1;
+        }
+    }
+    {
+        std::unordered_map<uint64_t, int> edgeUses;
+        edgeUses.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                uint64_t a = positionOf[result[i + e]];
+                uint64_t b = positionOf[result[i + (e + 1) % 3]];
+                edgeUses[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+            }
+        }
+        for (const auto& edge : edgeUses)
+        {
+            if (edge.second != 2)
+            {
+                locked[edge.first >> 32] = 1;
+                locked[edge.first & 0xFFFFFFFFu] = 1;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        glm::dvec3 p0 = vertices[result[i]].position;
+        glm::dvec3 p1 = vertices[result[i + 1]].position;
+        glm::dvec3 p2 = vertices[result[i + 2]].position;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0.0)
+        {
+            continue;
+        }
+        normal /= length;
+        double distance = -glm::dot(normal, p0);
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            quadrics[positionOf[result[i + corner]]].addPlane(normal, distance, length * 0.5);
+        }
+    }
+
+    double maxCost = (double)maxError * maxError;
+    double worstCost = 0.0;
+    std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+    std::vector<unsigned int> vertexTriangles;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<Collapse> collapses;
+
+    // independent collapses per pass, the vertex to triangle lists are rebuilt between passes
+    while (result.size() > targetIndexCount)
+    {
+        size_t triangleCount = result.size() / 3;
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (unsigned int index : result)
+        {
+            triangleOffsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        }
+        vertexTriangles.resize(result.size());
+        std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            vertexTriangles[fill[result[i]]++] = (unsigned int)(i / 3);
+        }
+
+        // every interior edge shows up in two triangles, once each way round
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                unsigned int a = result[i + e];
+                unsigned int b = result[i + (e + 1) % 3];
+                if (a >= b)
+                {
+                    continue;
+                }
+                Quadric merged = quadrics[positionOf[a]];
+                merged.add(quadrics[positionOf[b]]);
+                Collapse best = {a, b, -1.0};
+                if (!locked[positionOf[a]])
+                {
+                    best.cost = merged.error(vertices[b].position);
+                }
+                if (!locked[positionOf[b]])
+                {
+                    double cost = merged.error(vertices[a].position);
+                    if (best.cost < 0.0 || cost < best.cost)
+                    {
+                        best = {b, a, cost};
+                    }
+                }
+                if (best.cost >= 0.0 && best.cost <= maxCost)
+                {
+                    collapses.push_back(best);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            remap[i] = (unsigned int)i;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removed = 0;
+        size_t applied = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+
+            // moving from onto to must not turn any of the remaining triangles around
+            const glm::vec3& target = vertices[collapse.to].position;
+            bool flips = false;
+            size_t dropped = 0;
+            for (unsigned int t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; ++t)
+            {
+                const unsigned int* triangle = &result[vertexTriangles[t] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    dropped++;
+                    continue;
+                }
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    before[corner] = vertices[triangle[corner]].position;
+                    after[corner] = triangle[corner] == collapse.from ? target : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.f;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[positionOf[collapse.to]].add(quadrics[positionOf[collapse.from]]);
+            worstCost = std::max(worstCost, collapse.cost);
+            for (unsigned int t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; ++t)
+            {
+                const unsigned int* triangle = &result[vertexTriangles[t] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            removed += dropped;
+            applied++;
+            if ((triangleCount - removed) * 3 <= targetIndexCount)
+            {
+                break;
+            }
+        }
+        if (applied == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]];
+            unsigned int b = remap[result[i + 1]];
+            unsigned int c = remap[result[i + 2]];
+            if (a == b || b == c || c == a)
+            {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (error)
+    {
+        *error = (float)std::sqrt(worstCost);
+    }
+    return result;
+}
+
+std::vector<MeshLod> MeshProcessing::buildLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t maxLods)
+{
+    std::vector<MeshLod> lods;
+    lods.push_back({0, (uint32_t)indices.size(), 0.f});
+
+    AABB bounds = AABB::fromPoints(vertices.empty() ? nullptr : &vertices[0].position, vertices.size(), sizeof(Vertex));
+    float maxError = MAX_LOD_ERROR * glm::length(bounds.max - bounds.min);
+
+    std::vector<unsigned int> source(indices);
+    float error = 0.f;
+    while (lods.size() < maxLods)
+    {
+        size_t target = source.size() / 6 * 3;
+        if (target / 3 < MIN_LOD_TRIANGLES)
+        {
+            break;
+        }
+        float lodError = 0.f;
+        std::vector<unsigned int> lod = simplify(vertices.data(), vertices.size(), source.data(), source.size(), target, maxError, &lodError);
+        if (lod.empty() || lod.size() > source.size() * (1.f - MIN_LOD_REDUCTION))
+        {
+            break;
+        }
+
+        // each LOD is simplified from the previous one, so the deviations from LOD 0 add up
+        error += lodError;
+        lods.push_back({(uint32_t)indices.size(), (uint32_t)lod.size(), error});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        source.swap(lod);
+    }
+    return lods;
+}
+
+float MeshProcessing::vertexCacheMissRatio(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return 0.f;
+    }
+    VertexCache cache(vertexCount, cacheSize);
+    size_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; i += 3)
+    {
+        misses += cache.add(indices + i);
+    }
+    return (float)misses / (float)triangleCount;
+}
+
+void MeshProcessing::optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, std::vector<size_t>* clusters)
+{
+    if (clusters)
+    {
+        clusters->clear();
+    }
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // triangles around each vertex
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    // triangles around each vertex not emitted yet
+    std::vector<unsigned int> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        live[v] = offsets[v + 1] - offsets[v];
+    }
+
+    VertexCache cache(vertexCount, VERTEX_CACHE_SIZE);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnds;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    deadEnds.reserve(triangleCount * 3);
+    result.reserve(triangleCount * 3);
+
+    // a vertex that still has triangles: the most recent dead end, otherwise the next in input order
+    size_t cursor = 0;
+    auto skipDeadEnd = [&]() -> long long {
+        while (!deadEnds.empty())
+        {
+            unsigned int vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[vertex] > 0)
+            {
+                return vertex;
+            }
+        }
+        for (; cursor < vertexCount; ++cursor)
+        {
+            if (live[cursor] > 0)
+            {
+                return (long long)cursor;
+            }
+        }
+        return -1;
+    };
+
+    long long fanning = skipDeadEnd();
+    bool restarted = true;
+    while (fanning >= 0)
+    {
+        if (restarted && clusters)
+        {
+            clusters->push_back(result.size() / 3);
+        }
+
+        // emit the whole fan around the vertex
+        candidates.clear();
+        for (unsigned int j = offsets[fanning]; j < offsets[fanning + 1]; ++j)
+        {
+            unsigned int triangle = adjacency[j];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = 1;
+            for (size_t k = 0; k < 3; ++k)
+            {
+                unsigned int vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                cache.add(vertex);
+            }
+        }
+
+        // fan next around the vertex of this fan that is oldest in the cache but will still be cached
+        // once its remaining triangles are emitted
+        long long next = -1;
+        long long bestPriority = -1;
+        for (unsigned int vertex : candidates)
+        {
+            if (live[vertex] == 0)
+            {
+                continue;
+            }
+            long long priority = 0;
+            if (cache.age(vertex) + 2 * live[vertex] <= VERTEX_CACHE_SIZE)
+            {
+                priority = (long long)cache.age(vertex);
+            }
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+        restarted = next < 0;
+        fanning = restarted ? skipDeadEnd() : next;
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshProcessing::optimizeOverdraw(const Vertex* vertices, unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                      const std::vector<size_t>& clusters, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || clusters.empty())
+    {
+        return;
+    }
+
+    // split the runs where the part before the split already reuses the cache about as well as the whole run,
+    // smaller clusters sort better and cost little extra vertex work
+    std::vector<size_t> starts;
+    VertexCache cache(vertexCount, VERTEX_CACHE_SIZE);
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        size_t begin = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        cache.flush();
+        size_t misses = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            misses += cache.add(indices + t * 3);
+        }
+        float limit = threshold * (float)misses / (float)(end - begin);
+
+        cache.flush();
+        starts.push_back(begin);
+        size_t start = begin;
+        size_t runMisses = 0;
+        for (size_t t = begin; t + 1 < end; ++t)
+        {
+            runMisses += cache.add(indices + t * 3);
+            if ((float)runMisses <= limit * (float)(t + 1 - start))
+            {
+                start = t + 1;
+                starts.push_back(start);
+                runMisses = 0;
+                cache.flush();
+            }
+        }
+    }
+    starts.push_back(triangleCount);
+
+    // area weighted centroid and normal of the mesh and of every cluster
+    size_t clusterCount = starts.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.f));
+    std::vector<float> areas(clusterCount, 0.f);
+    glm::vec3 meshCentroid(0.f);
+    float meshArea = 0.f;
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        for (size_t t = starts[c]; t < starts[c + 1]; ++t)
+        {
+            const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            centroids[c] += (a + b + d) * (area / 3.f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.f)
+        {
+            centroids[c] /= areas[c];
+        }
+    }
+    if (meshArea > 0.f)
+    {
+        meshCentroid /= meshArea;
+    }
+
+    // clusters far out along their own normal occlude the rest of the mesh from most directions (Sander et al. 2007)
+    std::vector<float> keys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    for (size_t c : order)
+    {
+        result.insert(result.end(), indices + starts[c] * 3, indices + starts[c + 1] * 3);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshProcessing::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+void MeshProcessing::optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<MeshLod>& lods)
+{
+    std::vector<size_t> clusters;
+    for (const MeshLod& lod : lods)
+    {
+        unsigned int* range = indices.data() + lod.firstIndex;
+        optimizeVertexCache(range, lod.indexCount, vertices.size(), &clusters);
+        optimizeOverdraw(vertices.data(), range, lod.indexCount, vertices.size(), clusters, OVERDRAW_THRESHOLD);
+    }
+    // LOD 0 goes first so its vertices are fetched in order, the coarser LODs use a subset of them
+    optimizeVertexFetch(vertices, indices);
+}
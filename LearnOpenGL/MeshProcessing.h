@@ -0,0 +1,59 @@
+//
+//  MeshProcessing.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef MeshProcessing_h
+#define MeshProcessing_h
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+/// offline processing of imported geometry, run at import time before the mesh cache is written
+namespace MeshProcessing
+{
+    /// merge bitwise identical vertices and rewrite indices to match. importers emit one vertex per
+    /// triangle corner, the simplifier needs the corners joined to see the connectivity
+    void weld(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    /// quadric error metric edge collapse (Garland & Heckbert) towards targetIndexCount indices,
+    /// stopping early when the next collapse would move the surface more than maxError.
+    /// vertices only ever collapse onto other existing vertices, so the result is a new index list
+    /// over the same vertex buffer. vertices on open borders or attribute seams (uv, normal) are kept.
+    /// error receives how far the result may deviate from the input, in object space units
+    std::vector<unsigned int> simplify(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                                       size_t targetIndexCount, float maxError, float* error);
+
+    /// LOD 0 is the full index list, each further LOD roughly halves the triangles of the previous one
+    /// until maxLods or until the simplifier stops making progress. the LOD index lists are appended
+    /// to indices and described by the returned ranges
+    std::vector<MeshLod> buildLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t maxLods);
+
+    /// entries of the post-transform vertex cache the orderings are tuned for and measured with
+    const size_t VERTEX_CACHE_SIZE = 16;
+
+    /// vertex shader runs per triangle (ACMR) with a fifo post-transform cache of cacheSize vertices,
+    /// 3 without any reuse, around 0.6 for a well ordered regular mesh
+    float vertexCacheMissRatio(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t cacheSize = VERTEX_CACHE_SIZE);
+
+    /// reorder the triangles for the post-transform cache (Tipsify, Sander et al. 2007).
+    /// clusters receives the first triangle of every run that started at a dead end, the order
+    /// within a run matters for the cache but runs can be moved around freely
+    void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, std::vector<size_t>* clusters);
+
+    /// reorder the clusters of optimizeVertexCache() so those facing away from the centre are drawn first and
+    /// occlude the rest. clusters are split further where that keeps their ACMR within threshold of the whole cluster
+    void optimizeOverdraw(const Vertex* vertices, unsigned int* indices, size_t indexCount, size_t vertexCount,
+                          const std::vector<size_t>& clusters, float threshold);
+
+    /// put the vertices in the order the indices first use them and drop unused ones, the indices are rewritten to match
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    /// cache and overdraw order for the triangles of every LOD, then vertex fetch order for all of them
+    void optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<MeshLod>& lods);
+}
+
+#endif /* MeshProcessing_h */
@@ -6,17 +6,28 @@
 //
 
 #include "Model.h"
+#include "GLState.h"
+#include "MeshCache.h"
+#include "MeshProcessing.h"
 #include "System.hpp"
 
+static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+/// LOD 0 included
+static const size_t MAX_LODS = 4;
+
+/// share of the LOD pixel error a coarser LOD must stay under before it is switched to
+static const float LOD_HYSTERESIS = 0.75f;
+
 Model::Model()
 {
-    m_loadFinished = false;
+    m_imported = false;
     m_position = glm::vec3(0.f, 0.f, 0.f);
 }
 
 Model::Model(const std::string& file)
 {
-    m_loadFinished = false;
+    m_imported = false;
     m_path = System::resourcePathWithFile(file);
     m_resource = m_path.substr(0, m_path.find_last_of('/') + 1);
     m_position = glm::vec3(0.f, 0.f, 0.f);
@@ -27,32 +38,453 @@ Model::~Model()
     
 }
 
-void Model::init()
+void Model::import()
 {
-    m_loadFinished = false;
+    if (isImported())
+    {
+        return;
+    }
     loadModel(m_path);
-    m_loadFinished = true;
+    for (const std::unique_ptr<Mesh>& mesh : m_meshes)
+    {
+        mesh->setArena(m_arena.get());
+        mesh->setPositionStream(m_positionStream);
+    }
+    if (m_compactVertices)
+    {
+        // one box for the whole model keeps its meshes on the same position decode, so they still share multi-draws
+        AABB box = AABB::empty();
+        for (const std::unique_ptr<Mesh>& mesh : m_meshes)
+        {
+            box.expand(mesh->bounds());
+        }
+        for (const std::unique_ptr<Mesh>& mesh : m_meshes)
+        {
+            mesh->setPackedVertices(box);
+        }
+    }
+    m_imported.store(true, std::memory_order_release);
+}
+
+void Model::addMesh(std::unique_ptr<Mesh> mesh)
+{
+    mesh->setArena(m_arena.get());
+    mesh->setPositionStream(m_positionStream);
+    m_meshes.push_back(std::move(mesh));
+    m_imported.store(true, std::memory_order_release);
+}
+
+void Model::init()
+{
+    import();
+    for (size_t i = 0; i < m_meshes.size(); i++)
+    {
+        m_meshes[i]->init();
+    }
 }
 
 void Model::draw(Program* program)
 {
     if (program == nullptr) return;
 
-    if (m_loadFinished)
+    ViewState& state = viewState(0);
+    state.visible.assign(meshCount(), 1);
+    state.lodLevels.assign(meshCount(), 0);
+    submit(program, state, false);
+}
+
+void Model::draw(Program* program, const DrawView& view, const glm::mat4& transform)
+{
+    if (program == nullptr) return;
+
+    select(view, transform);
+    submit(program, viewState(view.slot), false);
+}
+
+void Model::drawDepth(Program* program, unsigned int slot)
+{
+    if (program == nullptr) return;
+
+    ViewState& state = viewState(slot);
+    state.visible.assign(meshCount(), 1);
+    state.lodLevels.assign(meshCount(), 0);
+    submit(program, state, true);
+}
+
+void Model::drawDepth(Program* program, const DrawView& view, const glm::mat4& transform)
+{
+    if (program == nullptr) return;
+
+    select(view, transform);
+    submit(program, viewState(view.slot), true);
+}
+
+void Model::drawDepthLayers(Program* program, const DrawView* views, size_t count, const glm::mat4& transform)
+{
+    static constexpr UniformName layers("layers");
+
+    m_depthDrawCalls = 0;
+    m_depthTriangles = 0;
+    size_t meshes = meshCount();
+    if (program == nullptr || count == 0 || meshes == 0)
+    {
+        return;
+    }
+    count = std::min(count, (size_t)8);
+
+    // the layers every mesh goes to, 4 bits each in instance order, and the finest LOD they ask for
+    ViewState& state = viewState(views[0].slot);
+    state.visible.assign(meshes, 0);
+    state.lodLevels.resize(meshes, 0);
+    std::vector<int> layerList(meshes, 0);
+    std::vector<uint8_t> layerCount(meshes, 0);
+    std::vector<uint8_t> lods(meshes, UINT8_MAX);
+    std::vector<uint8_t> visible(meshes);
+    updateWorldBounds(transform);
+    for (size_t layer = 0; layer < count; layer++)
+    {
+        const DrawView& view = views[layer];
+        if (!view.frustum.intersects(m_worldSphere) || view.frustum.intersects(m_worldBoxes, visible.data()) == 0)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < meshes; i++)
+        {
+            if (visible[i] && m_meshes[i]->isResident())
+            {
+                layerList[i] |= (int)layer << (4 * layerCount[i]++);
+                lods[i] = std::min(lods[i], (uint8_t)selectLod(*m_meshes[i], m_worldSpheres[i], view, state.lodLevels[i]));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < meshes; i++)
+    {
+        if (layerCount[i] == 0)
+        {
+            continue;
+        }
+        state.visible[i] = 1;
+        state.lodLevels[i] = lods[i];
+        program->setUniform1i(layers, layerList[i]);
+        m_meshes[i]->drawDepth(program, lods[i], layerCount[i]);
+        m_depthDrawCalls++;
+        m_depthTriangles += (int)(m_meshes[i]->lods()[lods[i]].indexCount / 3) * layerCount[i];
+    }
+}
+
+Model::ViewState& Model::viewState(unsigned int slot)
+{
+    if (slot >= m_views.size())
+    {
+        m_views.resize(slot + 1);
+    }
+    if (!m_views[slot])
+    {
+        m_views[slot] = std::make_unique<ViewState>();
+    }
+    return *m_views[slot];
+}
+
+void Model::select(const DrawView& view, const glm::mat4& transform)
+{
+    ViewState& state = viewState(view.slot);
+    size_t count = meshCount();
+    state.visible.assign(count, 0);
+    state.lodLevels.resize(count, 0);
+    if (count > 0)
+    {
+        updateWorldBounds(transform);
+        if (view.frustum.intersects(m_worldSphere))
+        {
+            view.frustum.intersects(m_worldBoxes, state.visible.data());
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            if (state.visible[i])
+            {
+                state.lodLevels[i] = (uint8_t)selectLod(*m_meshes[i], m_worldSpheres[i], view, state.lodLevels[i]);
+            }
+        }
+    }
+}
+
+size_t Model::selectLod(const Mesh& mesh, const BoundingSphere& sphere, const DrawView& view, size_t current) const
+{
+    const std::vector<MeshLod>& lods = mesh.lods();
+    // nearest point of the mesh, a camera inside it gets LOD 0
+    float distance = std::max(glm::length(sphere.center - view.eye) - sphere.radius, 1e-3f);
+    auto pixelError = [&](size_t lod) {
+        return lods[lod].error * m_boundsScale * view.pixelsPerUnit / distance;
+    };
+
+    size_t lod = std::min(current, lods.size() - 1);
+    while (lod > 0 && pixelError(lod) > view.maxPixelError)
+    {
+        lod--;
+    }
+    while (lod + 1 < lods.size() && pixelError(lod + 1) <= view.maxPixelError * LOD_HYSTERESIS)
+    {
+        lod++;
+    }
+    return lod;
+}
+
+void Model::submit(Program* program, ViewState& state, bool depthOnly)
+{
+    // the color counters describe the last color draw, a depth pass in between leaves them alone
+    int drawCalls = 0;
+    int drawnMeshes = 0;
+    int culledMeshes = 0;
+    int drawnTriangles = 0;
+    // sized by meshCount(), empty until the model is imported
+    size_t count = state.visible.size();
+    std::vector<uint8_t> drawable(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!m_meshes[i]->isResident())
+        {
+            continue;
+        }
+        if (state.visible[i])
+        {
+            drawable[i] = state.lodLevels[i] + 1;
+            drawnMeshes++;
+            drawnTriangles += m_meshes[i]->lods()[state.lodLevels[i]].indexCount / 3;
+        }
+        else
+        {
+            culledMeshes++;
+        }
+    }
+
+    if (m_arena && count > 0)
+    {
+        BatchList& list = depthOnly ? state.depthBatches : state.colorBatches;
+        if (drawable != list.batched)
+        {
+            buildBatches(drawable, depthOnly, list);
+        }
+
+        for (const DrawBatch& batch : list.batches)
+        {
+            GLState::bindVertexArray(batch.vertexArray);
+            if (!depthOnly)
+            {
+                batch.material->bindMaterial(program);
+            }
+            batch.material->bindVertexDecode(program);
+            list.multiDraw.draw(batch.first, batch.count);
+            drawCalls++;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!drawable[i])
+            {
+                continue;
+            }
+            if (depthOnly)
+            {
+                m_meshes[i]->drawDepth(program, drawable[i] - 1);
+            }
+            else
+            {
+                m_meshes[i]->draw(program, drawable[i] - 1);
+            }
+            drawCalls++;
+        }
+    }
+
+    if (depthOnly)
+    {
+        m_depthDrawCalls = drawCalls;
+        m_depthTriangles = drawnTriangles;
+    }
+    else
+    {
+        m_drawCalls = drawCalls;
+        m_drawnMeshes = drawnMeshes;
+        m_culledMeshes = culledMeshes;
+        m_drawnTriangles = drawnTriangles;
+    }
+}
+
+void Model::updateWorldBounds(const glm::mat4& transform)
+{
+    if (m_boundsMeshes == m_meshes.size() && m_boundsTransform == transform)
+    {
+        return;
+    }
+    m_boundsMeshes = m_meshes.size();
+    m_boundsTransform = transform;
+
+    // the largest axis scale bounds how much the transform stretches radii and LOD errors
+    m_boundsScale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+    m_worldBoxes.clear();
+    m_worldSpheres.clear();
+    AABB all = AABB::empty();
+    for (const std::unique_ptr<Mesh>& mesh : m_meshes)
+    {
+        AABB box = mesh->bounds().transformed(transform);
+        m_worldBoxes.push_back(box);
+        all.expand(box);
+
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(transform * glm::vec4(mesh->boundingSphere().center, 1.f));
+        sphere.radius = mesh->boundingSphere().radius * m_boundsScale;
+        m_worldSpheres.push_back(sphere);
+    }
+    m_worldSphere.center = all.center();
+    m_worldSphere.radius = glm::length(all.extent());
+}
+
+void Model::drawInstanced(Program* program, const glm::mat4* transforms, size_t count)
+{
+    if (program == nullptr) return;
+
+    m_drawCalls = 0;
+    if (!isImported() || count == 0)
+    {
+        return;
+    }
+
+    m_instances.update(transforms, count);
+    for (const std::unique_ptr<Mesh>& mesh : m_meshes)
+    {
+        if (mesh->isResident())
+        {
+            mesh->drawInstanced(program, m_instances, (GLsizei)count);
+            m_drawCalls++;
+        }
+    }
+}
+
+void Model::buildBatches(const std::vector<uint8_t>& drawable, bool depthOnly, BatchList& list)
+{
+    // meshes drawing with the same textures share a batch, gl 4.1 has no per-draw texture selection.
+    // a multi-draw reads one vertex array and one position decode, so those have to match as well
+    auto sameBatch = [depthOnly](const Mesh& a, const Mesh& b) {
+        if (a.indexType() != b.indexType() || a.vertexFormat() != b.vertexFormat() || a.positionScale() != b.positionScale() ||
+            a.positionBias() != b.positionBias())
+        {
+            return false;
+        }
+        if (depthOnly)
+        {
+            return a.hasPositionStream() == b.hasPositionStream();
+        }
+        const std::vector<Texture>& first = a.textures();
+        const std::vector<Texture>& second = b.textures();
+        bool same = first.size() == second.size();
+        for (size_t i = 0; same && i < first.size(); ++i)
+        {
+            same = first[i].id == second[i].id && first[i].type == second[i].type;
+        }
+        return same;
+    };
+
+    std::vector<std::vector<size_t>> groups;
+    list.batched = drawable;
+    for (size_t i = 0; i < drawable.size(); i++)
     {
-        for (int i = 0; i < m_meshes.size(); i++)
+        if (!drawable[i])
         {
-            if (!m_meshes[i].isInitialized())
+            continue;
+        }
+
+        std::vector<size_t>* group = nullptr;
+        for (std::vector<size_t>& candidate : groups)
+        {
+            if (sameBatch(*m_meshes[candidate.front()], *m_meshes[i]))
             {
-                m_meshes[i].init();
+                group = &candidate;
+                break;
             }
-            m_meshes[i].draw(program);
+        }
+        if (group == nullptr)
+        {
+            groups.emplace_back();
+            group = &groups.back();
+        }
+        group->push_back(i);
+    }
+
+    list.multiDraw.clear();
+    list.multiDraw.setIndirect(m_multiDrawIndirect);
+    list.batches.clear();
+    for (const std::vector<size_t>& group : groups)
+    {
+        DrawBatch batch;
+        batch.material = m_meshes[group.front()].get();
+        bool positions = depthOnly && batch.material->hasPositionStream();
+        batch.vertexArray = positions ? m_arena->positionArray(batch.material->vertexFormat(), batch.material->indexType())
+                                      : m_arena->vertexArray(batch.material->vertexFormat(), batch.material->indexType());
+        batch.first = list.multiDraw.size();
+        batch.count = group.size();
+        for (size_t i : group)
+        {
+            list.multiDraw.add(positions ? m_meshes[i]->positionRange(drawable[i] - 1) : m_meshes[i]->arenaRange(drawable[i] - 1));
+        }
+        list.batches.push_back(batch);
+    }
+    list.multiDraw.finish();
+}
+
+size_t Model::vertexBytes() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < meshCount(); ++i)
+    {
+        if (m_meshes[i]->isResident())
+        {
+            const Mesh& mesh = *m_meshes[i];
+            bytes += mesh.vertexCount() * Mesh::vertexSize(mesh.vertexFormat());
+            bytes += mesh.hasPositionStream() ? mesh.vertexCount() * Mesh::positionSize(mesh.vertexFormat()) : 0;
+        }
+    }
+    return bytes;
+}
+
+size_t Model::residentMeshes() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < meshCount(); ++i)
+    {
+        count += m_meshes[i]->isResident() ? 1 : 0;
+    }
+    return count;
+}
+
+bool Model::loadFinished() const
+{
+    if (!isImported())
+    {
+        return false;
+    }
+    for (const std::unique_ptr<Mesh>& mesh : m_meshes)
+    {
+        if (!mesh->isResident())
+        {
+            return false;
         }
     }
+    return true;
 }
 
 void Model::loadModel(const std::string& path)
 {
+    // warm start: map the processed meshes from the cache instead of running assimp
+    uint64_t sourceHash = MeshCache::sourceHash(path, IMPORT_FLAGS);
+    std::string cacheFile = MeshCache::cachePath(path);
+    if (m_scene == nullptr && MeshCache::load(cacheFile, sourceHash, m_resource, m_meshes))
+    {
+        return;
+    }
+
     if (m_importer == nullptr)
     {
         m_importer = std::make_shared<Assimp::Importer>();
@@ -60,7 +492,7 @@ void Model::loadModel(const std::string& path)
 
     if (m_scene == nullptr)
     {
-        m_scene = m_importer->ReadFile(path.data(), aiProcess_Triangulate | aiProcess_FlipUVs);
+        m_scene = m_importer->ReadFile(path.data(), IMPORT_FLAGS);
     }
     
     if (!m_scene || m_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !m_scene->mRootNode)
@@ -71,6 +503,7 @@ void Model::loadModel(const std::string& path)
     }
     
     processNode(m_scene->mRootNode, m_scene);
+    MeshCache::save(cacheFile, sourceHash, m_resource, m_meshes);
 }
 
 void Model::processNode(aiNode* pNode, const aiScene* pScene)
@@ -86,11 +519,13 @@ void Model::processNode(aiNode* pNode, const aiScene* pScene)
     }
 }
 
-Mesh Model::processMesh(aiMesh* pMesh, const aiScene* pScene)
+std::unique_ptr<Mesh> Model::processMesh(aiMesh* pMesh, const aiScene* pScene)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    vertices.reserve(pMesh->mNumVertices);
+    indices.reserve(pMesh->mNumFaces * 3);
     
     for (unsigned int i = 0; i < pMesh->mNumVertices; i++)
     {
@@ -147,7 +582,20 @@ Mesh Model::processMesh(aiMesh* pMesh, const aiScene* pScene)
         }
     }
     
-    Mesh mesh(vertices, indices, textures);
+    Mesh::ImportStats stats;
+    stats.name = pMesh->mName.length > 0 ? pMesh->mName.C_Str() : std::to_string(m_meshes.size());
+    stats.importedAcmr = MeshProcessing::vertexCacheMissRatio(indices.data(), indices.size(), vertices.size());
+
+    // importers give every corner its own vertex, joined the simplifier can walk the surface
+    MeshProcessing::weld(vertices, indices);
+    stats.weldedAcmr = MeshProcessing::vertexCacheMissRatio(indices.data(), indices.size(), vertices.size());
+    std::vector<MeshLod> lods = MeshProcessing::buildLods(vertices, indices, MAX_LODS);
+    MeshProcessing::optimize(vertices, indices, lods);
+    stats.optimizedAcmr = MeshProcessing::vertexCacheMissRatio(indices.data(), lods[0].indexCount, vertices.size());
+
+    // worker threads run this, the stats stay with the mesh for the report instead of going to the console
+    std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(std::move(vertices), std::move(indices), std::move(textures), std::move(lods));
+    mesh->setImportStats(std::move(stats));
     return mesh;
 }
 
@@ -158,24 +606,12 @@ std::vector<Texture> Model::loadMaterialTexture(aiMaterial* mat, aiTextureType t
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for(unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if(!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.type = typeName;
-            texture.path = m_resource + str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-        }
+        // files shared between meshes or models are deduplicated by the TextureManager
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = m_resource + str.C_Str();
+        textures.push_back(texture);
     }
     return textures;
 }
@@ -7,7 +7,9 @@
 
 #ifndef Model_h
 #define Model_h
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -15,6 +17,24 @@
 #include "Program.h"
 #include "Mesh.h"
 
+/// camera a model is culled against and picks its LODs for
+struct DrawView
+{
+    DrawView(const glm::mat4& view, const glm::mat4& project, const glm::vec3& eye, float viewportHeight, float maxPixelError, unsigned int slot = 0)
+        : frustum(project * view), eye(eye), pixelsPerUnit(0.5f * viewportHeight * project[1][1]), maxPixelError(maxPixelError), slot(slot)
+    {
+    }
+
+    Frustum frustum;
+    glm::vec3 eye;
+    /// pixels covered by one unit of length one unit in front of the camera
+    float pixelsPerUnit;
+    /// coarsest LOD whose error projects to at most this many pixels is drawn
+    float maxPixelError;
+    /// views drawn every frame (camera, shadow faces) keep their LODs and batches apart by slot, the main camera is 0
+    unsigned int slot;
+};
+
 class Model
 {
 public:
@@ -22,28 +42,175 @@ public:
     Model(const std::string& file);
     ~Model();
     
+    /// import the meshes from the cache or with assimp, safe to call from a worker thread
+    void import();
+
+    /// import, decode and upload everything at once, render thread only
     void init();
+
+    /// with a geometry arena the resident meshes go out as one multi-draw per material,
+    /// otherwise one draw per mesh
     void draw(Program* program);
+
+    /// draw only the meshes whose world space box, under transform, intersects the view frustum,
+    /// each at the LOD its distance to the camera allows. transform must be the model matrix the program draws with
+    void draw(Program* program, const DrawView& view, const glm::mat4& transform);
+
+    /// depth only versions of the draws above, for depth prepasses and shadow maps. meshes come from their position
+    /// stream without textures, and merge into multi-draws across materials. the view variant culls and picks LODs
+    /// the same way as draw() so a following draw() with the same view lands on exactly the same depth
+    /// without a view everything is drawn at LOD 0 and the state of slot is replaced, see DrawView::slot
+    void drawDepth(Program* program, unsigned int slot = 0);
+    void drawDepth(Program* program, const DrawView& view, const glm::mat4& transform);
+
+    /// depth into several layers of a layered framebuffer at once, one instanced draw per mesh. every mesh is culled
+    /// against each view and drawn once per view that sees it, instance i going to layer (layers >> 4 * i) & 15 of the
+    /// program's "layers" uniform, at the finest LOD those views ask for. at most 8 views, the layer of views[i] is i
+    void drawDepthLayers(Program* program, const DrawView* views, size_t count, const glm::mat4& transform);
+
+    /// draw one instance per transform with hardware instancing, one draw call per resident mesh.
+    /// the program must be an INSTANCED variant, it reads the transforms instead of the model uniform
+    void drawInstanced(Program* program, const glm::mat4* transforms, size_t count);
+    void drawInstanced(Program* program, const std::vector<glm::mat4>& transforms) { drawInstanced(program, transforms.data(), transforms.size()); }
     glm::vec3 getPosition() const { return m_position; }
     void setPosition(const glm::vec3& position) { m_position = position; }
-    bool loadFinished() { return m_loadFinished; };
+
+    /// the mesh list is known, meshes become drawable one by one as they get resident
+    bool isImported() const { return m_imported.load(std::memory_order_acquire); }
+
+    /// every mesh is resident on the gpu
+    bool loadFinished() const;
+
+    /// meshes resident on the gpu so far, the drawn geometry changes with it
+    size_t residentMeshes() const;
+
+    size_t meshCount() const { return isImported() ? m_meshes.size() : 0; }
+    Mesh* mesh(size_t index) { return m_meshes[index].get(); }
+
+    /// add generated geometry, the model counts as imported afterwards
+    void addMesh(std::unique_ptr<Mesh> mesh);
+
+    /// place the meshes in an arena, own or shared with other models. set before import or addMesh
+    void setGeometryArena(std::shared_ptr<GeometryArena> arena) { m_arena = std::move(arena); }
+    GeometryArena* geometryArena() const { return m_arena.get(); }
+
+    /// keep imported meshes as PackedVertex on the gpu, quantized inside the bounds of the model. set before import
+    void setCompactVertices(bool compact) { m_compactVertices = compact; }
+
+    /// give the meshes a position stream for drawDepth(), set before import or addMesh
+    void setPositionStream(bool positionStream) { m_positionStream = positionStream; }
+
+    /// submit the arena batches with glMultiDrawElementsIndirect where available instead of
+    /// glMultiDrawElementsBaseVertex, see MultiDraw. takes effect when the batches are rebuilt
+    void setMultiDrawIndirect(bool indirect) { m_multiDrawIndirect = indirect; }
+
+    /// sphere around every mesh under transform
+    const BoundingSphere& worldBounds(const glm::mat4& transform)
+    {
+        updateWorldBounds(transform);
+        return m_worldSphere;
+    }
+
+    /// gpu memory of the vertices and position streams of the resident meshes
+    size_t vertexBytes() const;
+
+    /// draw calls issued by the last draw()
+    int drawCalls() const { return m_drawCalls; }
+
+    /// resident meshes drawn and skipped by the frustum test in the last draw()
+    int drawnMeshes() const { return m_drawnMeshes; }
+    int culledMeshes() const { return m_culledMeshes; }
+    /// triangles of the LODs drawn by the last draw()
+    int drawnTriangles() const { return m_drawnTriangles; }
+
+    /// draw calls and triangles of the last depth only draw, every instance of a layered draw counted
+    int depthDrawCalls() const { return m_depthDrawCalls; }
+    int depthTriangles() const { return m_depthTriangles; }
     
 private:
     void loadModel(const std::string& path);
     void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    std::unique_ptr<Mesh> processMesh(aiMesh* mesh, const aiScene* scene);
     std::vector<Texture> loadMaterialTexture(aiMaterial* mat, aiTextureType type, std::string typeName);
+
+    /// fill the visibility and LODs of the view's slot
+    void select(const DrawView& view, const glm::mat4& transform);
+
+    /// consecutive multi-draw commands reading one vertex array with the textures and position decode of one mesh
+    struct DrawBatch
+    {
+        Mesh* material;
+        GLuint vertexArray;
+        size_t first;
+        size_t count;
+    };
+
+    struct BatchList
+    {
+        MultiDraw multiDraw;
+        std::vector<DrawBatch> batches;
+        /// meshes in the batches, rebuilt when a mesh becomes resident or changes visibility or LOD
+        std::vector<uint8_t> batched;
+    };
+
+    /// what is kept per DrawView slot from one frame to the next
+    struct ViewState
+    {
+        /// per mesh, 1 when it passed the last frustum test
+        std::vector<uint8_t> visible;
+        /// per mesh, the LOD it was drawn at last
+        std::vector<uint8_t> lodLevels;
+        BatchList colorBatches;
+        BatchList depthBatches;
+    };
+
+    ViewState& viewState(unsigned int slot);
+
+    /// draw the resident meshes marked visible in state at their LODs, depthOnly from the position streams
+    void submit(Program* program, ViewState& state, bool depthOnly);
+
+    /// LOD for a mesh seen from view, moving away from current only past a margin so meshes near
+    /// a switching distance do not flicker between two LODs
+    size_t selectLod(const Mesh& mesh, const BoundingSphere& sphere, const DrawView& view, size_t current) const;
+
+    /// world space boxes of every mesh under transform, recomputed when the transform or the mesh list changes
+    void updateWorldBounds(const glm::mat4& transform);
+
+    /// group the drawable meshes into multi-draw batches, drawable holds LOD + 1 per mesh, 0 to skip it.
+    /// depth batches ignore the textures
+    void buildBatches(const std::vector<uint8_t>& drawable, bool depthOnly, BatchList& list);
     
 private:
     /// model data
-    std::vector<Texture> textures_loaded;
-    std::vector<Mesh> m_meshes;
+    std::vector<std::unique_ptr<Mesh>> m_meshes;
     std::string m_path;
     std::string m_resource;
     glm::vec3 m_position;
-    std::atomic_bool m_loadFinished;
+    std::atomic_bool m_imported;
     std::shared_ptr<Assimp::Importer> m_importer;
     const aiScene* m_scene = nullptr;
+
+    std::shared_ptr<GeometryArena> m_arena;
+    bool m_compactVertices = false;
+    bool m_positionStream = false;
+    bool m_multiDrawIndirect = false;
+    InstanceBuffer m_instances;
+    int m_drawCalls = 0;
+
+    /// indexed by DrawView::slot, created on first use
+    std::vector<std::unique_ptr<ViewState>> m_views;
+    AABBList m_worldBoxes;
+    std::vector<BoundingSphere> m_worldSpheres;
+    /// around every mesh, tested first so a model entirely outside skips the per mesh test
+    BoundingSphere m_worldSphere;
+    glm::mat4 m_boundsTransform;
+    float m_boundsScale = 1.f;
+    size_t m_boundsMeshes = 0;
+    int m_drawnMeshes = 0;
+    int m_culledMeshes = 0;
+    int m_drawnTriangles = 0;
+    int m_depthDrawCalls = 0;
+    int m_depthTriangles = 0;
 };
 
 #endif /* Model_h */
@@ -0,0 +1,126 @@
+//
+//  ModelLoader.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "ModelLoader.h"
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+ModelLoader::ModelLoader(unsigned int threads)
+    : m_pool(new ThreadPool(threads)), m_pending(0), m_decodeMicroseconds(0), m_texturesDecoded(0), m_uploadMs(0.0), m_meshesUploaded(0)
+{
+}
+
+ModelLoader::~ModelLoader()
+{
+    // workers may still push to the queue, join them before it goes away
+    m_pool.reset();
+}
+
+void ModelLoader::load(Model* model)
+{
+    if (model == nullptr)
+    {
+        return;
+    }
+
+    m_pending++;
+    m_pool->submit([this, model]() {
+        model->import();
+        m_pending += (int)model->meshCount();
+        for (size_t i = 0; i < model->meshCount(); ++i)
+        {
+            Mesh* mesh = model->mesh(i);
+            if (!mesh->beginDecode())
+            {
+                m_decoded.push(mesh);
+                continue;
+            }
+            // one job per texture so a mesh with many large textures spreads over the workers
+            for (size_t t = 0; t < mesh->textures().size(); ++t)
+            {
+                m_pool->submit([this, mesh, t]() { decode(mesh, t); });
+            }
+        }
+        m_pending--;
+    });
+}
+
+int ModelLoader::update(double budgetMs)
+{
+    Clock::time_point start = Clock::now();
+
+    int uploaded = 0;
+    Mesh* mesh = nullptr;
+    while (m_decoded.pop(mesh))
+    {
+        upload(mesh);
+        uploaded++;
+
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (elapsed >= budgetMs)
+        {
+            break;
+        }
+    }
+
+    // staging buffers are only worth keeping while something is loading
+    if (pending() == 0)
+    {
+        m_textureUploader.release();
+    }
+    else
+    {
+        m_textureUploader.collect();
+    }
+    return uploaded;
+}
+
+void ModelLoader::flush()
+{
+    m_pool->wait();
+    Mesh* mesh = nullptr;
+    while (m_decoded.pop(mesh))
+    {
+        upload(mesh);
+    }
+    m_textureUploader.release(true);
+}
+
+ModelLoader::Stats ModelLoader::stats() const
+{
+    Stats stats;
+    stats.decodeMs = m_decodeMicroseconds.load(std::memory_order_relaxed) / 1000.0;
+    stats.uploadMs = m_uploadMs;
+    stats.texturesDecoded = m_texturesDecoded.load(std::memory_order_relaxed);
+    stats.texturesUploaded = m_textureUploader.texturesUploaded();
+    stats.meshesUploaded = m_meshesUploaded;
+    stats.bytesUploaded = m_textureUploader.bytesUploaded();
+    return stats;
+}
+
+void ModelLoader::decode(Mesh* mesh, size_t texture)
+{
+    Clock::time_point start = Clock::now();
+    bool finished = mesh->decodeTexture(texture);
+    m_decodeMicroseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    m_texturesDecoded++;
+
+    if (finished)
+    {
+        m_decoded.push(mesh);
+    }
+}
+
+void ModelLoader::upload(Mesh* mesh)
+{
+    Clock::time_point start = Clock::now();
+    mesh->upload(&m_textureUploader);
+    m_uploadMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    m_meshesUploaded++;
+    m_pending--;
+}
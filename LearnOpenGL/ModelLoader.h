@@ -0,0 +1,72 @@
+//
+//  ModelLoader.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef ModelLoader_h
+#define ModelLoader_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "LockFreeQueue.h"
+#include "Model.h"
+#include "TextureUploader.h"
+#include "ThreadPool.h"
+
+/// streams models in the background: import and texture decode run on a thread pool, one job per texture,
+/// decoded meshes are queued to the render thread which uploads them under a per frame time budget
+class ModelLoader
+{
+public:
+    /// cumulative loading counters, decode time is summed over the worker threads
+    struct Stats
+    {
+        double decodeMs;
+        double uploadMs;
+        int texturesDecoded;
+        int texturesUploaded;
+        int meshesUploaded;
+        size_t bytesUploaded;
+    };
+
+    ModelLoader(unsigned int threads = 0);
+
+    /// joins the workers, meshes still waiting for upload stay non-resident
+    ~ModelLoader();
+
+    /// start loading a model, the model draws whatever is resident until it is complete
+    void load(Model* model);
+
+    /// render thread, upload decoded meshes until budgetMs is spent, at least one per call
+    /// returns the number of meshes uploaded
+    int update(double budgetMs);
+
+    /// render thread, block until every queued model is resident
+    void flush();
+
+    /// meshes queued but not resident yet
+    int pending() const { return m_pending.load(std::memory_order_relaxed); }
+
+    Stats stats() const;
+
+private:
+    void decode(Mesh* mesh, size_t texture);
+    void upload(Mesh* mesh);
+
+private:
+    std::unique_ptr<ThreadPool> m_pool;
+    LockFreeQueue<Mesh*> m_decoded;
+    std::atomic<int> m_pending;
+
+    TextureUploader m_textureUploader;
+
+    std::atomic<uint64_t> m_decodeMicroseconds;
+    std::atomic<int> m_texturesDecoded;
+    double m_uploadMs;
+    int m_meshesUploaded;
+};
+
+#endif /* ModelLoader_h */
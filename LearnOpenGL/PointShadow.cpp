@@ -0,0 +1,361 @@
+//
+//  PointShadow.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "PointShadow.h"
+#include "GLExt.h"
+#include "GLState.h"
+#include "Model.h"
+#include "Program.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+/// casters closer to the light than this are clipped
+static const float NEAR_PLANE = 0.05f;
+
+namespace Uniforms
+{
+    constexpr UniformName model("model");
+    constexpr UniformName lightPos("lightPos");
+    constexpr UniformName farPlane("far_plane");
+    constexpr UniformName shadowMatrix("shadowMatrix");
+    constexpr UniformName shadowMatrices("shadowMatrices");
+    constexpr UniformName depthMap("depthMap");
+    constexpr UniformName face("face");
+    constexpr UniformName size("size");
+    constexpr UniformName source("source");
+}
+
+const char* PointShadow::methodName(Method method)
+{
+    switch (method)
+    {
+    case GEOMETRY_SHADER: return "geometry shader";
+    case LAYERED: return "layered";
+    case CULLED_FACES: return "culled faces";
+    default: return "unknown";
+    }
+}
+
+const char* PointShadow::filterName(Filter filter)
+{
+    switch (filter)
+    {
+    case PCF: return "pcf";
+    case ESM: return "esm";
+    case EVSM: return "evsm";
+    default: return "unknown";
+    }
+}
+
+bool PointShadow::isSupported(Method method)
+{
+    return method == LAYERED ? GLExt::hasVertexShaderLayer() : method < METHOD_COUNT;
+}
+
+PointShadow::PointShadow()
+    : m_staticMap(0), m_dynamicMap(0), m_framebuffer(0), m_copyFramebuffer(0), m_size(0), m_firstSlot(1), m_farPlane(1.f), m_maxPixelError(1.f),
+      m_position(0.f), m_method(CULLED_FACES), m_faceMatrices(6), m_valid(false), m_dynamicCasters(false), m_staticUpdates(0), m_filter(PCF),
+      m_momentMaps(), m_blurTexture(0), m_momentFramebuffer(0), m_emptyVertexArray(0), m_momentSource(0)
+{
+}
+
+PointShadow::~PointShadow()
+{
+    GLuint maps[2] = {m_staticMap, m_dynamicMap};
+    GLState::deleteTextures(2, maps);
+    GLState::deleteTextures(FILTER_COUNT, m_momentMaps);
+    GLState::deleteTextures(1, &m_blurTexture);
+    GLuint framebuffers[3] = {m_framebuffer, m_copyFramebuffer, m_momentFramebuffer};
+    glDeleteFramebuffers(3, framebuffers);
+    GLState::deleteVertexArrays(1, &m_emptyVertexArray);
+}
+
+GLuint PointShadow::createCubeMap(GLsizei size)
+{
+    // linear filtering with depth comparison gives 2x2 pcf for one fetch
+    GLuint map = 0;
+    glGenTextures(1, &map);
+    GLState::bindTexture(GL_TEXTURE_CUBE_MAP, map);
+    for (GLuint i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    return map;
+}
+
+void PointShadow::create(GLsizei size, unsigned int firstSlot)
+{
+    m_size = size;
+    m_firstSlot = firstSlot;
+    m_staticMap = createCubeMap(size);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glGenFramebuffers(1, &m_copyFramebuffer);
+    for (GLuint framebuffer : {m_framebuffer, m_copyFramebuffer})
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    m_programs[GEOMETRY_SHADER].reset(new Program("shadow"));
+    m_programs[CULLED_FACES].reset(new Program("shadow", {"CULLED_FACES", Program::NO_GEOMETRY_SHADER}));
+    if (isSupported(LAYERED))
+    {
+        m_programs[LAYERED].reset(new Program("shadow", {"LAYERED", Program::NO_GEOMETRY_SHADER}));
+    }
+
+    // the blur draws one triangle without attributes, core profile still wants a vertex array bound
+    glGenFramebuffers(1, &m_momentFramebuffer);
+    glGenVertexArrays(1, &m_emptyVertexArray);
+    m_momentPrograms[ESM].reset(new Program("shadow-moments", {"ESM"}));
+    m_momentPrograms[EVSM].reset(new Program("shadow-moments", {"EVSM"}));
+    m_blurProgram.reset(new Program("shadow-moments", {"VERTICAL"}));
+}
+
+glm::mat4 PointShadow::faceView(const glm::vec3& position, int face)
+{
+    // cube map faces look down the axes with y flipped, the sampling direction picks the texel
+    static const glm::vec3 directions[6] = {{1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, -1.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 0.f, -1.f}};
+    static const glm::vec3 ups[6] = {{0.f, -1.f, 0.f}, {0.f, -1.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 0.f, -1.f}, {0.f, -1.f, 0.f}, {0.f, -1.f, 0.f}};
+    return glm::lookAt(position, position + directions[face], ups[face]);
+}
+
+void PointShadow::invalidate()
+{
+    m_valid = false;
+}
+
+void PointShadow::render(const glm::vec3& position, float farPlane, const std::vector<ShadowCaster>& casters, Method method, float maxPixelError,
+                         Filter filter)
+{
+    m_stats = Stats();
+    if (m_framebuffer == 0)
+    {
+        return;
+    }
+    if (!isSupported(method))
+    {
+        method = CULLED_FACES;
+    }
+
+    // the casters within range, with what their part of the map depends on
+    MapState staticState = {position, farPlane, maxPixelError, {}};
+    MapState dynamicState = staticState;
+    for (const ShadowCaster& caster : casters)
+    {
+        const BoundingSphere& bounds = caster.model->worldBounds(caster.transform);
+        if (glm::length(bounds.center - position) - bounds.radius > farPlane)
+        {
+            continue;
+        }
+        ShadowCasterState state = {caster.model, caster.transform, caster.model->residentMeshes()};
+        (caster.dynamic ? dynamicState : staticState).casters.push_back(state);
+    }
+    m_stats.staticCasters = (int)staticState.casters.size();
+    m_stats.dynamicCasters = (int)dynamicState.casters.size();
+
+    m_method = method;
+    m_position = position;
+    m_farPlane = farPlane;
+    m_maxPixelError = maxPixelError;
+
+    // the faces away from the light go into the map, so lit surfaces are compared against the far side of their mesh.
+    // no acne where the receiver is drawn at a coarser LOD than the caster, only thin meshes risk light leaks
+    GLState::enable(GL_CULL_FACE);
+    GLState::cullFace(GL_FRONT);
+
+    bool staticUpdate = !m_valid || staticState != m_staticState;
+    if (staticUpdate)
+    {
+        draw(m_staticMap, staticState.casters, true);
+        m_staticState = std::move(staticState);
+        m_stats.staticUpdated = true;
+        m_staticUpdates++;
+    }
+
+    // a dynamic map left behind while no dynamic caster was in range may predate the static one
+    m_dynamicCasters = !dynamicState.casters.empty();
+    if (!m_dynamicCasters)
+    {
+        m_dynamicState.casters.clear();
+    }
+    else if (staticUpdate || dynamicState != m_dynamicState)
+    {
+        if (m_dynamicMap == 0)
+        {
+            m_dynamicMap = createCubeMap(m_size);
+        }
+
+        // start from the static casters and draw the dynamic ones over them
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_copyFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+        for (int face = 0; face < 6; ++face)
+        {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_staticMap, 0);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_dynamicMap, 0);
+            glBlitFramebuffer(0, 0, m_size, m_size, 0, 0, m_size, m_size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+        draw(m_dynamicMap, dynamicState.casters, false);
+        m_dynamicState = std::move(dynamicState);
+        m_stats.dynamicUpdated = true;
+    }
+    m_valid = true;
+
+    // back to the engine default, no culling
+    GLState::cullFace(GL_BACK);
+    GLState::disable(GL_CULL_FACE);
+
+    // the moments follow the map they were filtered from
+    if (filter != m_filter)
+    {
+        m_momentSource = 0;
+        m_filter = filter;
+    }
+    if (m_filter != PCF && (staticUpdate || m_stats.dynamicUpdated || m_momentSource != depthMap()))
+    {
+        filterMoments();
+        m_stats.filtered = true;
+    }
+}
+
+void PointShadow::filterMoments()
+{
+    GLuint& moments = m_momentMaps[m_filter];
+    if (moments == 0)
+    {
+        // esm needs one channel, evsm four. 32 bit floats for the exponents, trilinear over the mip chain
+        GLenum format = m_filter == ESM ? GL_R32F : GL_RGBA32F;
+        glGenTextures(1, &moments);
+        GLState::bindTexture(GL_TEXTURE_CUBE_MAP, moments);
+        for (GLuint i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, m_size, m_size, 0, GL_RGBA, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    if (m_blurTexture == 0)
+    {
+        glGenTextures(1, &m_blurTexture);
+        GLState::bindTexture(GL_TEXTURE_2D, m_blurTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_size, m_size, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // the distances are read as values, the comparison comes back for pcf afterwards
+    GLuint source = depthMap();
+    GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, source);
+    GLState::activeTexture(0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    GLState::bindTexture(1, GL_TEXTURE_2D, m_blurTexture);
+
+    // moments are written as they are, no blending
+    GLState::disable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_momentFramebuffer);
+    glViewport(0, 0, m_size, m_size);
+    GLState::bindVertexArray(m_emptyVertexArray);
+    Program* warp = m_momentPrograms[m_filter].get();
+    for (int face = 0; face < 6; ++face)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_blurTexture, 0);
+        warp->use();
+        warp->setUniform1i(Uniforms::depthMap, 0);
+        warp->setUniform1i(Uniforms::face, face);
+        warp->setUniform1f(Uniforms::size, (float)m_size);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, moments, 0);
+        m_blurProgram->use();
+        m_blurProgram->setUniform1i(Uniforms::source, 1);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    m_stats.passes += 12;
+    GLState::enable(GL_BLEND);
+
+    GLState::activeTexture(0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    GLState::bindTexture(GL_TEXTURE_CUBE_MAP, moments);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    m_momentSource = source;
+}
+
+void PointShadow::draw(GLuint map, const std::vector<ShadowCasterState>& casters, bool clear)
+{
+    std::vector<DrawView> views;
+    views.reserve(6);
+    glm::mat4 project = glm::perspective(glm::radians(90.f), 1.f, NEAR_PLANE, m_farPlane);
+    for (int face = 0; face < 6; ++face)
+    {
+        glm::mat4 view = faceView(m_position, face);
+        m_faceMatrices[face] = project * view;
+        views.emplace_back(view, project, m_position, (float)m_size, m_maxPixelError, m_firstSlot + face);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, m_size, m_size);
+    Program* program = m_programs[m_method].get();
+    program->use();
+    program->setUniform3f(Uniforms::lightPos, m_position);
+    program->setUniform1f(Uniforms::farPlane, m_farPlane);
+
+    if (m_method == CULLED_FACES)
+    {
+        for (int face = 0; face < 6; ++face)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, map, 0);
+            if (clear)
+            {
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+            program->setUniformMatrix4fv(Uniforms::shadowMatrix, m_faceMatrices[face]);
+            for (const ShadowCasterState& caster : casters)
+            {
+                program->setUniformMatrix4fv(Uniforms::model, caster.transform);
+                caster.model->drawDepth(program, views[face], caster.transform);
+                m_stats.drawCalls += caster.model->depthDrawCalls();
+                m_stats.faceTriangles += caster.model->depthTriangles();
+            }
+        }
+        m_stats.passes += 6;
+        return;
+    }
+
+    // one layered pass over the whole cube
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, map, 0);
+    if (clear)
+    {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    program->setUniformMatrix4fv(Uniforms::shadowMatrices, m_faceMatrices);
+    for (const ShadowCasterState& caster : casters)
+    {
+        program->setUniformMatrix4fv(Uniforms::model, caster.transform);
+        if (m_method == GEOMETRY_SHADER)
+        {
+            caster.model->drawDepth(program, m_firstSlot);
+            m_stats.faceTriangles += caster.model->depthTriangles() * 6;
+        }
+        else
+        {
+            caster.model->drawDepthLayers(program, views.data(), views.size(), caster.transform);
+            m_stats.faceTriangles += caster.model->depthTriangles();
+        }
+        m_stats.drawCalls += caster.model->depthDrawCalls();
+    }
+    m_stats.passes++;
+}
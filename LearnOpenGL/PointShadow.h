@@ -0,0 +1,187 @@
+//
+//  PointShadow.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef PointShadow_h
+#define PointShadow_h
+
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Model;
+class Program;
+
+/// a model casting shadows under its model matrix. static casters are cached, dynamic ones are drawn over
+/// a copy of the cache whenever one of them changes, so a moving object does not redraw the whole scene
+struct ShadowCaster
+{
+    Model* model;
+    glm::mat4 transform;
+    bool dynamic = false;
+};
+
+/// what a shadow map drawn from a caster depends on, its geometry changes as its meshes become resident
+struct ShadowCasterState
+{
+    Model* model;
+    glm::mat4 transform;
+    size_t residentMeshes;
+
+    bool operator==(const ShadowCasterState& other) const
+    {
+        return model == other.model && transform == other.transform && residentMeshes == other.residentMeshes;
+    }
+};
+
+/// cube map of the distance to a point light, linear in [0, 1] up to the far plane and sampled with
+/// depth comparison. the casters are drawn from their position streams with one of three methods.
+/// the map is only drawn again when the light, the range or a caster within range changed.
+/// for soft shadows the distances can be prefiltered into a cube map of exponential moments
+class PointShadow
+{
+public:
+    enum Method
+    {
+        /// every triangle is sent once and a geometry shader emits it into all six faces
+        GEOMETRY_SHADER = 0,
+        /// meshes are culled per face on the cpu and drawn once, instanced over the faces that see them.
+        /// the vertex shader picks the face with gl_Layer, needs GLExt::hasVertexShaderLayer()
+        LAYERED,
+        /// meshes are culled per face on the cpu, one pass per face multi-draws the visible ones
+        CULLED_FACES,
+        METHOD_COUNT,
+    };
+
+    static const char* methodName(Method method);
+    static bool isSupported(Method method);
+
+    /// how the lighting samples the shadow
+    enum Filter
+    {
+        /// depth comparison with hardware 2x2 pcf on depthMap()
+        PCF = 0,
+        /// exponential shadow map, momentMap() holds exp(c * depth) blurred, one filtered fetch
+        ESM,
+        /// exponential variance shadow map, momentMap() holds the first two moments of a positive and a negative
+        /// exponential warp, one filtered fetch and a Chebyshev bound for each
+        EVSM,
+        FILTER_COUNT,
+    };
+
+    static const char* filterName(Filter filter);
+
+    /// what the last render() sent to the gpu, a triangle drawn into two faces counts twice
+    struct Stats
+    {
+        int passes = 0;
+        int drawCalls = 0;
+        int faceTriangles = 0;
+        /// casters within range of the light
+        int staticCasters = 0;
+        int dynamicCasters = 0;
+        /// the static cache was drawn again, the dynamic casters were drawn over it
+        bool staticUpdated = false;
+        bool dynamicUpdated = false;
+        /// the moments were filtered again from the map
+        bool filtered = false;
+    };
+
+    PointShadow();
+    ~PointShadow();
+    PointShadow(const PointShadow&) = delete;
+    PointShadow& operator=(const PointShadow&) = delete;
+
+    /// cube depth texture with faces of size x size, its framebuffer and the programs, render thread only.
+    /// the faces draw the casters with the DrawView slots firstSlot to firstSlot + 5
+    void create(GLsizei size, unsigned int firstSlot = 1);
+
+    /// bring the map up to date for the casters seen from position up to farPlane, picking caster LODs for
+    /// maxPixelError texels. casters out of range are skipped, an unsupported method falls back to CULLED_FACES.
+    /// ESM and EVSM filter the moments again whenever the map changed. may leave the shadow framebuffer bound
+    void render(const glm::vec3& position, float farPlane, const std::vector<ShadowCaster>& casters, Method method, float maxPixelError,
+                Filter filter = PCF);
+
+    /// forget what the map holds, the next render() draws every caster
+    void invalidate();
+
+    /// cube map to sample, the static cache itself while no dynamic caster is in range
+    GLuint depthMap() const { return m_dynamicCasters ? m_dynamicMap : m_staticMap; }
+    GLsizei size() const { return m_size; }
+    float farPlane() const { return m_farPlane; }
+    const Stats& stats() const { return m_stats; }
+    /// method the last render() used, after the fallback
+    Method method() const { return m_method; }
+    /// filter of the last render() and its mipmapped float cube map of moments, 0 for PCF
+    Filter filter() const { return m_filter; }
+    GLuint momentMap() const { return m_momentMaps[m_filter]; }
+    /// times the static cache was drawn since create()
+    int staticUpdates() const { return m_staticUpdates; }
+
+    /// view of cube face GL_TEXTURE_CUBE_MAP_POSITIVE_X + face seen from position
+    static glm::mat4 faceView(const glm::vec3& position, int face);
+
+private:
+    struct MapState
+    {
+        glm::vec3 position;
+        float farPlane;
+        float maxPixelError;
+        std::vector<ShadowCasterState> casters;
+
+        bool operator==(const MapState& other) const
+        {
+            return position == other.position && farPlane == other.farPlane && maxPixelError == other.maxPixelError && casters == other.casters;
+        }
+        bool operator!=(const MapState& other) const { return !(*this == other); }
+    };
+
+    static GLuint createCubeMap(GLsizei size);
+
+    /// draw casters into map, over what it holds when clear is false
+    void draw(GLuint map, const std::vector<ShadowCasterState>& casters, bool clear);
+
+    /// warp and blur every face of depthMap() into the moments of m_filter, then build their mipmaps
+    void filterMoments();
+
+private:
+    /// static casters only, and a copy of it with the dynamic casters on top
+    GLuint m_staticMap;
+    GLuint m_dynamicMap;
+    GLuint m_framebuffer;
+    /// reads the static map when it is copied
+    GLuint m_copyFramebuffer;
+    GLsizei m_size;
+    unsigned int m_firstSlot;
+    float m_farPlane;
+    float m_maxPixelError;
+    glm::vec3 m_position;
+    Method m_method;
+    std::unique_ptr<Program> m_programs[METHOD_COUNT];
+    std::vector<glm::mat4> m_faceMatrices;
+    Stats m_stats;
+
+    /// what the maps hold, the dynamic map only counts while m_dynamicCasters
+    MapState m_staticState;
+    MapState m_dynamicState;
+    bool m_valid;
+    bool m_dynamicCasters;
+    int m_staticUpdates;
+
+    /// moments per filter, created on first use. the blur texture holds a face between the two blur passes
+    Filter m_filter;
+    GLuint m_momentMaps[FILTER_COUNT];
+    GLuint m_blurTexture;
+    GLuint m_momentFramebuffer;
+    GLuint m_emptyVertexArray;
+    std::unique_ptr<Program> m_momentPrograms[FILTER_COUNT];
+    std::unique_ptr<Program> m_blurProgram;
+    /// the map the current moments were filtered from, 0 when they are out of date
+    GLuint m_momentSource;
+};
+
+#endif /* PointShadow_h */
@@ -5,6 +5,10 @@
 //  Created by asi on 2024/8/4.
 //
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -13,42 +17,109 @@
 #include <GLFW/glfw3.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "GLState.h"
 #include "Program.h"
+#include "ProgramCache.h"
 #include "System.hpp"
+#include "UniformBuffer.h"
 
 
+UniformStats Program::s_frameStats;
+UniformStats Program::s_lastFrameStats;
+
+namespace
+{
+    /// "array[i].field" uniform names, each index is built once and kept for the process lifetime
+    class ArrayUniformNames
+    {
+    public:
+        ArrayUniformNames(const char* array, std::initializer_list<const char*> fields)
+            : m_array(array), m_fields(fields)
+        {
+        }
+
+        const UniformName& at(size_t index, size_t field)
+        {
+            while (m_uniforms.size() <= index)
+            {
+                size_t i = m_uniforms.size();
+                m_uniforms.emplace_back();
+                for (const char* name : m_fields)
+                {
+                    m_names.push_back(m_array + "[" + std::to_string(i) + "]." + name);
+                    m_uniforms.back().emplace_back(m_names.back());
+                }
+            }
+            return m_uniforms[index][field];
+        }
+
+    private:
+        std::string m_array;
+        std::vector<const char*> m_fields;
+        // deque keeps the strings in place, the uniform names point into them
+        std::deque<std::string> m_names;
+        std::vector<std::vector<UniformName>> m_uniforms;
+    };
+}
+
 Program::Program()
-    : m_program(0)
+    : m_program(0), m_linked(false)
 {
 
 }
 
-Program::Program(const std::string& shader)
-    : m_program(0)
+Program::Program(const std::string& shader, const std::vector<std::string>& defines)
+    : m_program(0), m_linked(false)
 {
     init();
-    std::string script = loadShader("shaders/" + shader + ".vert");
-    if (!script.empty())
+    std::string vertex = addDefines(loadShader("shaders/" + shader + ".vert"), defines);
+    // variants that project in the vertex shader leave the geometry shader of the other variants out
+    bool geometryStage = std::find(defines.begin(), defines.end(), NO_GEOMETRY_SHADER) == defines.end();
+    std::string geometry = geometryStage ? addDefines(loadShader("shaders/" + shader + ".geom"), defines) : std::string();
+    std::string fragment = addDefines(loadShader("shaders/" + shader + ".frag"), defines);
+
+    // a cached binary of the same sources and driver skips compiling and linking
+    std::string variant = shader;
+    for (const std::string& define : defines)
+    {
+        variant += "-" + define;
+    }
+    std::string cacheFile = ProgramCache::cachePath(variant);
+    uint64_t cacheKey = ProgramCache::key({vertex, geometry, fragment});
+    if (ProgramCache::load(cacheFile, cacheKey, m_program))
     {
-        setVertexShader(script);
+        m_linked = true;
+        UniformBlocks::bind(m_program);
+        return;
     }
 
-    script = loadShader("shaders/" + shader + ".geom");
-    if (!script.empty())
+    if (!vertex.empty())
     {
-        setGeometryShader(script);
+        setVertexShader(vertex);
+    }
+    if (!geometry.empty())
+    {
+        setGeometryShader(geometry);
+    }
+    if (!fragment.empty())
+    {
+        setFragmentShader(fragment);
     }
 
-    script = loadShader("shaders/" + shader + ".frag");
-    if (!script.empty())
+    ProgramCache::prepare(m_program);
+    if (link())
     {
-        setFragmentShader(script);
+        ProgramCache::save(cacheFile, cacheKey, m_program);
     }
 }
 
 Program::~Program()
 {
-    glDeleteProgram(m_program);
+    for (unsigned int shader : m_shaders)
+    {
+        glDeleteShader(shader);
+    }
+    GLState::deleteProgram(m_program);
 }
 
 void Program::init()
@@ -58,219 +129,178 @@ void Program::init()
 
 void Program::setVertexShader(const std::string& shader)
 {
-    unsigned int nVertexShader = compileShader(GL_VERTEX_SHADER, shader);
-    glAttachShader(m_program, nVertexShader);
-    glLinkProgram(m_program);
-    glDeleteShader(nVertexShader);
-    
-    GLint linkStatus;
-    glGetProgramiv(m_program, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus != GL_TRUE)
-    {
-        GLchar infoLog[512];
-        glGetProgramInfoLog(m_program, sizeof(infoLog), nullptr, infoLog);
-        std::cerr << "Program linking failed:\n" << infoLog << std::endl;
-    }
+    attachShader(GL_VERTEX_SHADER, shader);
 }
 
 void Program::setFragmentShader(const std::string& shader)
 {
-    unsigned int nFragmentShader = compileShader(GL_FRAGMENT_SHADER, shader);
-    glAttachShader(m_program, nFragmentShader);
-    glLinkProgram(m_program);
-    glDeleteShader(nFragmentShader);
-    
-    GLint linkStatus;
-    glGetProgramiv(m_program, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus != GL_TRUE)
-    {
-        GLchar infoLog[512];
-        glGetProgramInfoLog(m_program, sizeof(infoLog), nullptr, infoLog);
-        std::cerr << "Program linking failed:\n" << infoLog << std::endl;
-    }
+    attachShader(GL_FRAGMENT_SHADER, shader);
 }
 
 void Program::setGeometryShader(const std::string& shader)
 {
-    unsigned int nGeometryShader = compileShader(GL_GEOMETRY_SHADER, shader);
-    glAttachShader(m_program, nGeometryShader);
-    glLinkProgram(m_program);
-    glDeleteShader(nGeometryShader);
-    
-    GLint linkStatus;
-    glGetProgramiv(m_program, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus != GL_TRUE)
-    {
-        GLchar infoLog[512];
-        glGetProgramInfoLog(m_program, sizeof(infoLog), nullptr, infoLog);
-        std::cerr << "Program linking failed:\n" << infoLog << std::endl;
-    }
+    attachShader(GL_GEOMETRY_SHADER, shader);
 }
 
-void Program::use()
+bool Program::link()
 {
     glLinkProgram(m_program);
-    
+    for (unsigned int shader : m_shaders)
+    {
+        glDetachShader(m_program, shader);
+        glDeleteShader(shader);
+    }
+    m_shaders.clear();
+
     GLint linkStatus;
     glGetProgramiv(m_program, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus == GL_FALSE)
+    m_linked = linkStatus == GL_TRUE;
+    // locations and values do not survive a relink
+    m_uniformLocations.clear();
+#ifndef NDEBUG
+    m_uniformNames.clear();
+#endif
+    m_uniformShadows.clear();
+    if (m_linked)
+    {
+        UniformBlocks::bind(m_program);
+    }
+    else
     {
         GLint maxLength = 0;
         glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &maxLength);
 
-        std::vector<char> infoLog(maxLength);
+        std::vector<char> infoLog(maxLength + 1);
         glGetProgramInfoLog(m_program, maxLength, &maxLength, &infoLog[0]);
 
         std::cerr << "shader program linking failed:\n" << &infoLog[0] << "\n";
     }
-    
-    if (!glIsProgram(m_program)) {
-        std::cerr << "shader program is invalid\n";
-    }
-    
-    glUseProgram(m_program);
-    
-    GLenum error = glGetError();
-    if (error == GL_NO_ERROR) {
-        GLint currentProgram;
-        glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    return m_linked;
+}
 
-        if (currentProgram != m_program) {
-            std::cerr << "shader program binding failed\n";
-        }
-    } else {
-        std::cerr << "glUseProgram failed with error: " << error << "\n";
-    }
+void Program::use()
+{
+    // glUseProgram is cheap but not free, and most draws keep the same program
+    GLState::useProgram(m_program);
 }
 
-void Program::setUniform1i(const std::string& key, int value)
+void Program::setUniform1i(GLint location, int value)
 {
-    GLuint location = getLocation(key);
-    if (location >= 0)
+    if (location >= 0 && changed(location, &value, sizeof(value)))
     {
         glUniform1i(location, value);
     }
 }
 
-void Program::setUniform1f(const std::string& key, float value)
+void Program::setUniform1f(GLint location, float value)
 {
-    GLuint location = getLocation(key);
-    if (location >= 0)
+    if (location >= 0 && changed(location, &value, sizeof(value)))
     {
         glUniform1f(location, value);
     }
 }
 
-void Program::setUniform3f(const std::string& key, const glm::vec3& value)
+void Program::setUniform3f(GLint location, const glm::vec3& value)
 {
-    GLuint location = getLocation(key);
-    if (location >= 0)
+    if (location >= 0 && changed(location, &value, sizeof(value)))
     {
         glUniform3f(location, value.x, value.y, value.z);
     }
 }
 
-void Program::setUniform3f(const std::string& key, float x, float y, float z)
+void Program::setUniform3f(GLint location, float x, float y, float z)
 {
-    GLuint location = getLocation(key);
-    if (location >= 0)
-    {
-        glUniform3f(location, x, y, z);
-    }
+    setUniform3f(location, glm::vec3(x, y, z));
 }
 
-void Program::setUniformMatrix4fv(const std::string& key, const glm::mat4& value)
+void Program::setUniformMatrix4fv(GLint location, const glm::mat4& value)
 {
-    GLuint location = getLocation(key);
-    if (location >= 0)
+    if (location >= 0 && changed(location, &value, sizeof(value)))
     {
         glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
     }
 }
 
-void Program::setUniformMatrix4fv(const std::string& key, const std::vector<glm::mat4>& value)
+void Program::setUniformMatrix4fv(GLint location, const std::vector<glm::mat4>& value)
 {
-    GLuint location = getLocation(key);
-    if (location >= 0)
+    if (location >= 0 && !value.empty() && changed(location, value.data(), value.size() * sizeof(glm::mat4)))
     {
-        glUniformMatrix4fv(location, 6, GL_FALSE, glm::value_ptr(value[0]));
+        glUniformMatrix4fv(location, (GLsizei)value.size(), GL_FALSE, glm::value_ptr(value[0]));
     }
 }
 
 void Program::setUniformSpotLights(const std::vector<PointLight*>& spotLights)
 {
-    std::string key = "";
+    static ArrayUniformNames names("spot_lights", {"position", "color", "constant", "linear", "quadratic", "on"});
     setUniform1i("num_spot_lights", (int)spotLights.size());
     for (int i = 0; i < spotLights.size(); i++) {
-        key = "spot_lights[" + std::to_string(i) + "].position";
-        setUniform3f(key, spotLights[i]->position);
-        
-        key = "spot_lights[" + std::to_string(i) + "].color";
-        setUniform3f(key, spotLights[i]->color);
-        
-        key = "spot_lights[" + std::to_string(i) + "].constant";
-        setUniform1f(key, spotLights[i]->constant);
-        
-        key = "spot_lights[" + std::to_string(i) + "].linear";
-        setUniform1f(key, spotLights[i]->linear);
-        
-        key = "spot_lights[" + std::to_string(i) + "].quadratic";
-        setUniform1f(key, spotLights[i]->quadratic);
-        
-        key = "spot_lights[" + std::to_string(i) + "].on";
-        setUniform1i(key, spotLights[i]->on);
+        setUniform3f(names.at(i, 0), spotLights[i]->position);
+        setUniform3f(names.at(i, 1), spotLights[i]->color);
+        setUniform1f(names.at(i, 2), spotLights[i]->constant);
+        setUniform1f(names.at(i, 3), spotLights[i]->linear);
+        setUniform1f(names.at(i, 4), spotLights[i]->quadratic);
+        setUniform1i(names.at(i, 5), spotLights[i]->on);
     }
 }
 
 void Program::setUniformFlashLight(const std::vector<FlashLight*>& flashLights)
 {
-    std::string key = "";
+    static ArrayUniformNames names("flash_lights", {"position", "direction", "color", "cutOff", "outerCutOff", "constant", "linear", "quadratic", "on"});
     setUniform1i("num_flash_lights", (int)flashLights.size());
     for (int i = 0; i < flashLights.size(); i++) {
-        key = "flash_lights[" + std::to_string(i) + "].position";
-        setUniform3f(key, flashLights[i]->position);
-        
-        key = "flash_lights[" + std::to_string(i) + "].direction";
-        setUniform3f(key, flashLights[i]->direction);
-        
-        key = "flash_lights[" + std::to_string(i) + "].color";
-        setUniform3f(key, flashLights[i]->color * flashLights[i]->intensity);
-        
-        key = "flash_lights[" + std::to_string(i) + "].cutOff";
-        setUniform1f(key, flashLights[i]->cutOff);
-        
-        key = "flash_lights[" + std::to_string(i) + "].outerCutOff";
-        setUniform1f(key, flashLights[i]->outerCutOff);
-        
-        key = "flash_lights[" + std::to_string(i) + "].constant";
-        setUniform1f(key, flashLights[i]->constant);
-        
-        key = "flash_lights[" + std::to_string(i) + "].linear";
-        setUniform1f(key, flashLights[i]->linear);
-        
-        key = "flash_lights[" + std::to_string(i) + "].quadratic";
-        setUniform1f(key, flashLights[i]->quadratic);
-        
-        key = "flash_lights[" + std::to_string(i) + "].on";
-        setUniform1i(key, flashLights[i]->on);
+        setUniform3f(names.at(i, 0), flashLights[i]->position);
+        setUniform3f(names.at(i, 1), flashLights[i]->direction);
+        setUniform3f(names.at(i, 2), flashLights[i]->color * flashLights[i]->intensity);
+        setUniform1f(names.at(i, 3), flashLights[i]->cutOff);
+        setUniform1f(names.at(i, 4), flashLights[i]->outerCutOff);
+        setUniform1f(names.at(i, 5), flashLights[i]->constant);
+        setUniform1f(names.at(i, 6), flashLights[i]->linear);
+        setUniform1f(names.at(i, 7), flashLights[i]->quadratic);
+        setUniform1i(names.at(i, 8), flashLights[i]->on);
     }
 }
 
-GLuint Program::getLocation(const std::string& param)
+void Program::endFrame()
+{
+    s_lastFrameStats = s_frameStats;
+    s_frameStats = UniformStats();
+}
+
+bool Program::changed(GLint location, const void* value, size_t size)
 {
-    GLuint location = -1;
-    if (m_mapUniformLoc.find(param) != m_mapUniformLoc.end())
+    if (location >= (GLint)m_uniformShadows.size())
     {
-        location = m_mapUniformLoc.at(param);
+        m_uniformShadows.resize(location + 1);
     }
-    else
+
+    // the shadow only allocates the first time a location is set
+    std::vector<unsigned char>& shadow = m_uniformShadows[location];
+    if (shadow.size() == size && memcmp(shadow.data(), value, size) == 0)
     {
-        location = glGetUniformLocation(m_program, param.c_str());
-        if (location >= 0)
-        {
-            m_mapUniformLoc[param] = location;
-        }
+        s_frameStats.skipped++;
+        return false;
     }
+    shadow.assign((const unsigned char*)value, (const unsigned char*)value + size);
+    s_frameStats.submitted++;
+    return true;
+}
+
+GLint Program::location(const UniformName& name)
+{
+    auto it = m_uniformLocations.find(name.hash);
+    if (it != m_uniformLocations.end())
+    {
+        // a colliding name would silently get the location of the other one
+        assert(m_uniformNames[name.hash] == name.name);
+        return it->second;
+    }
+
+    // inactive uniforms are cached too, so a missing name queries gl only once
+    GLint location = glGetUniformLocation(m_program, name.name);
+    m_uniformLocations.emplace(name.hash, location);
+#ifndef NDEBUG
+    m_uniformNames.emplace(name.hash, name.name);
+#endif
     return location;
 }
 
@@ -291,6 +321,41 @@ std::string Program::loadShader(const std::string &file_name)
     return buffer.str();
 }
 
+std::string Program::addDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+    if (source.empty() || defines.empty())
+    {
+        return source;
+    }
+    std::string lines;
+    for (const std::string& define : defines)
+    {
+        lines += "#define " + define + "\n";
+    }
+    // #version has to stay the first statement
+    size_t version = source.find("#version");
+    if (version == std::string::npos)
+    {
+        return lines + source;
+    }
+    size_t lineEnd = source.find('\n', version);
+    if (lineEnd == std::string::npos)
+    {
+        return source + "\n" + lines;
+    }
+    return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
+}
+
+void Program::attachShader(unsigned int type, const std::string& shader)
+{
+    unsigned int id = compileShader(type, shader);
+    if (id != 0)
+    {
+        glAttachShader(m_program, id);
+        m_shaders.push_back(id);
+    }
+}
+
 unsigned int Program::compileShader(unsigned int type, const std::string& shader)
 {
     unsigned int id = glCreateShader(type);
@@ -306,7 +371,7 @@ unsigned int Program::compileShader(unsigned int type, const std::string& shader
         glGetShaderiv(id, GL_INFO_LOG_LENGTH, &nLength);
         char* message = (char*)alloca(nLength * sizeof(char));
         glGetShaderInfoLog(id, nLength, &nLength, message);
-        std::cerr << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader: " << message << std::endl;
+        std::cerr << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : type == GL_GEOMETRY_SHADER ? "geometry" : "fragment") << " shader: " << message << std::endl;
         glDeleteShader(id);
         return 0;
     }
@@ -10,44 +10,107 @@
 
 #include <iostream>
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include "Hash.h"
 #include "Light.hpp"
 
+/// uniform name with its hash, programs cache locations by the hash so setting a uniform
+/// neither allocates nor compares strings. declare static names constexpr to hash them at
+/// compile time, names built at runtime must outlive the UniformName
+struct UniformName
+{
+    constexpr UniformName(const char* _name)
+        : name(_name), hash(Hash::fnv1a64String(_name))
+    {
+    }
+
+    UniformName(const std::string& _name)
+        : name(_name.c_str()), hash(Hash::fnv1a64(_name.data(), _name.size()))
+    {
+    }
+
+    const char* name;
+    uint64_t hash;
+};
+
+/// glUniform* calls issued versus skipped because the value was already set
+struct UniformStats
+{
+    uint64_t submitted = 0;
+    uint64_t skipped = 0;
+};
+
 class Program
 {
 public:
+    /// define of the variants that do without the geometry shader, see the constructor
+    static constexpr const char* NO_GEOMETRY_SHADER = "NO_GEOMETRY_SHADER";
+
     Program();
-    Program(const std::string& shader);
+    /// compile shaders/<shader>.vert/.geom/.frag, each define is inserted as "#define <define>"
+    /// after the #version line so one source can serve several variants. a variant defining
+    /// NO_GEOMETRY_SHADER is built without the .geom
+    Program(const std::string& shader, const std::vector<std::string>& defines = {});
     ~Program();
     
     /// initial program
     void init();
     
-    /// bind shader for program
+    /// compile and attach shader for program, takes effect on link()
     void setVertexShader(const std::string& shader);
     void setFragmentShader(const std::string& shader);
     void setGeometryShader(const std::string& shader);
 
-    /// use the program
+    /// link the attached shaders once, the program constructed from a shader name is linked already
+    bool link();
+    bool isLinked() const { return m_linked; }
+    unsigned int id() const { return m_program; }
+
+    /// use the program, no gl call when it is already current
     void use();
     
-    /// set shader uniform value
-    void setUniform1i(const std::string& key, int value);
-    void setUniform1f(const std::string& key, float value);
-    void setUniform3f(const std::string& key, const glm::vec3& value);
-    void setUniform3f(const std::string& key, float x, float y, float z);
-    void setUniformMatrix4fv(const std::string& key, const glm::mat4& value);
-    void setUniformMatrix4fv(const std::string& key, const std::vector<glm::mat4>& value);
+    /// resolve a uniform to its location handle, the first call per name queries gl.
+    /// -1 when the program has no such active uniform, setting it is then a no-op
+    GLint location(const UniformName& name);
+
+    /// set shader uniform value by name
+    void setUniform1i(const UniformName& name, int value) { setUniform1i(location(name), value); }
+    void setUniform1f(const UniformName& name, float value) { setUniform1f(location(name), value); }
+    void setUniform3f(const UniformName& name, const glm::vec3& value) { setUniform3f(location(name), value); }
+    void setUniform3f(const UniformName& name, float x, float y, float z) { setUniform3f(location(name), x, y, z); }
+    void setUniformMatrix4fv(const UniformName& name, const glm::mat4& value) { setUniformMatrix4fv(location(name), value); }
+    void setUniformMatrix4fv(const UniformName& name, const std::vector<glm::mat4>& value) { setUniformMatrix4fv(location(name), value); }
+
+    /// set shader uniform value by location handle
+    void setUniform1i(GLint location, int value);
+    void setUniform1f(GLint location, float value);
+    void setUniform3f(GLint location, const glm::vec3& value);
+    void setUniform3f(GLint location, float x, float y, float z);
+    void setUniformMatrix4fv(GLint location, const glm::mat4& value);
+    void setUniformMatrix4fv(GLint location, const std::vector<glm::mat4>& value);
+
     void setUniformSpotLights(const std::vector<PointLight*>& spotLights);
     void setUniformFlashLight(const std::vector<FlashLight*>& flashLights);
+
+    /// close the frame of the uniform counters, call once per frame
+    static void endFrame();
+
+    /// counters of the last completed frame, over all programs
+    static const UniformStats& frameStats() { return s_lastFrameStats; }
     
 private:
     
-    GLuint getLocation(const std::string& param);
-    
     std::string loadShader(const std::string& file_name);
+    static std::string addDefines(const std::string& source, const std::vector<std::string>& defines);
+
+    void attachShader(unsigned int type, const std::string& shader);
+
+    /// compare with the last value sent to location and remember the new one,
+    /// false when the value is unchanged and the gl call can be skipped
+    bool changed(GLint location, const void* value, size_t size);
     
     /// create shader and compile
     /// - Parameters:
@@ -57,8 +120,23 @@ private:
     
 private:
     unsigned int m_program;
-    
-    std::map<std::string, unsigned int> m_mapUniformLoc;
+    bool m_linked;
+
+    /// shaders attached but not linked yet
+    std::vector<unsigned int> m_shaders;
+
+    /// uniform locations keyed by name hash
+    std::unordered_map<uint64_t, GLint> m_uniformLocations;
+#ifndef NDEBUG
+    /// name behind every cached hash, debug builds assert that two names never share one
+    std::unordered_map<uint64_t, std::string> m_uniformNames;
+#endif
+
+    /// last value sent to each location, uniforms keep their value in the program across use()
+    std::vector<std::vector<unsigned char>> m_uniformShadows;
+
+    static UniformStats s_frameStats;
+    static UniformStats s_lastFrameStats;
 };
 
 #endif /* program_h */
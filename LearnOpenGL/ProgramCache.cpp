@@ -0,0 +1,165 @@
+//
+//  ProgramCache.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "ProgramCache.h"
+#include "GLExt.h"
+#include "Hash.h"
+#include "System.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    const char MAGIC[4] = {'L', 'G', 'P', 'B'};
+
+    uint64_t hashString(const char* string, uint64_t hash)
+    {
+        if (string == nullptr)
+        {
+            return hash;
+        }
+        // the length separates neighbouring strings, "ab" + "c" must not match "a" + "bc"
+        uint64_t length = strlen(string);
+        hash = Hash::fnv1a64(&length, sizeof(length), hash);
+        return Hash::fnv1a64(string, (size_t)length, hash);
+    }
+}
+
+bool ProgramCache::isSupported()
+{
+    return GLExt::hasProgramBinary();
+}
+
+uint64_t ProgramCache::key(const std::vector<std::string>& sources)
+{
+    uint64_t hash = Hash::fnv1a64(&VERSION, sizeof(VERSION));
+    for (const std::string& source : sources)
+    {
+        hash = hashString(source.c_str(), hash);
+    }
+    hash = hashString((const char*)glGetString(GL_VENDOR), hash);
+    hash = hashString((const char*)glGetString(GL_RENDERER), hash);
+    hash = hashString((const char*)glGetString(GL_VERSION), hash);
+    return hash;
+}
+
+std::string ProgramCache::cachePath(const std::string& name)
+{
+    return System::cachePathWithFile("programs/" + name + ".progbin");
+}
+
+void ProgramCache::prepare(GLuint program)
+{
+    if (isSupported())
+    {
+        GLExt::glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+bool ProgramCache::load(const std::string& cacheFile, uint64_t key, GLuint program)
+{
+    if (!isSupported())
+    {
+        return false;
+    }
+
+    std::ifstream file(cacheFile, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    CacheHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || header.key != key || header.length == 0)
+    {
+        return false;
+    }
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+    {
+        return false;
+    }
+
+    // the driver may still reject the binary, e.g. after an update that kept the version string
+    GLExt::glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    return linkStatus == GL_TRUE;
+}
+
+bool ProgramCache::save(const std::string& cacheFile, uint64_t key, GLuint program)
+{
+    if (!isSupported())
+    {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return false;
+    }
+
+    CacheHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    GLExt::glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+    {
+        return false;
+    }
+    header.format = format;
+    header.length = (uint32_t)written;
+
+    std::filesystem::path path(cacheFile);
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    // same as the mesh cache, never leave a half written file under the final name
+    std::string tempFile = cacheFile + ".tmp";
+    {
+        std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "Failed to write program cache " << cacheFile << std::endl;
+            return false;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), written);
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempFile, cacheFile, error);
+    if (error)
+    {
+        std::filesystem::remove(tempFile, error);
+        return false;
+    }
+    return true;
+}
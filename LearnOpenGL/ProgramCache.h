@@ -0,0 +1,44 @@
+//
+//  ProgramCache.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef ProgramCache_h
+#define ProgramCache_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+/// on-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+/// a binary is only valid for the exact sources and driver that produced it, so the key mixes
+/// the shader sources with the vendor, renderer and version strings. any mismatch or a binary
+/// the driver rejects falls back to compiling from source
+namespace ProgramCache
+{
+    /// bump when the file layout changes
+    const uint32_t VERSION = 1;
+
+    /// requires GLExt::load
+    bool isSupported();
+
+    /// hash of the shader sources of all stages and of the current driver
+    uint64_t key(const std::vector<std::string>& sources);
+
+    /// cache file location of a program, one file per program name
+    std::string cachePath(const std::string& name);
+
+    /// ask the driver to keep the binary retrievable, call before linking
+    void prepare(GLuint program);
+
+    /// load the binary into the program, returns false when missing, stale or rejected
+    bool load(const std::string& cacheFile, uint64_t key, GLuint program);
+
+    /// store the binary of a linked program
+    bool save(const std::string& cacheFile, uint64_t key, GLuint program);
+}
+
+#endif /* ProgramCache_h */
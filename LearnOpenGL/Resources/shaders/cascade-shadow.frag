@@ -0,0 +1,10 @@
+// Cascaded Shadow Fragment Shader
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+
+void main()
+{
+    // orthographic depth is linear already, the lighting shader compares against the projected depth
+}
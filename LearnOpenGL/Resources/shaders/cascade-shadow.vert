@@ -0,0 +1,38 @@
+// Cascaded Shadow Vertex Shader, one pass per cascade and layered paths
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+#ifdef LAYERED
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
+layout(location = 0) in vec3 aPosition;
+
+uniform mat4 model;
+
+// packed meshes store positions as 16 bit unorm inside a box, float ones keep these defaults
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
+
+#ifdef LAYERED
+// light space projection of every cascade
+uniform mat4 cascadeMatrices[4];
+// cascades the instances of this draw go to, 4 bits each, the cascades the mesh was culled against on the cpu
+uniform int layers;
+#else
+// light space projection of the cascade being rendered
+uniform mat4 cascadeMatrix;
+#endif
+
+void main()
+{
+    vec4 position = model * vec4(aPosition * positionScale + positionBias, 1.0);
+#ifdef LAYERED
+    int cascade = (layers >> (4 * gl_InstanceID)) & 15;
+    gl_Layer = cascade;
+    gl_Position = cascadeMatrices[cascade] * position;
+#else
+    gl_Position = cascadeMatrix * position;
+#endif
+}
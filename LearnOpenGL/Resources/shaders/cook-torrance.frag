@@ -24,16 +24,68 @@ struct Material
 uniform Material material;
 
 // Դ
+// ÿ֡,  UniformBuffer.h е FrameConstants һ
+layout(std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 project;
+    vec3 viewPos;           // ӽλ
+    float time;
+};
+
+// Դб,  UniformBuffer.h е LightConstants һ
+#define MAX_POINT_LIGHTS 8
+#define MAX_SPOT_LIGHTS 4
+#define MAX_DIRECTIONAL_LIGHTS 2
+#define MAX_CASCADES 4
+// Ӱͼ,  UniformBuffer.h е ShadowMaps һ
+#define SHADOW_NONE -1
+#define SHADOW_CUBE 0
+#define SHADOW_ATLAS 1
+#define SHADOW_CASCADES 2
 struct PointLight
 {
     vec3 position;
+    float intensity;
+    vec3 color;
+    int shadowMap;          // Ӱͼ, SHADOW_NONE ʾͶӰ
+    float range;            // ䷶Χ, ˥ｵ 0
+    int shadowIndex;        // ӰͼйԴݵ
+};
+struct SpotLight
+{
+    vec3 position;
+    float intensity;
+    vec3 direction;
+    float cutOff;           // ׶ǵ
     vec3 color;
+    float outerCutOff;      // ׶ǵ
+    int shadowMap;          // SHADOW_NONE  SHADOW_ATLAS
+    int shadowIndex;        // ӰͼйԴݵ
+    float range;
+};
+struct DirectionalLight
+{
+    vec3 direction;         // ߴķ
     float intensity;
+    vec3 color;
+    int shadowMap;          // SHADOW_NONE  SHADOW_CASCADES
+    int cascadeCount;
+    vec4 cascadeSplits;     // ÿһͼ
+    vec4 cascadeTexels;     // ÿһһصߴ
+    mat4 cascadeMatrices[MAX_CASCADES];     // ÿһԴӽǵͶӰ
+};
+layout(std140) uniform Lights
+{
+    int pointLightCount;
+    int spotLightCount;
+    int directionalLightCount;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+    DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
 };
-uniform PointLight pointLight;
 
 // ̬
-uniform vec3 viewPos;       // ӽλ
 uniform vec3 albedo;        // ɫ
 uniform float metallic;     //  (0.0 ~ 1.0)
 uniform float roughness;    // ֲڶ (0.0 ~ 1.0)
@@ -41,6 +93,176 @@ uniform float ao;           // 
                             // 0.0ȫڱΣûл⣨ܰ
                             // 1.0ȫ¶ȫյ⣨
 
+// ԴӰ: ͼ浽ԴԾ / pointShadowFar, ȱȽϲ
+uniform samplerCubeShadow pointShadowMap;
+uniform float pointShadowFar;
+uniform float pointShadowTexel;     // Դλ봦һصĴС
+
+// Ԥ˲Ӱ: 밴ָ任ľؾģ mipmap, һԲ PCF
+//  PointShadow::Filter һ, ָ shadow-moments.frag һ
+#define SHADOW_FILTER_PCF 0
+#define SHADOW_FILTER_ESM 1
+#define SHADOW_FILTER_EVSM 2
+#define ESM_EXPONENT 80.0
+#define EVSM_POSITIVE_EXPONENT 40.0
+#define EVSM_NEGATIVE_EXPONENT 5.0
+uniform int pointShadowFilter;
+uniform samplerCube pointShadowMoments;
+
+// бѩ򲻵ʽܹ, ȥ 0.2 µĲԼ©
+float Chebyshev(vec2 moments, float depth, float exponent)
+{
+    if (depth <= moments.x)
+    {
+        return 1.0;
+    }
+    float minVariance = 1e-4 * exponent * abs(depth);
+    float variance = max(moments.y - moments.x * moments.x, minVariance * minVariance);
+    float d = depth - moments.x;
+    float p = variance / (variance + d * d);
+    return clamp((p - 0.2) / 0.8, 0.0, 1.0);
+}
+
+float PointShadow(vec3 lightPosition, vec3 N)
+{
+    // طƫ, Ӱ (shadow acne)
+    vec3 toFrag = fs_in.fragPos - lightPosition;
+    vec3 direction = toFrag + N * (length(toFrag) * pointShadowTexel * 2.0);
+    float depth = length(direction) / pointShadowFar;
+    if (pointShadowFilter == SHADOW_FILTER_ESM)
+    {
+        float occluder = texture(pointShadowMoments, direction).r;
+        return clamp(occluder * exp(-ESM_EXPONENT * depth), 0.0, 1.0);
+    }
+    if (pointShadowFilter == SHADOW_FILTER_EVSM)
+    {
+        vec4 moments = texture(pointShadowMoments, direction);
+        float positive = Chebyshev(moments.xy, exp(EVSM_POSITIVE_EXPONENT * depth), EVSM_POSITIVE_EXPONENT);
+        float negative = Chebyshev(moments.zw, -exp(-EVSM_NEGATIVE_EXPONENT * depth), EVSM_NEGATIVE_EXPONENT);
+        return min(positive, negative);
+    }
+    return texture(pointShadowMap, vec4(direction, depth));
+}
+
+// Ӱͼ: ԴӰͼһͼ, ͼһԾ
+// ÿӰĹԴռ 8  texel,  ShadowAtlas::RECORD_TEXELS һ:
+// ͼ 0  uv ƫ, ͼ uv ߴ 1 Ӧľ; ͼ 1-5  uv ƫһ, ۹ƾԴλ봦һصĴС;
+// ۹ƹԴӽͶӰ
+#define SHADOW_RECORD_TEXELS 8
+uniform sampler2DShadow shadowAtlas;
+uniform float shadowAtlasTexel;     // ͼһص uv ߴ
+uniform samplerBuffer shadowAtlasLights;
+
+// ͼһͼڲ, uv ս, Թ˲ڵͼ
+float AtlasShadow(vec2 offset, float tileSize, vec2 uv, float depth)
+{
+    float border = 0.5 * shadowAtlasTexel / tileSize;
+    uv = clamp(uv, vec2(border), vec2(1.0 - border));
+    return texture(shadowAtlas, vec3(offset + uv * tileSize, depth));
+}
+
+float PointAtlasShadow(int index, vec3 lightPosition, vec3 N)
+{
+    // 90 ȵ, Դλ봦һΪ 2 / 
+    int record = index * SHADOW_RECORD_TEXELS;
+    vec4 tile = texelFetch(shadowAtlasLights, record);
+    vec3 toFrag = fs_in.fragPos - lightPosition;
+    float texel = 2.0 * shadowAtlasTexel / tile.z;
+    vec3 d = toFrag + N * (length(toFrag) * texel * 2.0);
+
+    // ͼĹѡ, Ⱦʱͼһ
+    vec3 a = abs(d);
+    int face;
+    vec2 uv;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = d.x > 0.0 ? 0 : 1;
+        uv = vec2(d.x > 0.0 ? -d.z : d.z, -d.y) / a.x;
+    }
+    else if (a.y >= a.z)
+    {
+        face = d.y > 0.0 ? 2 : 3;
+        uv = vec2(d.x, d.y > 0.0 ? d.z : -d.z) / a.y;
+    }
+    else
+    {
+        face = d.z > 0.0 ? 4 : 5;
+        uv = vec2(d.z > 0.0 ? d.x : -d.x, -d.y) / a.z;
+    }
+    vec2 offset = tile.xy;
+    if (face > 0)
+    {
+        vec4 offsets = texelFetch(shadowAtlasLights, record + (face + 1) / 2);
+        offset = face % 2 == 1 ? offsets.xy : offsets.zw;
+    }
+    return AtlasShadow(offset, tile.z, uv * 0.5 + 0.5, length(d) / tile.w);
+}
+
+float SpotAtlasShadow(int index, vec3 lightPosition, vec3 N)
+{
+    int record = index * SHADOW_RECORD_TEXELS;
+    vec4 tile = texelFetch(shadowAtlasLights, record);
+    float texel = texelFetch(shadowAtlasLights, record + 3).z;
+    mat4 shadowMatrix = mat4(texelFetch(shadowAtlasLights, record + 4), texelFetch(shadowAtlasLights, record + 5),
+                             texelFetch(shadowAtlasLights, record + 6), texelFetch(shadowAtlasLights, record + 7));
+    vec3 toFrag = fs_in.fragPos - lightPosition;
+    vec3 d = toFrag + N * (length(toFrag) * texel * 2.0);
+    vec4 position = shadowMatrix * vec4(lightPosition + d, 1.0);
+    if (position.w <= 0.0)
+    {
+        return 1.0;
+    }
+    vec2 uv = position.xy / position.w * 0.5 + 0.5;
+    return AtlasShadow(tile.xy, tile.z, uv, length(d) / tile.w);
+}
+
+// ִع: ׶ĻֿͶȷƬгɴ, ƬԪֻڴеĵԴ;۹
+// GLSL 4.1 û SSBO, Դ, غ͹Դб,  LightClusters һ
+#define CLUSTER_LIGHT_POINT 0
+#define CLUSTER_LIGHT_SPOT 1
+uniform bool clusteredLights;
+uniform samplerBuffer clusterLights;        // ÿԴ 4  texel: λúͷΧ, Ⱥ, Ӱ, ׶ǺӰͼ
+uniform usamplerBuffer clusterRanges;       // ÿصĹԴб clusterIndices еƫƺ
+uniform usamplerBuffer clusterIndices;
+uniform vec3 clusterCounts;                 // ֿ, ȷƬ
+uniform vec3 clusterScale;                  // صֿ, log() Ƭ
+uniform float clusterBias;
+
+// ļӰ: ͼѡ, ÿһеһͼ
+uniform sampler2DArrayShadow cascadeShadowMap;
+
+float CascadeShadow(DirectionalLight light, int cascade, vec3 N)
+{
+    // طƫ, Ӱ (shadow acne)
+    vec3 position = fs_in.fragPos + N * (light.cascadeTexels[cascade] * 2.0);
+    vec3 p = (light.cascadeMatrices[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    return texture(cascadeShadowMap, vec4(p.xy, float(cascade), p.z));
+}
+
+float DirectionalShadow(DirectionalLight light, vec3 N)
+{
+    float depth = -(view * vec4(fs_in.fragPos, 1.0)).z;
+    float start = 0.0;
+    for (int i = 0; i < light.cascadeCount; ++i)
+    {
+        float end = light.cascadeSplits[i];
+        if (depth < end)
+        {
+            // ÿһ 10% һ, 紦ֱʲͻ. һûӰ
+            float shadow = CascadeShadow(light, i, N);
+            float band = 0.1 * (end - start);
+            float blend = (depth - (end - band)) / band;
+            if (blend > 0.0)
+            {
+                float next = i + 1 < light.cascadeCount ? CascadeShadow(light, i + 1, N) : 1.0;
+                shadow = mix(shadow, next, blend);
+            }
+            return shadow;
+        }
+        start = end;
+    }
+    return 1.0;
+}
 
 vec3 FresnelSchlick(float cosTheta, vec3 F0)
 {
@@ -76,17 +298,11 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
     return ggx1 * ggx2;
 }
 
-void main()
+//  L ϵķ radiance  BRDF  V Ĳ
+vec3 CookTorrance(vec3 L, vec3 radiance, vec3 N, vec3 V)
 {
-    vec3 N = normalize(fs_in.normal);
-    vec3 V = normalize(viewPos - fs_in.fragPos);
-    vec3 L = normalize(pointLight.position - fs_in.fragPos);
     vec3 H = normalize(V + L);
 
-    float distance = length(pointLight.position - fs_in.fragPos);
-    float attenuation = 1.0 / (distance * distance);
-    vec3 radiance = pointLight.color * pointLight.intensity * attenuation;
-
     // Fresnel
     vec3 F0 = vec3(0.04); // ǽĬϷ
     F0 = mix(F0, albedo, metallic);
@@ -105,7 +321,142 @@ void main()
     kD *= 1.0 - metallic;
 
     float NdotL = max(dot(N, L), 0.0);
-    vec3 Lo = (kD * albedo / PI + specular) * radiance * NdotL;
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+// ƽ˥, ䷶Χƽؽ 0, ĹԴӲ
+float Attenuation(float distance, float range)
+{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance);
+}
+
+// ׶֮ƽ˥ 0
+float SpotCone(vec3 L, vec3 direction, float cutOff, float outerCutOff)
+{
+    float theta = dot(L, normalize(-direction));
+    return clamp((theta - outerCutOff) / (cutOff - outerCutOff), 0.0, 1.0);
+}
+
+float PointLightShadow(int shadowMap, int shadowIndex, vec3 lightPosition, vec3 N)
+{
+    if (shadowMap == SHADOW_CUBE)
+    {
+        return PointShadow(lightPosition, N);
+    }
+    if (shadowMap == SHADOW_ATLAS)
+    {
+        return PointAtlasShadow(shadowIndex, lightPosition, N);
+    }
+    return 1.0;
+}
+
+float SpotLightShadow(int shadowMap, int shadowIndex, vec3 lightPosition, vec3 N)
+{
+    return shadowMap == SHADOW_ATLAS ? SpotAtlasShadow(shadowIndex, lightPosition, N) : 1.0;
+}
+
+vec3 PointLightRadiance(PointLight light, vec3 N, vec3 V)
+{
+    vec3 L = normalize(light.position - fs_in.fragPos);
+    float distance = length(light.position - fs_in.fragPos);
+    vec3 radiance = light.color * light.intensity * Attenuation(distance, light.range);
+    radiance *= PointLightShadow(light.shadowMap, light.shadowIndex, light.position, N);
+    return CookTorrance(L, radiance, N, V);
+}
+
+vec3 SpotLightRadiance(SpotLight light, vec3 N, vec3 V)
+{
+    vec3 L = normalize(light.position - fs_in.fragPos);
+    float cone = SpotCone(L, light.direction, light.cutOff, light.outerCutOff);
+    float distance = length(light.position - fs_in.fragPos);
+    vec3 radiance = light.color * light.intensity * cone * Attenuation(distance, light.range);
+    if (cone > 0.0)
+    {
+        radiance *= SpotLightShadow(light.shadowMap, light.shadowIndex, light.position, N);
+    }
+    return CookTorrance(L, radiance, N, V);
+}
+
+// еĵ index Դ
+vec3 ClusteredLightRadiance(int index, vec3 N, vec3 V)
+{
+    vec4 positionRange = texelFetch(clusterLights, 4 * index);
+    vec4 radianceType = texelFetch(clusterLights, 4 * index + 1);
+    vec4 directionShadow = texelFetch(clusterLights, 4 * index + 2);
+    vec3 toLight = positionRange.xyz - fs_in.fragPos;
+    float distance = length(toLight);
+    vec3 L = toLight / distance;
+    vec4 cone = texelFetch(clusterLights, 4 * index + 3);
+    vec3 radiance = radianceType.rgb * Attenuation(distance, positionRange.w);
+    int shadowMap = int(cone.z);
+    int shadowIndex = int(directionShadow.w);
+    if (int(radianceType.w) == CLUSTER_LIGHT_SPOT)
+    {
+        radiance *= SpotCone(L, directionShadow.xyz, cone.x, cone.y);
+        if (shadowMap != SHADOW_NONE && any(greaterThan(radiance, vec3(0.0))))
+        {
+            radiance *= SpotLightShadow(shadowMap, shadowIndex, positionRange.xyz, N);
+        }
+    }
+    else if (shadowMap != SHADOW_NONE)
+    {
+        radiance *= PointLightShadow(shadowMap, shadowIndex, positionRange.xyz, N);
+    }
+    return CookTorrance(L, radiance, N, V);
+}
+
+// ƬԪڵĴ: ڵķֿ, ͼڵķƬ
+int Cluster()
+{
+    float depth = -(view * vec4(fs_in.fragPos, 1.0)).z;
+    vec3 cell = vec3(gl_FragCoord.xy * clusterScale.xy, log(depth) * clusterScale.z + clusterBias);
+    ivec3 counts = ivec3(clusterCounts);
+    ivec3 c = clamp(ivec3(floor(cell)), ivec3(0), counts - 1);
+    return (c.z * counts.y + c.y) * counts.x + c.x;
+}
+
+vec3 DirectionalLightRadiance(DirectionalLight light, vec3 N, vec3 V)
+{
+    vec3 L = normalize(-light.direction);
+    vec3 radiance = light.color * light.intensity;
+    if (light.shadowMap == SHADOW_CASCADES && dot(N, L) > 0.0)
+    {
+        radiance *= DirectionalShadow(light, N);
+    }
+    return CookTorrance(L, radiance, N, V);
+}
+
+void main()
+{
+    vec3 N = normalize(fs_in.normal);
+    vec3 V = normalize(viewPos - fs_in.fragPos);
+
+    vec3 Lo = vec3(0.0);
+    if (clusteredLights)
+    {
+        uvec2 range = texelFetch(clusterRanges, Cluster()).xy;
+        for (uint i = 0u; i < range.y; ++i)
+        {
+            Lo += ClusteredLightRadiance(int(texelFetch(clusterIndices, int(range.x + i)).r), N, V);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < pointLightCount; ++i)
+        {
+            Lo += PointLightRadiance(pointLights[i], N, V);
+        }
+        for (int i = 0; i < spotLightCount; ++i)
+        {
+            Lo += SpotLightRadiance(spotLights[i], N, V);
+        }
+    }
+    for (int i = 0; i < directionalLightCount; ++i)
+    {
+        Lo += DirectionalLightRadiance(directionalLights[i], N, V);
+    }
 
     // Ambient (no IBL)
     vec3 ambient = vec3(0.03) * albedo * ao;
@@ -0,0 +1,9 @@
+// Depth Fragment Shader
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+
+void main()
+{
+}
@@ -0,0 +1,28 @@
+// Depth Vertex Shader
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+layout(location = 0) in vec3 aPosition;
+
+layout(std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 project;
+    vec3 viewPos;
+    float time;
+};
+
+uniform mat4 model;
+
+// packed meshes store positions as 16 bit unorm inside a box, float ones keep these defaults
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
+
+// the color pass after a prepass tests against this depth with GL_LEQUAL, both have to compute it bit for bit alike
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = project * view * model * vec4(aPosition * positionScale + positionBias, 1.0);
+}
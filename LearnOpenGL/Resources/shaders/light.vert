@@ -7,14 +7,32 @@ layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTextCoord;
 
+layout(std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 project;
+    vec3 viewPos;
+    float time;
+};
+
+#ifdef INSTANCED
+// per-instance model matrix, one column per location 4-7
+layout(location = 4) in mat4 aInstanceModel;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 project;
+#endif
+
+// packed meshes store positions as 16 bit unorm inside a box, float ones keep these defaults
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
     //gl_Position = project * view * model * vec4(aPosition, 1.0);
 
     vec3 Normal = mat3(transpose(inverse(model))) * aNormal;
-    gl_Position = project * view * model * vec4(aPosition, 1.0);
+    gl_Position = project * view * model * vec4(aPosition * positionScale + positionBias, 1.0);
 }
@@ -0,0 +1,69 @@
+// Shadow Moments Fragment Shader, separable 5 tap blur of warped shadow depths
+//
+// Created by asi on 2026/10/18.
+//
+// the horizontal pass reads one face of the distance cube map and warps every tap before weighting it,
+// ESM or EVSM. the VERTICAL pass blurs the result of the horizontal one
+
+#version 410 core
+out vec4 moments;
+
+// keep in sync with cook-torrance.frag, exp(80) still fits a 32 bit float
+#define ESM_EXPONENT 80.0
+#define EVSM_POSITIVE_EXPONENT 40.0
+#define EVSM_NEGATIVE_EXPONENT 5.0
+
+const float weights[5] = float[](1.0, 4.0, 6.0, 4.0, 1.0);
+
+#ifdef VERTICAL
+uniform sampler2D source;
+#else
+// read without depth comparison
+uniform samplerCube depthMap;
+uniform int face;
+uniform float size;
+
+// direction through the face GL_TEXTURE_CUBE_MAP_POSITIVE_X + face at st in [-1, 1]
+vec3 FaceDirection(vec2 st)
+{
+    switch (face)
+    {
+    case 0: return vec3(1.0, -st.y, -st.x);
+    case 1: return vec3(-1.0, -st.y, st.x);
+    case 2: return vec3(st.x, 1.0, st.y);
+    case 3: return vec3(st.x, -1.0, -st.y);
+    case 4: return vec3(st.x, -st.y, 1.0);
+    default: return vec3(-st.x, -st.y, -1.0);
+    }
+}
+
+vec4 Warp(float depth)
+{
+#ifdef ESM
+    return vec4(exp(ESM_EXPONENT * depth), 0.0, 0.0, 0.0);
+#else
+    float positive = exp(EVSM_POSITIVE_EXPONENT * depth);
+    float negative = -exp(-EVSM_NEGATIVE_EXPONENT * depth);
+    return vec4(positive, positive * positive, negative, negative * negative);
+#endif
+}
+#endif
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 sum = vec4(0.0);
+    for (int i = -2; i <= 2; ++i)
+    {
+#ifdef VERTICAL
+        ivec2 tap = clamp(texel + ivec2(0, i), ivec2(0), textureSize(source, 0) - 1);
+        sum += weights[i + 2] * texelFetch(source, tap, 0);
+#else
+        // texel centres of the face, the taps stay inside it
+        float x = clamp(float(texel.x + i), 0.0, size - 1.0) + 0.5;
+        vec2 st = vec2(x, gl_FragCoord.y) / size * 2.0 - 1.0;
+        sum += weights[i + 2] * Warp(texture(depthMap, FaceDirection(st)).r);
+#endif
+    }
+    moments = sum / 16.0;
+}
@@ -0,0 +1,11 @@
+// Shadow Moments Vertex Shader, one triangle over the whole face
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,15 @@
+// Point Shadow Fragment Shader
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+in vec3 fragPos;
+
+uniform vec3 lightPos;
+uniform float far_plane;
+
+void main()
+{
+    // linear distance to the light in [0, 1], the lighting shader compares against the same
+    gl_FragDepth = min(length(fragPos - lightPos), far_plane) / far_plane;
+}
@@ -0,0 +1,48 @@
+// Point Shadow Vertex Shader
+// the geometry shader path hands world space to shadow.geom, CULLED_FACES and LAYERED project the faces themselves
+//
+// Created by asi on 2026/10/18.
+
+#version 410 core
+#ifdef LAYERED
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
+layout(location = 0) in vec3 aPosition;
+
+uniform mat4 model;
+
+// packed meshes store positions as 16 bit unorm inside a box, float ones keep these defaults
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
+
+#if defined(LAYERED)
+// view projection of every cube face
+uniform mat4 shadowMatrices[6];
+// faces the instances of this draw go to, 4 bits each, the faces the mesh was culled against on the cpu
+uniform int layers;
+#elif defined(CULLED_FACES)
+// view projection of the face being rendered
+uniform mat4 shadowMatrix;
+#endif
+
+#if defined(LAYERED) || defined(CULLED_FACES)
+out vec3 fragPos;
+#endif
+
+void main()
+{
+    vec4 position = model * vec4(aPosition * positionScale + positionBias, 1.0);
+#if defined(LAYERED)
+    fragPos = position.xyz;
+    int face = (layers >> (4 * gl_InstanceID)) & 15;
+    gl_Layer = face;
+    gl_Position = shadowMatrices[face] * position;
+#elif defined(CULLED_FACES)
+    fragPos = position.xyz;
+    gl_Position = shadowMatrix * position;
+#else
+    // world space, the geometry shader projects it once per cube face
+    gl_Position = position;
+#endif
+}
@@ -5,8 +5,13 @@
 #version 410 core
 layout(location = 0) in vec3 aPosition;
 
-uniform mat4 view;
-uniform mat4 project;
+layout(std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 project;
+    vec3 viewPos;
+    float time;
+};
 
 out vec3 textCoord;
 
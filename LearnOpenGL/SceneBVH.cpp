@@ -0,0 +1,482 @@
+//
+//  SceneBVH.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "SceneBVH.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace
+{
+    const int SAH_BINS = 16;
+    /// ranges this small always become leaves
+    const uint32_t MIN_LEAF_OBJECTS = 2;
+    /// ranges this large are always split, smaller ones only when SAH says so
+    const uint32_t MAX_LEAF_OBJECTS = 8;
+    /// cost of visiting a node relative to testing one object box
+    const float TRAVERSAL_COST = 1.f;
+    /// below this the pool costs more than it saves
+    const size_t PARALLEL_OBJECTS = 4096;
+    /// deeper than this ranges are halved at the median, which keeps every path under the query stack size
+    const uint32_t SAH_MAX_DEPTH = 24;
+    const int STACK_SIZE = 64;
+}
+
+SceneBVH::SceneBVH()
+    : m_built(0)
+{
+}
+
+void SceneBVH::clear()
+{
+    m_boxes.clear();
+    m_order.clear();
+    m_leafOf.clear();
+    m_nodes.clear();
+    m_dirty.clear();
+    m_built = 0;
+}
+
+uint32_t SceneBVH::add(const AABB& box)
+{
+    m_boxes.push_back(box);
+    return (uint32_t)m_boxes.size() - 1;
+}
+
+void SceneBVH::update(uint32_t object, const AABB& box)
+{
+    m_boxes[object] = box;
+    if (object < m_built)
+    {
+        m_dirty.push_back(m_leafOf[object]);
+    }
+}
+
+void SceneBVH::build(ThreadPool* pool)
+{
+    m_nodes.clear();
+    m_dirty.clear();
+    m_built = m_boxes.size();
+    uint32_t count = (uint32_t)m_boxes.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    m_order.resize(count);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    m_centroids.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        m_centroids[i] = m_boxes[i].center();
+    }
+
+    // the top levels are split here, the subtrees below go to the pool and are spliced in afterwards
+    std::vector<Subtree> deferred;
+    bool parallel = pool != nullptr && pool->size() > 1 && count >= PARALLEL_OBJECTS;
+    uint32_t splitLimit = parallel ? std::max<uint32_t>(count / (pool->size() * 4), 1024) : 0;
+    m_nodes.reserve(2 * count / MIN_LEAF_OBJECTS);
+    buildRange(m_nodes, -1, 0, count, 0, splitLimit, parallel ? &deferred : nullptr);
+
+    for (Subtree& subtree : deferred)
+    {
+        pool->submit([this, &subtree]() {
+            buildRange(subtree.nodes, -1, subtree.first, subtree.count, subtree.depth, 0, nullptr);
+        });
+    }
+    if (!deferred.empty())
+    {
+        pool->wait();
+    }
+    for (const Subtree& subtree : deferred)
+    {
+        splice(subtree);
+    }
+
+    m_leafOf.assign(count, -1);
+    for (int32_t i = 0; i < (int32_t)m_nodes.size(); ++i)
+    {
+        const Node& node = m_nodes[i];
+        for (uint32_t j = 0; j < node.count; ++j)
+        {
+            m_leafOf[m_order[node.first + j]] = i;
+        }
+    }
+}
+
+int32_t SceneBVH::buildRange(std::vector<Node>& nodes, int32_t parent, uint32_t first, uint32_t count, uint32_t depth, uint32_t splitLimit,
+                             std::vector<Subtree>* deferred)
+{
+    Node node;
+    node.bounds = AABB::empty();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        node.bounds.expand(m_boxes[m_order[first + i]]);
+    }
+    node.parent = parent;
+    node.left = -1;
+    node.right = -1;
+    node.first = first;
+    node.count = count;
+
+    int32_t index = (int32_t)nodes.size();
+    nodes.push_back(node);
+
+    if (deferred != nullptr && count <= splitLimit)
+    {
+        Subtree subtree;
+        subtree.placeholder = index;
+        subtree.first = first;
+        subtree.count = count;
+        subtree.depth = depth;
+        deferred->push_back(std::move(subtree));
+        return index;
+    }
+
+    uint32_t leftCount = count > MIN_LEAF_OBJECTS ? partition(first, count, node.bounds, depth >= SAH_MAX_DEPTH) : 0;
+    if (leftCount == 0)
+    {
+        return index;
+    }
+
+    // nodes may reallocate while the children are built, so no reference into it is held
+    nodes[index].count = 0;
+    int32_t left = buildRange(nodes, index, first, leftCount, depth + 1, splitLimit, deferred);
+    int32_t right = buildRange(nodes, index, first + leftCount, count - leftCount, depth + 1, splitLimit, deferred);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+uint32_t SceneBVH::partition(uint32_t first, uint32_t count, const AABB& bounds, bool median)
+{
+    uint32_t* begin = m_order.data() + first;
+    uint32_t* end = begin + count;
+
+    AABB centroidBounds = AABB::empty();
+    for (uint32_t* object = begin; object != end; ++object)
+    {
+        centroidBounds.expand(AABB{m_centroids[*object], m_centroids[*object]});
+    }
+    glm::vec3 size = centroidBounds.max - centroidBounds.min;
+    int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    float axisMin = centroidBounds.min[axis];
+    float axisSize = size[axis];
+
+    if (axisSize <= 0.f)
+    {
+        // every centroid in one spot, any split is as good as another
+        return count > MAX_LEAF_OBJECTS ? count / 2 : 0;
+    }
+    auto splitMedian = [&]() {
+        std::nth_element(begin, begin + count / 2, end, [&](uint32_t a, uint32_t b) {
+            return m_centroids[a][axis] < m_centroids[b][axis];
+        });
+        return count / 2;
+    };
+    if (median)
+    {
+        return count > MAX_LEAF_OBJECTS ? splitMedian() : 0;
+    }
+
+    auto binOf = [&](uint32_t object) {
+        int bin = (int)((m_centroids[object][axis] - axisMin) / axisSize * SAH_BINS);
+        return std::min(bin, SAH_BINS - 1);
+    };
+
+    AABB binBounds[SAH_BINS];
+    uint32_t binCounts[SAH_BINS] = {};
+    for (int i = 0; i < SAH_BINS; ++i)
+    {
+        binBounds[i] = AABB::empty();
+    }
+    for (uint32_t* object = begin; object != end; ++object)
+    {
+        int bin = binOf(*object);
+        binBounds[bin].expand(m_boxes[*object]);
+        binCounts[bin]++;
+    }
+
+    // sweep from the right for the area and count right of every plane, then from the left for the cost
+    float rightArea[SAH_BINS];
+    uint32_t rightCount[SAH_BINS];
+    AABB accumulated = AABB::empty();
+    uint32_t accumulatedCount = 0;
+    for (int i = SAH_BINS - 1; i > 0; --i)
+    {
+        accumulated.expand(binBounds[i]);
+        accumulatedCount += binCounts[i];
+        rightArea[i] = accumulated.surfaceArea();
+        rightCount[i] = accumulatedCount;
+    }
+
+    float bestCost = FLT_MAX;
+    int bestPlane = -1;
+    accumulated = AABB::empty();
+    accumulatedCount = 0;
+    for (int i = 1; i < SAH_BINS; ++i)
+    {
+        accumulated.expand(binBounds[i - 1]);
+        accumulatedCount += binCounts[i - 1];
+        if (accumulatedCount == 0 || rightCount[i] == 0)
+        {
+            continue;
+        }
+        float cost = accumulated.surfaceArea() * accumulatedCount + rightArea[i] * rightCount[i];
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestPlane = i;
+        }
+    }
+
+    float area = bounds.surfaceArea();
+    float leafCost = area * count;
+    float splitCost = TRAVERSAL_COST * area + bestCost;
+    if (count <= MAX_LEAF_OBJECTS && (bestPlane < 0 || splitCost >= leafCost))
+    {
+        return 0;
+    }
+    if (bestPlane < 0)
+    {
+        // all centroids in one bin, halve around the median instead
+        return splitMedian();
+    }
+
+    uint32_t* middle = std::partition(begin, end, [&](uint32_t object) {
+        return binOf(object) < bestPlane;
+    });
+    return (uint32_t)(middle - begin);
+}
+
+void SceneBVH::splice(const Subtree& subtree)
+{
+    // local node 0 takes the place of the placeholder, the others are appended
+    int32_t base = (int32_t)m_nodes.size();
+    auto global = [&](int32_t local) {
+        return local < 0 ? local : local == 0 ? subtree.placeholder : base + local - 1;
+    };
+
+    Node root = subtree.nodes[0];
+    root.parent = m_nodes[subtree.placeholder].parent;
+    root.left = global(root.left);
+    root.right = global(root.right);
+    m_nodes[subtree.placeholder] = root;
+
+    for (size_t i = 1; i < subtree.nodes.size(); ++i)
+    {
+        Node node = subtree.nodes[i];
+        node.parent = global(node.parent);
+        node.left = global(node.left);
+        node.right = global(node.right);
+        m_nodes.push_back(node);
+    }
+}
+
+void SceneBVH::refit()
+{
+    for (int32_t leaf : m_dirty)
+    {
+        for (int32_t index = leaf; index >= 0; index = m_nodes[index].parent)
+        {
+            Node& node = m_nodes[index];
+            AABB bounds = AABB::empty();
+            if (node.count > 0)
+            {
+                for (uint32_t i = 0; i < node.count; ++i)
+                {
+                    bounds.expand(m_boxes[m_order[node.first + i]]);
+                }
+            }
+            else
+            {
+                bounds = m_nodes[node.left].bounds;
+                bounds.expand(m_nodes[node.right].bounds);
+            }
+
+            // the nodes above are already up to date when this one did not change
+            bool changed = bounds.min != node.bounds.min || bounds.max != node.bounds.max;
+            node.bounds = bounds;
+            if (!changed && index != leaf)
+            {
+                break;
+            }
+        }
+    }
+    m_dirty.clear();
+}
+
+void SceneBVH::collect(int32_t node, std::vector<uint32_t>& objects) const
+{
+    const Node& current = m_nodes[node];
+    if (current.count > 0)
+    {
+        objects.insert(objects.end(), m_order.begin() + current.first, m_order.begin() + current.first + current.count);
+        return;
+    }
+    collect(current.left, objects);
+    collect(current.right, objects);
+}
+
+void SceneBVH::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    int32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        int32_t index = stack[--top];
+        const Node& node = m_nodes[index];
+        Frustum::Containment containment = frustum.classify(node.bounds);
+        if (containment == Frustum::OUTSIDE)
+        {
+            continue;
+        }
+        if (containment == Frustum::INSIDE)
+        {
+            collect(index, visible);
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; ++i)
+            {
+                uint32_t object = m_order[node.first + i];
+                if (frustum.intersects(m_boxes[object]))
+                {
+                    visible.push_back(object);
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.right;
+    }
+}
+
+bool SceneBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.f / direction;
+    float nearest = maxDistance;
+    bool found = false;
+
+    // nodes with the distance the ray enters them, the nearer child is popped first
+    struct Entry
+    {
+        int32_t node;
+        float distance;
+    };
+    Entry stack[STACK_SIZE];
+    int top = 0;
+    float rootDistance = m_nodes[0].bounds.rayDistance(origin, inverseDirection, nearest);
+    if (rootDistance != FLT_MAX)
+    {
+        stack[top++] = {0, rootDistance};
+    }
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+        if (entry.distance > nearest)
+        {
+            continue;
+        }
+        const Node& node = m_nodes[entry.node];
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; ++i)
+            {
+                uint32_t object = m_order[node.first + i];
+                float distance = m_boxes[object].rayDistance(origin, inverseDirection, nearest);
+                if (distance <= nearest)
+                {
+                    nearest = distance;
+                    hit.object = object;
+                    hit.distance = distance;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        float left = m_nodes[node.left].bounds.rayDistance(origin, inverseDirection, nearest);
+        float right = m_nodes[node.right].bounds.rayDistance(origin, inverseDirection, nearest);
+        Entry near = {node.left, left};
+        Entry far = {node.right, right};
+        if (right < left)
+        {
+            std::swap(near, far);
+        }
+        if (far.distance != FLT_MAX)
+        {
+            stack[top++] = far;
+        }
+        if (near.distance != FLT_MAX)
+        {
+            stack[top++] = near;
+        }
+    }
+    return found;
+}
+
+void SceneBVH::overlap(const BoundingSphere& sphere, std::vector<uint32_t>& objects) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    int32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = m_nodes[stack[--top]];
+        if (!node.bounds.intersects(sphere))
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; ++i)
+            {
+                uint32_t object = m_order[node.first + i];
+                if (m_boxes[object].intersects(sphere))
+                {
+                    objects.push_back(object);
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.right;
+    }
+}
+
+float SceneBVH::cost() const
+{
+    if (m_nodes.empty())
+    {
+        return 0.f;
+    }
+    float total = 0.f;
+    for (const Node& node : m_nodes)
+    {
+        total += node.bounds.surfaceArea() * (node.count > 0 ? (float)node.count : TRAVERSAL_COST);
+    }
+    return total / m_nodes[0].bounds.surfaceArea();
+}
@@ -0,0 +1,118 @@
+//
+//  SceneBVH.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef SceneBVH_h
+#define SceneBVH_h
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+class ThreadPool;
+
+/// nearest object hit by a ray
+struct RayHit
+{
+    uint32_t object;
+    float distance;
+};
+
+/// bounding volume hierarchy over the world boxes of scene objects (mesh instances).
+/// built top down with binned SAH, moved objects are refitted in place without a rebuild
+class SceneBVH
+{
+public:
+    SceneBVH();
+
+    /// forget every object and the tree
+    void clear();
+
+    /// new object, returns its id. it is found by queries after the next build()
+    uint32_t add(const AABB& box);
+
+    /// the object moved, the tree follows at the next refit()
+    void update(uint32_t object, const AABB& box);
+
+    const AABB& bounds(uint32_t object) const { return m_boxes[object]; }
+    size_t size() const { return m_boxes.size(); }
+
+    /// objects were added since the last build()
+    bool needsBuild() const { return m_built != m_boxes.size(); }
+
+    /// rebuild the tree over all objects. with a pool large subtrees are built on its threads,
+    /// the call returns when the tree is complete
+    void build(ThreadPool* pool = nullptr);
+
+    /// grow or shrink the nodes above the objects updated since the last refit, leaves the topology alone
+    /// so the tree gets looser as objects travel far; build() again then
+    void refit();
+
+    /// objects whose box is at least partly inside the frustum, appended to visible
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    /// nearest object box hit by origin + t * direction for 0 <= t <= maxDistance
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+
+    /// objects whose box touches the sphere, e.g. the meshes a point light reaches
+    void overlap(const BoundingSphere& sphere, std::vector<uint32_t>& objects) const;
+
+    /// surface area heuristic cost of the tree: expected node and object tests of a random ray,
+    /// testing every object costs size()
+    float cost() const;
+
+    size_t nodeCount() const { return m_nodes.size(); }
+
+private:
+    /// leaf when count > 0, holding m_order[first, first + count), otherwise children left and right
+    struct Node
+    {
+        AABB bounds;
+        int32_t parent;
+        int32_t left;
+        int32_t right;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    /// a subtree left to a pool thread, built into its own nodes and spliced in at placeholder
+    struct Subtree
+    {
+        int32_t placeholder;
+        uint32_t first;
+        uint32_t count;
+        uint32_t depth;
+        std::vector<Node> nodes;
+    };
+
+    /// build the subtree over m_order[first, first + count) into nodes, returns its root.
+    /// ranges of at most splitLimit objects become entries of deferred instead when it is given
+    int32_t buildRange(std::vector<Node>& nodes, int32_t parent, uint32_t first, uint32_t count, uint32_t depth, uint32_t splitLimit,
+                       std::vector<Subtree>* deferred);
+
+    /// binned SAH split of m_order[first, first + count), or a median split, returns the size of the left part, 0 for a leaf
+    uint32_t partition(uint32_t first, uint32_t count, const AABB& bounds, bool median);
+
+    void splice(const Subtree& subtree);
+
+    /// append every object below node, no tests
+    void collect(int32_t node, std::vector<uint32_t>& objects) const;
+
+private:
+    std::vector<AABB> m_boxes;
+    std::vector<glm::vec3> m_centroids;
+    /// object ids in leaf order
+    std::vector<uint32_t> m_order;
+    /// leaf node of every object
+    std::vector<int32_t> m_leafOf;
+    std::vector<Node> m_nodes;
+    /// leaves holding objects updated since the last refit
+    std::vector<int32_t> m_dirty;
+    size_t m_built;
+};
+
+#endif /* SceneBVH_h */
@@ -0,0 +1,527 @@
+//
+//  ShadowAtlas.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "ShadowAtlas.h"
+#include "GLState.h"
+#include "Model.h"
+#include "Program.h"
+#include <algorithm>
+#include <cfloat>
+#include <glm/gtc/matrix_transform.hpp>
+
+/// casters closer to the light than this are clipped
+static const float NEAR_PLANE = 0.05f;
+
+namespace Uniforms
+{
+    constexpr UniformName model("model");
+    constexpr UniformName lightPos("lightPos");
+    constexpr UniformName farPlane("far_plane");
+    constexpr UniformName shadowMatrix("shadowMatrix");
+}
+
+ShadowAtlas::ShadowAtlas()
+    : m_depthMap(0), m_framebuffer(0), m_size(0), m_maxTileLevel(0), m_minTileLevel(0), m_firstSlot(0), m_slotBlocks(0), m_frame(0)
+{
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+    GLState::deleteTextures(1, &m_depthMap);
+    glDeleteFramebuffers(1, &m_framebuffer);
+}
+
+void ShadowAtlas::create(GLsizei size, GLsizei maxTile, GLsizei minTile, unsigned int firstSlot)
+{
+    m_size = size;
+    m_firstSlot = firstSlot;
+    m_maxTileLevel = 0;
+    while ((size >> m_maxTileLevel) > maxTile)
+    {
+        m_maxTileLevel++;
+    }
+    m_minTileLevel = m_maxTileLevel;
+    while ((size >> (m_minTileLevel + 1)) >= minTile)
+    {
+        m_minTileLevel++;
+    }
+    m_freeTiles.assign(m_minTileLevel + 1, {});
+    m_freeTiles[0].push_back(glm::ivec2(0));
+
+    // the same distance encoding and comparison as the cube maps of PointShadow
+    glGenTextures(1, &m_depthMap);
+    GLState::bindTexture(GL_TEXTURE_2D, m_depthMap);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthMap, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    m_program.reset(new Program("shadow", {"CULLED_FACES", Program::NO_GEOMETRY_SHADER}));
+    m_lightBuffer.create(GL_RGBA32F);
+}
+
+float ShadowAtlas::screenSize(const ShadowLight& light, const DrawView& camera)
+{
+    BoundingSphere reach = {light.position, light.reach()};
+    if (!camera.frustum.intersects(reach))
+    {
+        return 0.f;
+    }
+    float distance = glm::length(reach.center - camera.eye);
+    if (distance <= reach.radius)
+    {
+        return FLT_MAX;
+    }
+    // the sphere's silhouette, tangent from the eye
+    return 2.f * reach.radius * camera.pixelsPerUnit / glm::sqrt(distance * distance - reach.radius * reach.radius);
+}
+
+int ShadowAtlas::levelFor(float texels) const
+{
+    int level = m_maxTileLevel;
+    while (level < m_minTileLevel && (float)(m_size >> (level + 1)) >= texels)
+    {
+        level++;
+    }
+    return level;
+}
+
+bool ShadowAtlas::allocate(int level, glm::ivec2& tile)
+{
+    // split the smallest free tile that is large enough, the quarters not handed out become free
+    int from = level;
+    while (from >= 0 && m_freeTiles[from].empty())
+    {
+        from--;
+    }
+    if (from < 0)
+    {
+        return false;
+    }
+    tile = m_freeTiles[from].back();
+    m_freeTiles[from].pop_back();
+    while (from < level)
+    {
+        from++;
+        GLsizei half = m_size >> from;
+        m_freeTiles[from].push_back(tile + glm::ivec2(half, half));
+        m_freeTiles[from].push_back(tile + glm::ivec2(0, half));
+        m_freeTiles[from].push_back(tile + glm::ivec2(half, 0));
+    }
+    return true;
+}
+
+void ShadowAtlas::release(int level, const glm::ivec2& tile)
+{
+    // merge with the three other quarters of the parent when they are all free
+    if (level > 0)
+    {
+        GLsizei tileSize = m_size >> level;
+        glm::ivec2 parent = tile - tile % (tileSize * 2);
+        std::vector<glm::ivec2>& free = m_freeTiles[level];
+        std::vector<size_t> siblings;
+        for (const glm::ivec2& corner : {glm::ivec2(0, 0), glm::ivec2(1, 0), glm::ivec2(0, 1), glm::ivec2(1, 1)})
+        {
+            glm::ivec2 sibling = parent + corner * tileSize;
+            if (sibling == tile)
+            {
+                continue;
+            }
+            auto found = std::find(free.begin(), free.end(), sibling);
+            if (found == free.end())
+            {
+                break;
+            }
+            siblings.push_back(found - free.begin());
+        }
+        if (siblings.size() == 3)
+        {
+            std::sort(siblings.begin(), siblings.end());
+            for (auto index = siblings.rbegin(); index != siblings.rend(); ++index)
+            {
+                free.erase(free.begin() + *index);
+            }
+            release(level - 1, parent);
+            return;
+        }
+    }
+    m_freeTiles[level].push_back(tile);
+}
+
+void ShadowAtlas::releaseTiles(Light& light)
+{
+    for (int i = 0; i < light.tileCount; ++i)
+    {
+        release(light.level, light.tiles[i]);
+    }
+    light.level = -1;
+    light.tileCount = 0;
+}
+
+void ShadowAtlas::invalidate()
+{
+    for (auto& light : m_lights)
+    {
+        if (std::none_of(light.second.dirty, light.second.dirty + light.second.tileCount, [](bool dirty) { return dirty; }))
+        {
+            light.second.dirtyFrame = m_frame;
+        }
+        std::fill(light.second.dirty, light.second.dirty + light.second.tileCount, true);
+    }
+}
+
+const ShadowAtlas::Entry* ShadowAtlas::find(const void* id) const
+{
+    auto found = m_lights.find(id);
+    if (found == m_lights.end() || found->second.tileCount == 0)
+    {
+        return nullptr;
+    }
+    const Light& light = found->second;
+    bool drawn = std::all_of(light.drawn, light.drawn + light.tileCount, [](bool drawn) { return drawn; });
+    return drawn ? &light.entry : nullptr;
+}
+
+void ShadowAtlas::update(const std::vector<ShadowLight>& lights, const std::vector<ShadowCaster>& casters, int viewBudget, float maxPixelError)
+{
+    m_stats = Stats();
+    m_frame++;
+    if (m_framebuffer == 0)
+    {
+        return;
+    }
+
+    // most important first, lights out of view get no tiles
+    std::vector<const ShadowLight*> order;
+    for (const ShadowLight& light : lights)
+    {
+        if (light.screenSize > 0.f)
+        {
+            order.push_back(&light);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [](const ShadowLight* a, const ShadowLight* b) { return a->screenSize > b->screenSize; });
+    for (const ShadowLight* light : order)
+    {
+        auto inserted = m_lights.emplace(light->id, Light());
+        if (inserted.second)
+        {
+            Light& added = inserted.first->second;
+            if (!m_freeSlots.empty())
+            {
+                added.slot = m_freeSlots.back();
+                m_freeSlots.pop_back();
+            }
+            else
+            {
+                added.slot = m_firstSlot + 6 * m_slotBlocks++;
+            }
+        }
+        inserted.first->second.frame = m_frame;
+    }
+    for (auto light = m_lights.begin(); light != m_lights.end();)
+    {
+        if (light->second.frame != m_frame)
+        {
+            releaseTiles(light->second);
+            m_freeSlots.push_back(light->second.slot);
+            light = m_lights.erase(light);
+        }
+        else
+        {
+            ++light;
+        }
+    }
+
+    // tile sizes from the screen coverage, a cube face sees about half of the reach across. when the requests add up
+    // to more than the atlas the least important lights step down first, every light at most one level per round,
+    // so the space stays shared roughly in proportion to importance
+    std::vector<int> levels(order.size());
+    std::vector<int> tileCounts(order.size());
+    long long requested = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        bool point = order[i]->type == ShadowLight::POINT;
+        tileCounts[i] = point ? 6 : 1;
+        levels[i] = levelFor(point ? 0.5f * order[i]->screenSize : order[i]->screenSize);
+        long long tile = m_size >> levels[i];
+        requested += tileCounts[i] * tile * tile;
+    }
+    bool shrunk = true;
+    while (requested > (long long)m_size * m_size && shrunk)
+    {
+        shrunk = false;
+        for (size_t i = order.size(); i-- > 0 && requested > (long long)m_size * m_size;)
+        {
+            if (levels[i] < m_minTileLevel)
+            {
+                long long tile = m_size >> levels[i];
+                requested -= tileCounts[i] * tile * tile * 3 / 4;
+                levels[i]++;
+                shrunk = true;
+            }
+        }
+    }
+
+    // count tiles of one level between level and lastLevel, the largest that fits. nothing is taken when they do not
+    auto allocateTiles = [this](int level, int lastLevel, int count, glm::ivec2* tiles) {
+        for (; level <= lastLevel; ++level)
+        {
+            int allocated = 0;
+            while (allocated < count && allocate(level, tiles[allocated]))
+            {
+                allocated++;
+            }
+            if (allocated == count)
+            {
+                return level;
+            }
+            while (allocated > 0)
+            {
+                release(level, tiles[--allocated]);
+            }
+        }
+        return -1;
+    };
+    auto assign = [this](Light& light, ShadowLight::Type type, int level, int count, const glm::ivec2* tiles) {
+        light.level = level;
+        light.tileCount = count;
+        std::copy(tiles, tiles + count, light.tiles);
+        Entry& entry = light.entry;
+        entry.type = type;
+        entry.tileTexels = m_size >> level;
+        entry.tileSize = (float)entry.tileTexels / m_size;
+        for (int view = 0; view < count; ++view)
+        {
+            entry.offsets[view] = glm::vec2(tiles[view]) / (float)m_size;
+        }
+        std::fill(light.drawn, light.drawn + 6, false);
+        std::fill(light.dirty, light.dirty + 6, false);
+    };
+
+    // a light grows as soon as it covers more pixels and there is room, but only shrinks at a quarter so one hovering
+    // around a size does not keep moving. a light without tiles that does not fit takes the space of the least
+    // important lights, one at a time, and those try again after it
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        Light& light = m_lights[order[i]->id];
+        glm::ivec2 tiles[6];
+        if (light.level >= 0 && (light.tileCount != tileCounts[i] || levels[i] > light.level + 1))
+        {
+            releaseTiles(light);
+        }
+        if (light.level >= 0)
+        {
+            int level = levels[i] < light.level ? allocateTiles(levels[i], light.level - 1, tileCounts[i], tiles) : -1;
+            if (level >= 0)
+            {
+                releaseTiles(light);
+                assign(light, order[i]->type, level, tileCounts[i], tiles);
+            }
+            continue;
+        }
+        int level = allocateTiles(levels[i], m_minTileLevel, tileCounts[i], tiles);
+        for (size_t j = order.size() - 1; level < 0 && j > i; --j)
+        {
+            Light& other = m_lights[order[j]->id];
+            if (other.level >= 0)
+            {
+                releaseTiles(other);
+                level = allocateTiles(levels[i], m_minTileLevel, tileCounts[i], tiles);
+            }
+        }
+        if (level >= 0)
+        {
+            assign(light, order[i]->type, level, tileCounts[i], tiles);
+        }
+    }
+
+    // what every placed light is drawn from, the views of a light that changed are out of date
+    for (const ShadowLight* shadowLight : order)
+    {
+        Light& light = m_lights[shadowLight->id];
+        if (light.level < 0)
+        {
+            continue;
+        }
+        LightState state = {shadowLight->position, shadowLight->direction, shadowLight->angle, shadowLight->reach(), maxPixelError, {}};
+        if (shadowLight->type == ShadowLight::POINT)
+        {
+            state.direction = glm::vec3(0.f);
+            state.angle = 0.f;
+        }
+        for (const ShadowCaster& caster : casters)
+        {
+            const BoundingSphere& bounds = caster.model->worldBounds(caster.transform);
+            if (glm::length(bounds.center - state.position) - bounds.radius <= state.farPlane)
+            {
+                state.casters.push_back({caster.model, caster.transform, caster.model->residentMeshes()});
+            }
+        }
+        bool dirty = std::any_of(light.dirty, light.dirty + light.tileCount, [](bool dirty) { return dirty; });
+        bool placed = std::none_of(light.drawn, light.drawn + light.tileCount, [](bool drawn) { return drawn; });
+        if (placed || state != light.state)
+        {
+            light.state = std::move(state);
+            std::fill(light.dirty, light.dirty + light.tileCount, true);
+            if (!dirty)
+            {
+                light.dirtyFrame = m_frame;
+            }
+        }
+    }
+
+    // lights without a shadow yet go first, then by tile size times the frames they have waited. the smallest tiles
+    // wait at most 16 times as long as the largest, so every light is drawn again within a bounded number of frames
+    std::vector<Light*> pending;
+    for (const ShadowLight* shadowLight : order)
+    {
+        Light& light = m_lights[shadowLight->id];
+        if (std::any_of(light.dirty, light.dirty + light.tileCount, [](bool dirty) { return dirty; }))
+        {
+            pending.push_back(&light);
+        }
+    }
+    auto priority = [this](const Light* light) {
+        bool shadowed = std::all_of(light->drawn, light->drawn + light->tileCount, [](bool drawn) { return drawn; });
+        float weight = (float)(1 << std::min(m_minTileLevel - light->level, 4));
+        return std::make_pair(!shadowed, weight * (float)(m_frame - light->dirtyFrame + 1));
+    };
+    std::stable_sort(pending.begin(), pending.end(), [&priority](const Light* a, const Light* b) { return priority(a) > priority(b); });
+
+    if (!pending.empty())
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+        GLState::enable(GL_SCISSOR_TEST);
+        // back faces into the map like PointShadow, so receivers drawn at a coarser LOD do not shadow themselves
+        GLState::enable(GL_CULL_FACE);
+        GLState::cullFace(GL_FRONT);
+        m_program->use();
+        for (Light* light : pending)
+        {
+            for (int view = 0; view < light->tileCount; ++view)
+            {
+                if (!light->dirty[view] || (viewBudget > 0 && m_stats.drawnViews >= viewBudget))
+                {
+                    continue;
+                }
+                draw(*light, view);
+                light->dirty[view] = false;
+                light->drawn[view] = true;
+                m_stats.drawnViews++;
+            }
+        }
+        GLState::disable(GL_SCISSOR_TEST);
+        GLState::cullFace(GL_BACK);
+        GLState::disable(GL_CULL_FACE);
+    }
+
+    long long texels = 0;
+    for (const ShadowLight* shadowLight : order)
+    {
+        const Light& light = m_lights[shadowLight->id];
+        m_stats.lights++;
+        m_stats.views += light.tileCount;
+        texels += (long long)light.tileCount * light.entry.tileTexels * light.entry.tileTexels;
+        if (light.tileCount > 0 && find(shadowLight->id) != nullptr)
+        {
+            m_stats.shadowedLights++;
+        }
+        int stale = (int)std::count(light.dirty, light.dirty + light.tileCount, true);
+        if (stale > 0)
+        {
+            m_stats.staleViews += stale;
+            m_stats.maxStaleFrames = std::max(m_stats.maxStaleFrames, m_frame - light.dirtyFrame);
+        }
+    }
+    m_stats.occupancy = (float)((double)texels / ((double)m_size * m_size));
+    updateRecords(order);
+}
+
+void ShadowAtlas::updateRecords(const std::vector<const ShadowLight*>& order)
+{
+    m_records.clear();
+    for (const ShadowLight* shadowLight : order)
+    {
+        Light& light = m_lights[shadowLight->id];
+        Entry& entry = light.entry;
+        entry.index = -1;
+        if (find(shadowLight->id) == nullptr)
+        {
+            continue;
+        }
+        entry.index = (int)(m_records.size() / RECORD_TEXELS);
+        m_records.push_back(glm::vec4(entry.offsets[0], entry.tileSize, entry.farPlane));
+        if (entry.type == ShadowLight::POINT)
+        {
+            m_records.push_back(glm::vec4(entry.offsets[1], entry.offsets[2]));
+            m_records.push_back(glm::vec4(entry.offsets[3], entry.offsets[4]));
+            m_records.push_back(glm::vec4(entry.offsets[5], 0.f, 0.f));
+            m_records.insert(m_records.end(), 4, glm::vec4(0.f));
+        }
+        else
+        {
+            // the view opens the whole cone, one unit in front of the light a texel is 2 tan(half angle) / texels
+            float texel = 2.f * glm::tan(0.5f * light.state.angle) / entry.tileTexels;
+            m_records.push_back(glm::vec4(0.f));
+            m_records.push_back(glm::vec4(0.f));
+            m_records.push_back(glm::vec4(0.f, 0.f, texel, 0.f));
+            for (int column = 0; column < 4; ++column)
+            {
+                m_records.push_back(entry.viewProject[column]);
+            }
+        }
+    }
+    m_lightBuffer.update(m_records.data(), m_records.size() * sizeof(glm::vec4));
+}
+
+void ShadowAtlas::draw(Light& light, int view)
+{
+    const LightState& state = light.state;
+    Entry& entry = light.entry;
+    glm::mat4 viewMatrix;
+    glm::mat4 project;
+    if (entry.type == ShadowLight::POINT)
+    {
+        viewMatrix = PointShadow::faceView(state.position, view);
+        project = glm::perspective(glm::radians(90.f), 1.f, NEAR_PLANE, state.farPlane);
+    }
+    else
+    {
+        glm::vec3 up = glm::abs(state.direction.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+        viewMatrix = glm::lookAt(state.position, state.position + state.direction, up);
+        project = glm::perspective(state.angle, 1.f, NEAR_PLANE, state.farPlane);
+        entry.viewProject = project * viewMatrix;
+    }
+    entry.farPlane = state.farPlane;
+
+    const glm::ivec2& tile = light.tiles[view];
+    glViewport(tile.x, tile.y, entry.tileTexels, entry.tileTexels);
+    glScissor(tile.x, tile.y, entry.tileTexels, entry.tileTexels);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    m_program->setUniformMatrix4fv(Uniforms::shadowMatrix, project * viewMatrix);
+    m_program->setUniform3f(Uniforms::lightPos, state.position);
+    m_program->setUniform1f(Uniforms::farPlane, state.farPlane);
+    DrawView drawView(viewMatrix, project, state.position, (float)entry.tileTexels, state.maxPixelError, light.slot + view);
+    for (const ShadowCasterState& caster : state.casters)
+    {
+        m_program->setUniformMatrix4fv(Uniforms::model, caster.transform);
+        caster.model->drawDepth(m_program.get(), drawView, caster.transform);
+        m_stats.drawCalls += caster.model->depthDrawCalls();
+        m_stats.triangles += caster.model->depthTriangles();
+    }
+}
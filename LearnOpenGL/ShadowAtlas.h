@@ -0,0 +1,198 @@
+//
+//  ShadowAtlas.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef ShadowAtlas_h
+#define ShadowAtlas_h
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Light.hpp"
+#include "PointShadow.h"
+#include "UniformBuffer.h"
+
+struct BoundingSphere;
+struct DrawView;
+
+/// a shadow casting light handed to the atlas, identified from frame to frame by id
+struct ShadowLight
+{
+    enum Type
+    {
+        /// six cube faces of 90 degrees around the light
+        POINT = 0,
+        /// one view down the cone
+        SPOT,
+    };
+
+    const void* id;
+    Type type;
+    glm::vec3 position;
+    /// spot lights only, the cone axis and its full opening angle in radians
+    glm::vec3 direction;
+    float angle;
+    /// the light's color and intensity, its views end at their lightReach()
+    glm::vec3 color;
+    float intensity;
+    /// pixels the light's reach covers on screen, see ShadowAtlas::screenSize(). 0 casts no shadow
+    float screenSize;
+
+    float reach() const { return lightReach(color, intensity); }
+};
+
+/// one depth texture shared by the shadows of many lights. each light gets square tiles, six for a point light
+/// and one for a spot light, sized to its screen coverage and packed by a quadtree allocator, the least important
+/// scaled down first when they do not fit. tiles are drawn again only when the light or a caster in its reach changed,
+/// at most a budget of views per frame, larger and longer waiting first. a light whose tiles were not all drawn
+/// yet has no shadow. the shaders find the tiles of every shadowed light in a texture buffer, so the number of
+/// shadowed lights is bounded by the atlas space alone
+class ShadowAtlas
+{
+public:
+    /// texels of a light's record in lightBuffer(): the uv offset of view 0, the uv tile size and the distance
+    /// of depth 1, the offsets of views 1 to 5 two by two and, spot lights only, the size of a texel one unit in
+    /// front of the light, then the four columns of the spot light's projection into its tile
+    static const int RECORD_TEXELS = 8;
+
+    /// where a light's views are, uv offsets and size in the atlas
+    struct Entry
+    {
+        ShadowLight::Type type;
+        /// offset of every view, face GL_TEXTURE_CUBE_MAP_POSITIVE_X + i of a point light
+        glm::vec2 offsets[6];
+        float tileSize;
+        /// texels along a tile side
+        GLsizei tileTexels;
+        float farPlane;
+        /// spot lights only, the projection of the view into the tile
+        glm::mat4 viewProject;
+        /// the light's record in lightBuffer()
+        int index = -1;
+    };
+
+    /// what the last update() found and drew
+    struct Stats
+    {
+        int lights = 0;
+        /// lights with every view drawn, their entries can be sampled
+        int shadowedLights = 0;
+        int views = 0;
+        int drawnViews = 0;
+        /// views left out of date for a later frame and the most frames one has waited
+        int staleViews = 0;
+        int maxStaleFrames = 0;
+        int drawCalls = 0;
+        int triangles = 0;
+        /// share of the atlas covered by tiles
+        float occupancy = 0.f;
+    };
+
+    ShadowAtlas();
+    ~ShadowAtlas();
+    ShadowAtlas(const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+    /// size x size depth texture with tiles from maxTile down to minTile texels, all powers of two, render thread only.
+    /// every light draws its views with six DrawView slots of its own from firstSlot up, so the casters keep their
+    /// LODs and batches per view. nothing else may use the slots past firstSlot
+    void create(GLsizei size, GLsizei maxTile, GLsizei minTile, unsigned int firstSlot);
+
+    /// pixels the sphere of a light's reach covers across on screen, 0 outside the view and unbounded around the eye
+    static float screenSize(const ShadowLight& light, const DrawView& camera);
+
+    /// place the lights and bring their views up to date, at most viewBudget views drawn, 0 for no limit.
+    /// lights missing from the list give their tiles back. may leave the atlas framebuffer bound
+    void update(const std::vector<ShadowLight>& lights, const std::vector<ShadowCaster>& casters, int viewBudget, float maxPixelError);
+
+    /// the light's tiles, nullptr while it has none or some of them were never drawn
+    const Entry* find(const void* id) const;
+
+    /// forget what the tiles hold, update() draws them again as the budget allows
+    void invalidate();
+
+    GLuint depthMap() const { return m_depthMap; }
+    /// RGBA32F texture buffer with RECORD_TEXELS texels per light find() returns, as of the last update()
+    GLuint lightBuffer() const { return m_lightBuffer.texture(); }
+    GLsizei size() const { return m_size; }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    /// everything a light's views are drawn from
+    struct LightState
+    {
+        glm::vec3 position;
+        glm::vec3 direction;
+        float angle;
+        float farPlane;
+        float maxPixelError;
+        std::vector<ShadowCasterState> casters;
+
+        bool operator==(const LightState& other) const
+        {
+            return position == other.position && direction == other.direction && angle == other.angle && farPlane == other.farPlane &&
+                   maxPixelError == other.maxPixelError && casters == other.casters;
+        }
+        bool operator!=(const LightState& other) const { return !(*this == other); }
+    };
+
+    struct Light
+    {
+        Entry entry;
+        /// level in the quadtree of the tiles, tile positions in texels
+        int level = -1;
+        glm::ivec2 tiles[6];
+        int tileCount = 0;
+        /// the views drawn since the tiles were placed, and those out of date with state
+        bool drawn[6] = {};
+        bool dirty[6] = {};
+        int dirtyFrame = 0;
+        LightState state;
+        /// last update() the light was handed to
+        int frame = 0;
+        /// first of the light's DrawView slots
+        unsigned int slot = 0;
+    };
+
+    /// tile of size >> level, false when the atlas is full at that level
+    bool allocate(int level, glm::ivec2& tile);
+    void release(int level, const glm::ivec2& tile);
+    void releaseTiles(Light& light);
+
+    /// draw view of light into its tile
+    void draw(Light& light, int view);
+
+    /// write the records of the lights that have a shadow, in order
+    void updateRecords(const std::vector<const ShadowLight*>& order);
+
+    /// level of the smallest tiles with at least texels across, between maxTile and minTile
+    int levelFor(float texels) const;
+
+private:
+    GLuint m_depthMap;
+    GLuint m_framebuffer;
+    GLsizei m_size;
+    /// levels of the largest and the smallest tiles handed out
+    int m_maxTileLevel;
+    int m_minTileLevel;
+    unsigned int m_firstSlot;
+    /// blocks of six slots handed out so far, and those given back by lights that went away
+    unsigned int m_slotBlocks;
+    std::vector<unsigned int> m_freeSlots;
+    std::unique_ptr<Program> m_program;
+    TextureBuffer m_lightBuffer;
+    std::vector<glm::vec4> m_records;
+
+    /// free tile positions per level, level l tiles are size >> l texels across
+    std::vector<std::vector<glm::ivec2>> m_freeTiles;
+    std::unordered_map<const void*, Light> m_lights;
+    int m_frame;
+    Stats m_stats;
+};
+
+#endif /* ShadowAtlas_h */
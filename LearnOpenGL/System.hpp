@@ -9,10 +9,9 @@
 #define System_h
 
 #include <string>
-
-#ifdef _WIN32
 #include <filesystem>
-#elif defined(__APPLE__)
+
+#if defined(__APPLE__)
 #import <Cocoa/Cocoa.h>
 #import <Foundation/Foundation.h>
 #endif
@@ -34,9 +33,20 @@ inline std::string resourcePathWithFile(const std::string& file)
     NSString* path = [[NSBundle mainBundle]resourcePath];
     strPath = [path UTF8String];
     strPath = strPath + "/" + file;
+#elif defined(__linux__)
+    std::filesystem::path currentPath = std::filesystem::current_path();
+    strPath = (currentPath / "Resources" / file).string();
 #endif
     return strPath;
 }
 
+/// writable location for generated data such as caches
+inline std::string cachePathWithFile(const std::string& file)
+{
+    std::error_code error;
+    std::filesystem::path cacheDir = std::filesystem::temp_directory_path(error) / "LearnOpenGL";
+    return (cacheDir / file).string();
+}
+
 }
 #endif /* System_hpp */
@@ -0,0 +1,117 @@
+//
+//  TextureManager.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "TextureManager.h"
+#include "GLState.h"
+#include "Hash.h"
+#include <filesystem>
+#include <iostream>
+#include <stb/stb_image.h>
+
+namespace
+{
+    /// "a/./b/../c.png" and "a/c.png" name the same file
+    std::string canonicalPath(const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        if (error)
+        {
+            canonical = std::filesystem::path(path).lexically_normal();
+        }
+        return canonical.generic_string();
+    }
+}
+
+SharedTexture::SharedTexture(uint64_t key, const std::string& path)
+    : m_key(key), m_path(path), m_image(), m_id(0)
+{
+}
+
+SharedTexture::~SharedTexture()
+{
+    TextureManager::instance().forget(m_key);
+    stbi_image_free(m_image.data);
+    if (m_id != 0)
+    {
+        GLState::deleteTextures(1, &m_id);
+    }
+}
+
+void SharedTexture::decode()
+{
+    std::call_once(m_decoded, [this]() {
+        m_image.data = stbi_load(m_path.c_str(), &m_image.width, &m_image.height, &m_image.components, 0);
+        if (m_image.data == nullptr)
+        {
+            std::cout << "Texture failed to load at path: " << m_path << std::endl;
+        }
+    });
+}
+
+GLuint SharedTexture::upload(TextureUploader* uploader)
+{
+    if (m_id != 0)
+    {
+        return m_id;
+    }
+    m_id = uploader ? uploader->upload(m_image) : TextureUploader::createTexture(m_image, m_image.data);
+    stbi_image_free(m_image.data);
+    m_image.data = nullptr;
+    return m_id;
+}
+
+TextureManager::TextureManager()
+    : m_hits(0), m_misses(0)
+{
+}
+
+TextureManager& TextureManager::instance()
+{
+    static TextureManager manager;
+    return manager;
+}
+
+TextureRef TextureManager::acquire(const std::string& path)
+{
+    std::string canonical = canonicalPath(path);
+    uint64_t key = Hash::fnv1a64(canonical.data(), canonical.size());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::weak_ptr<SharedTexture>& entry = m_textures[key];
+    TextureRef texture = entry.lock();
+    if (texture)
+    {
+        m_hits++;
+        return texture;
+    }
+    m_misses++;
+    texture = std::make_shared<SharedTexture>(key, path);
+    entry = texture;
+    return texture;
+}
+
+TextureManager::Stats TextureManager::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.live = (int)m_textures.size();
+    return stats;
+}
+
+void TextureManager::forget(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_textures.find(key);
+    // acquire may have replaced the expired entry with a new texture already
+    if (it != m_textures.end() && it->second.expired())
+    {
+        m_textures.erase(it);
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  TextureManager.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef TextureManager_h
+#define TextureManager_h
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <glad/glad.h>
+#include "TextureUploader.h"
+
+/// one texture file shared by every mesh that references it. the file is decoded once and
+/// uploaded once, the gl texture is deleted when the last reference goes away
+class SharedTexture
+{
+public:
+    SharedTexture(uint64_t key, const std::string& path);
+
+    /// deletes the gl texture, render thread only
+    ~SharedTexture();
+    SharedTexture(const SharedTexture&) = delete;
+    SharedTexture& operator=(const SharedTexture&) = delete;
+
+    /// decode the file into memory, safe to call from any thread. only the first call decodes,
+    /// concurrent callers wait for it, later calls return at once
+    void decode();
+
+    /// create the gl texture from the decoded pixels once and free them, render thread only.
+    /// decode() must have returned before
+    GLuint upload(TextureUploader* uploader);
+
+    GLuint id() const { return m_id; }
+    uint64_t key() const { return m_key; }
+    const std::string& path() const { return m_path; }
+
+private:
+    uint64_t m_key;
+    std::string m_path;
+    std::once_flag m_decoded;
+    DecodedImage m_image;
+    GLuint m_id;
+};
+
+typedef std::shared_ptr<SharedTexture> TextureRef;
+
+/// process wide texture cache keyed by the hash of the canonical file path,
+/// models referencing the same file get the same SharedTexture
+class TextureManager
+{
+public:
+    /// lookups since start, a hit found the texture alive, a miss created it
+    struct Stats
+    {
+        int hits;
+        int misses;
+        int live;
+    };
+
+    static TextureManager& instance();
+
+    /// reference to the texture of a file, safe to call from any thread
+    TextureRef acquire(const std::string& path);
+
+    Stats stats();
+
+private:
+    TextureManager();
+
+    /// called by the last reference going away
+    void forget(uint64_t key);
+
+    friend class SharedTexture;
+
+private:
+    std::mutex m_mutex;
+    /// weak so the cache never keeps a texture alive
+    std::unordered_map<uint64_t, std::weak_ptr<SharedTexture>> m_textures;
+    int m_hits;
+    int m_misses;
+};
+
+#endif /* TextureManager_h */
@@ -0,0 +1,178 @@
+//
+//  TextureUploader.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "TextureUploader.h"
+#include "GLState.h"
+#include <cstring>
+
+namespace
+{
+    bool isSignaled(GLsync fence)
+    {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+    }
+}
+
+TextureUploader::TextureUploader()
+    : m_bytesUploaded(0), m_texturesUploaded(0)
+{
+}
+
+TextureUploader::~TextureUploader()
+{
+}
+
+unsigned int TextureUploader::upload(const DecodedImage& image)
+{
+    if (image.data == nullptr)
+    {
+        return createTexture(image, nullptr);
+    }
+
+    GLsizeiptr size = (GLsizeiptr)image.width * image.height * image.components;
+    PixelBuffer* pixelBuffer = acquire(size);
+
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer->buffer);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    bool copied = false;
+    if (mapped != nullptr)
+    {
+        memcpy(mapped, image.data, (size_t)size);
+        // unmap fails when the buffer contents got lost, upload from client memory then
+        copied = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    }
+
+    unsigned int textureID;
+    if (copied)
+    {
+        textureID = createTexture(image, (const void*)0);
+        pixelBuffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        textureID = createTexture(image, image.data);
+    }
+
+    m_bytesUploaded += (size_t)size;
+    m_texturesUploaded++;
+    return textureID;
+}
+
+void TextureUploader::collect()
+{
+    for (PixelBuffer& pixelBuffer : m_buffers)
+    {
+        if (pixelBuffer.fence != nullptr && isSignaled(pixelBuffer.fence))
+        {
+            glDeleteSync(pixelBuffer.fence);
+            pixelBuffer.fence = nullptr;
+        }
+    }
+}
+
+void TextureUploader::release(bool wait)
+{
+    if (wait)
+    {
+        for (PixelBuffer& pixelBuffer : m_buffers)
+        {
+            if (pixelBuffer.fence != nullptr)
+            {
+                glClientWaitSync(pixelBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            }
+        }
+    }
+    collect();
+
+    size_t kept = 0;
+    for (PixelBuffer& pixelBuffer : m_buffers)
+    {
+        if (pixelBuffer.fence == nullptr)
+        {
+            GLState::deleteBuffers(1, &pixelBuffer.buffer);
+        }
+        else
+        {
+            m_buffers[kept++] = pixelBuffer;
+        }
+    }
+    m_buffers.resize(kept);
+}
+
+TextureUploader::PixelBuffer* TextureUploader::acquire(GLsizeiptr size)
+{
+    collect();
+
+    // smallest idle buffer that fits, otherwise grow an idle one, otherwise a new one
+    PixelBuffer* best = nullptr;
+    PixelBuffer* idle = nullptr;
+    for (PixelBuffer& pixelBuffer : m_buffers)
+    {
+        if (pixelBuffer.fence != nullptr)
+        {
+            continue;
+        }
+        idle = &pixelBuffer;
+        if (pixelBuffer.capacity >= size && (best == nullptr || pixelBuffer.capacity < best->capacity))
+        {
+            best = &pixelBuffer;
+        }
+    }
+    if (best != nullptr)
+    {
+        return best;
+    }
+
+    if (idle == nullptr)
+    {
+        PixelBuffer pixelBuffer = {};
+        glGenBuffers(1, &pixelBuffer.buffer);
+        m_buffers.push_back(pixelBuffer);
+        idle = &m_buffers.back();
+    }
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, idle->buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    idle->capacity = size;
+    return idle;
+}
+
+unsigned int TextureUploader::createTexture(const DecodedImage& image, const void* pixels)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (image.data)
+    {
+        GLenum format = GL_RGBA;
+        if (image.components == 1)
+        {
+            format = GL_RED;
+        }
+        else if (image.components == 3)
+        {
+            format = GL_RGB;
+        }
+
+        // stb rows are tightly packed
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GLState::bindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    return textureID;
+}
@@ -0,0 +1,66 @@
+//
+//  TextureUploader.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef TextureUploader_h
+#define TextureUploader_h
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+/// texture pixels decoded on a worker thread, waiting for upload
+struct DecodedImage {
+    unsigned char* data;
+    int width;
+    int height;
+    int components;
+};
+
+/// uploads decoded images through pixel buffer objects. the render thread only copies the pixels
+/// into a mapped pbo, the transfer into the texture runs asynchronously and a fence tells when
+/// the pbo can be reused, so uploads overlap rendering instead of stalling it
+class TextureUploader
+{
+public:
+    TextureUploader();
+
+    /// no gl calls, the buffers die with the context
+    ~TextureUploader();
+
+    /// create a texture from the image through a pbo, render thread only
+    unsigned int upload(const DecodedImage& image);
+
+    /// recycle the pbos whose transfer completed, never blocks
+    void collect();
+
+    /// delete the idle pbos, with wait it blocks on the transfers still in flight and deletes every pbo
+    void release(bool wait = false);
+
+    size_t bufferCount() const { return m_buffers.size(); }
+    size_t bytesUploaded() const { return m_bytesUploaded; }
+    int texturesUploaded() const { return m_texturesUploaded; }
+
+    /// create a texture straight from client memory, or from the bound pbo when pixels is an offset
+    static unsigned int createTexture(const DecodedImage& image, const void* pixels);
+
+private:
+    struct PixelBuffer
+    {
+        GLuint buffer;
+        GLsizeiptr capacity;
+        GLsync fence;
+    };
+
+    PixelBuffer* acquire(GLsizeiptr size);
+
+private:
+    std::vector<PixelBuffer> m_buffers;
+    size_t m_bytesUploaded;
+    int m_texturesUploaded;
+};
+
+#endif /* TextureUploader_h */
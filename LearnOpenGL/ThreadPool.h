@@ -0,0 +1,46 @@
+//
+//  ThreadPool.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/// fixed set of worker threads running submitted jobs in fifo order
+class ThreadPool
+{
+public:
+    /// 0 threads means one per hardware thread, leaving one for the render thread
+    ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    void submit(std::function<void()> job);
+
+    /// block until the queue is empty and no job is running
+    void wait();
+
+    unsigned int size() const { return (unsigned int)m_workers.size(); }
+
+private:
+    void workerLoop();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_idle;
+    unsigned int m_running;
+    bool m_stop;
+};
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,89 @@
+//
+//  UniformBuffer.cpp
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#include "UniformBuffer.h"
+#include "GLState.h"
+
+void UniformBlocks::bind(GLuint program)
+{
+    static const struct
+    {
+        const char* name;
+        GLuint binding;
+    } blocks[] = {
+        {"FrameConstants", FRAME},
+        {"Lights", LIGHTS},
+    };
+
+    for (const auto& block : blocks)
+    {
+        GLuint index = glGetUniformBlockIndex(program, block.name);
+        if (index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(program, index, block.binding);
+        }
+    }
+}
+
+UniformBuffer::UniformBuffer()
+    : m_buffer(0), m_binding(0), m_size(0)
+{
+}
+
+void UniformBuffer::create(GLuint binding, GLsizeiptr size)
+{
+    m_binding = binding;
+    m_size = size;
+    glGenBuffers(1, &m_buffer);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, binding, m_buffer);
+}
+
+void UniformBuffer::update(const void* data, GLsizeiptr size)
+{
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size < m_size ? size : m_size, data);
+    // left bound, the generic binding is not read by draws and the next update rebinds anyway
+}
+
+TextureBuffer::TextureBuffer()
+    : m_buffer(0), m_texture(0), m_capacity(0)
+{
+}
+
+TextureBuffer::~TextureBuffer()
+{
+    GLState::deleteTextures(1, &m_texture);
+    GLState::deleteBuffers(1, &m_buffer);
+}
+
+void TextureBuffer::create(GLenum format)
+{
+    // a buffer texture needs storage behind it even while there is nothing to read
+    glGenBuffers(1, &m_buffer);
+    m_capacity = 16;
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &m_texture);
+    GLState::bindTexture(GL_TEXTURE_BUFFER, m_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, m_buffer);
+}
+
+void TextureBuffer::update(const void* data, GLsizeiptr size)
+{
+    // the texture keeps pointing at the buffer object whatever storage it has
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+    m_capacity = size > m_capacity ? size : m_capacity;
+    glBufferData(GL_TEXTURE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+    if (size > 0)
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+}
@@ -0,0 +1,164 @@
+//
+//  UniformBuffer.h
+//  LearnOpenGL
+//
+//  Created by asi on 2026/10/18.
+//
+
+#ifndef UniformBuffer_h
+#define UniformBuffer_h
+
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/// binding points of the uniform blocks shared by all programs
+namespace UniformBlocks
+{
+    const GLuint FRAME = 0;
+    const GLuint LIGHTS = 1;
+
+    /// keep in sync with MAX_POINT_LIGHTS, MAX_SPOT_LIGHTS, MAX_DIRECTIONAL_LIGHTS and MAX_CASCADES in the shaders
+    const int MAX_POINT_LIGHTS = 8;
+    const int MAX_SPOT_LIGHTS = 4;
+    const int MAX_DIRECTIONAL_LIGHTS = 2;
+    const int MAX_CASCADES = 4;
+
+    /// bind the blocks a program declares to their binding points, glsl 4.1 has no layout(binding)
+    void bind(GLuint program);
+}
+
+/// std140 layout of the FrameConstants block, updated once per frame
+struct FrameConstants
+{
+    glm::mat4 view;
+    glm::mat4 project;
+    glm::vec3 viewPos;
+    float time;
+};
+
+/// where a light's shadow is, keep in sync with the SHADOW_ defines in the shaders
+namespace ShadowMaps
+{
+    const int NONE = -1;
+    /// the cube map of PointShadow
+    const int CUBE = 0;
+    /// tiles of the ShadowAtlas
+    const int ATLAS = 1;
+    /// layers of the CascadedShadow
+    const int CASCADES = 2;
+}
+
+/// std140 layout of one point light in the Lights block
+struct PointLightData
+{
+    glm::vec3 position;
+    float intensity;
+    glm::vec3 color;
+    /// shadow map the light is tested against, one of ShadowMaps
+    int shadowMap;
+    /// distance the light ends at, the falloff reaches 0 there
+    float range;
+    /// atlas only, the light's record in ShadowAtlas::lightBuffer()
+    int shadowIndex;
+    float padding[2];
+};
+
+/// std140 layout of one spot light in the Lights block, cutOff and outerCutOff are cosines of the half angles
+struct SpotLightData
+{
+    glm::vec3 position;
+    float intensity;
+    glm::vec3 direction;
+    float cutOff;
+    glm::vec3 color;
+    float outerCutOff;
+    /// NONE or ATLAS of ShadowMaps and the light's record in ShadowAtlas::lightBuffer()
+    int shadowMap;
+    int shadowIndex;
+    float range;
+    float padding;
+};
+
+/// std140 layout of one directional light in the Lights block, direction is the way the light travels
+struct DirectionalLightData
+{
+    glm::vec3 direction;
+    float intensity;
+    glm::vec3 color;
+    /// NONE or CASCADES of ShadowMaps
+    int shadowMap;
+    int cascadeCount;
+    float padding[3];
+    /// cascades only, the view depth each one ends at, the world size of its texels and its light space projection
+    glm::vec4 cascadeSplits;
+    glm::vec4 cascadeTexels;
+    glm::mat4 cascadeMatrices[UniformBlocks::MAX_CASCADES];
+};
+
+/// std140 layout of the Lights block, only the lights that are on
+struct LightConstants
+{
+    int pointLightCount;
+    int spotLightCount;
+    int directionalLightCount;
+    int padding;
+    PointLightData pointLights[UniformBlocks::MAX_POINT_LIGHTS];
+    SpotLightData spotLights[UniformBlocks::MAX_SPOT_LIGHTS];
+    DirectionalLightData directionalLights[UniformBlocks::MAX_DIRECTIONAL_LIGHTS];
+};
+
+static_assert(offsetof(FrameConstants, viewPos) == 128 && sizeof(FrameConstants) == 144, "FrameConstants does not match std140");
+static_assert(sizeof(PointLightData) == 48, "PointLightData does not match std140");
+static_assert(offsetof(SpotLightData, shadowMap) == 48 && sizeof(SpotLightData) == 64, "SpotLightData does not match std140");
+static_assert(offsetof(DirectionalLightData, cascadeSplits) == 48 && sizeof(DirectionalLightData) == 336, "DirectionalLightData does not match std140");
+static_assert(offsetof(LightConstants, pointLights) == 16 && offsetof(LightConstants, spotLights) == 400 && offsetof(LightConstants, directionalLights) == 656,
+              "LightConstants does not match std140");
+
+/// uniform buffer bound to a fixed binding point for its whole lifetime
+class UniformBuffer
+{
+public:
+    UniformBuffer();
+
+    void create(GLuint binding, GLsizeiptr size);
+
+    /// replace the contents, the old storage is orphaned so the gpu never stalls the update
+    void update(const void* data, GLsizeiptr size);
+
+    template <typename T>
+    void update(const T& data) { update(&data, sizeof(T)); }
+
+private:
+    GLuint m_buffer;
+    GLuint m_binding;
+    GLsizeiptr m_size;
+};
+
+/// buffer object the shaders read through a buffer texture (samplerBuffer), glsl 4.1 has no storage buffers.
+/// the storage only grows
+class TextureBuffer
+{
+public:
+    TextureBuffer();
+
+    /// render thread only
+    ~TextureBuffer();
+    TextureBuffer(const TextureBuffer&) = delete;
+    TextureBuffer& operator=(const TextureBuffer&) = delete;
+
+    /// buffer and texture reading it as texels of format
+    void create(GLenum format);
+
+    /// replace the contents, the old storage is orphaned like UniformBuffer::update()
+    void update(const void* data, GLsizeiptr size);
+
+    GLuint texture() const { return m_texture; }
+
+private:
+    GLuint m_buffer;
+    GLuint m_texture;
+    GLsizeiptr m_capacity;
+};
+
+#endif /* UniformBuffer_h */
@@ -14,6 +14,17 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 int main(int argc, char* argv[])
 #endif
 {
+#ifdef _WIN32
+    BenchmarkOptions options = BenchmarkOptions::parse(__argc, __argv);
+#else
+    BenchmarkOptions options = BenchmarkOptions::parse(argc, argv);
+#endif
+    if (options.headless)
+    {
+        return Engine::engine.startHeadless(options);
+    }
+
+    Engine::engine.setDebugOutput(options.glDebug);
     Engine::engine.start();
     return 0;
 }